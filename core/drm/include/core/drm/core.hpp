@@ -6,6 +6,7 @@
 #include <map>
 #include <unordered_map>
 #include <optional>
+#include <vector>
 
 #include <arch/mem_space.hpp>
 #include <async/cancellation.hpp>
@@ -344,7 +345,9 @@ protected:
 	~FrameBuffer() = default;
 
 public:
-	virtual void notifyDirty() = 0;
+	// Called when the contents of the frame buffer change.
+	// An empty list of clip rectangles means that the entire frame buffer is dirty.
+	virtual void notifyDirty(const std::vector<drm_clip_rect> &clips) = 0;
 };
 
 struct Plane : ModeObject {
@@ -891,7 +891,21 @@ drm_core::File::ioctl(void *object, managarm::fs::CntRequest req,
 		assert(obj);
 		auto fb = obj->asFrameBuffer();
 		assert(fb);
-		fb->notifyDirty();
+
+		std::vector<drm_clip_rect> clips;
+		for(size_t i = 0; i < req.drm_clips_size(); i++) {
+			auto rect = req.drm_clips(i);
+			if(rect.x1() < 0 || rect.y1() < 0
+					|| rect.x2() <= rect.x1() || rect.y2() <= rect.y1())
+				continue;
+			clips.push_back(drm_clip_rect{
+				static_cast<unsigned short>(rect.x1()),
+				static_cast<unsigned short>(rect.y1()),
+				static_cast<unsigned short>(rect.x2()),
+				static_cast<unsigned short>(rect.y2())
+			});
+		}
+		fb->notifyDirty(clips);
 
 		resp.set_error(managarm::fs::Errors::SUCCESS);
 		auto ser = resp.SerializeAsString();
@@ -77,7 +77,7 @@ struct LegacyPciQueue;
 struct LegacyPciTransport : Transport {
 	friend struct LegacyPciQueue;
 
-	LegacyPciTransport(protocols::hw::Device hw_device,
+	LegacyPciTransport(protocols::hw::Device hw_device, uint16_t io_base,
 			arch::io_space legacy_space, helix::UniqueDescriptor irq);
 
 	protocols::hw::Device &hwDevice() override {
@@ -101,6 +101,7 @@ private:
 	async::detached _processIrqs();
 
 	protocols::hw::Device _hwDevice;
+	uint16_t _ioBase;
 	arch::io_space _legacySpace;
 	helix::UniqueDescriptor _irq;
 
@@ -119,9 +120,9 @@ private:
 	LegacyPciTransport *_transport;
 };
 
-LegacyPciTransport::LegacyPciTransport(protocols::hw::Device hw_device,
+LegacyPciTransport::LegacyPciTransport(protocols::hw::Device hw_device, uint16_t io_base,
 		arch::io_space legacy_space, helix::UniqueDescriptor irq)
-: _hwDevice{std::move(hw_device)}, _legacySpace{legacy_space},
+: _hwDevice{std::move(hw_device)}, _ioBase{io_base}, _legacySpace{legacy_space},
 		_irq{std::move(irq)} { }
 
 uint8_t LegacyPciTransport::loadConfig8(size_t offset) {
@@ -215,6 +216,48 @@ void LegacyPciTransport::runDevice() {
 }
 
 async::detached LegacyPciTransport::_processIrqs() {
+	co_await connectKernletCompiler();
+
+	// Reading the ISR register deasserts the IRQ. Doing this in the kernel
+	// avoids waking up this process for IRQs of other devices on the same line.
+	std::vector<uint8_t> kernlet_program;
+	fnr::emit_to(std::back_inserter(kernlet_program),
+		// Load the ISR register.
+		fnr::scope_push{} (
+			fnr::intrin{"__pio_read8", 1, 1} (
+				fnr::binding{0} // Legacy PIO offset (bound to slot 0).
+					 + fnr::literal{PCI_L_ISR_STATUS.offset()} // Offset of ISR.
+			) & fnr::literal{3} // Progress and configuration change bits.
+		),
+		// Ack the IRQ iff one of the bits was set.
+		fnr::check_if{},
+			fnr::scope_get{0},
+		fnr::then{},
+			// Trigger the bitset event (bound to slot 1).
+			fnr::intrin{"__trigger_bitset", 2, 0} (
+				fnr::binding{1},
+				fnr::scope_get{0}
+			),
+			fnr::scope_push{} ( fnr::literal{1} ),
+		fnr::else_then{},
+			fnr::scope_push{} ( fnr::literal{2} ),
+		fnr::end{}
+	);
+
+	auto kernlet_object = co_await compile(kernlet_program.data(),
+			kernlet_program.size(), {BindType::offset, BindType::bitsetEvent});
+
+	HelHandle event_handle;
+	HEL_CHECK(helCreateBitsetEvent(&event_handle));
+	helix::UniqueDescriptor event{event_handle};
+
+	HelKernletData data[2];
+	data[0].handle = _ioBase;
+	data[1].handle = event.getHandle();
+	HelHandle bound_handle;
+	HEL_CHECK(helBindKernlet(kernlet_object.getHandle(), data, 2, &bound_handle));
+	HEL_CHECK(helAutomateIrq(_irq.getHandle(), 0, bound_handle));
+
 	co_await _hwDevice.enableBusIrq();
 
 	// TODO: The kick here should not be required.
@@ -222,19 +265,12 @@ async::detached LegacyPciTransport::_processIrqs() {
 
 	uint64_t sequence = 0;
 	while(true) {
-		auto await = co_await helix_ng::awaitEvent(_irq, sequence);
+		auto await = co_await helix_ng::awaitEvent(event, sequence);
 		HEL_CHECK(await.error());
 		sequence = await.sequence();
 
-		auto isr = _legacySpace.load(PCI_L_ISR_STATUS);
-
-		if(!(isr & 3)) {
-			HEL_CHECK(helAcknowledgeIrq(_irq.getHandle(), kHelAckNack, sequence));
-			continue;
-		}
-
-		HEL_CHECK(helAcknowledgeIrq(_irq.getHandle(), kHelAckAcknowledge, sequence));
-
+		// The kernlet only triggers the event if one of the ISR bits is set.
+		auto isr = await.bitset();
 		if(isr & 2) {
 			std::cout << "core-virtio: Configuration change" << std::endl;
 			auto status = _legacySpace.load(PCI_L_DEVICE_STATUS);
@@ -607,6 +643,7 @@ discover(protocols::hw::Device hw_device, DiscoverMode mode) {
 
 			std::cout << "virtio: Using legacy PCI transport" << std::endl;
 			co_return std::make_unique<LegacyPciTransport>(std::move(hw_device),
+					static_cast<uint16_t>(info.barInfo[0].address),
 					legacy_space, std::move(irq));
 		}
 	}
@@ -0,0 +1,138 @@
+#ifndef AHCI_AHCI_HPP
+#define AHCI_AHCI_HPP
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <arch/mem_space.hpp>
+#include <async/doorbell.hpp>
+#include <async/result.hpp>
+#include <blockfs.hpp>
+#include <helix/ipc.hpp>
+#include <helix/memory.hpp>
+#include <protocols/hw/client.hpp>
+
+#include "spec.hpp"
+
+struct Controller;
+
+// --------------------------------------------------------
+// Port
+// --------------------------------------------------------
+
+struct Port final : blockfs::BlockDevice {
+	Port(Controller *controller, int number, arch::mem_space space);
+
+	// Brings up the port. Returns false if there is no usable device.
+	async::result<bool> initialize();
+
+	async::result<void> readSectors(uint64_t sector, void *buffer,
+			size_t num_sectors) override;
+
+	async::result<void> writeSectors(uint64_t sector, const void *buffer,
+			size_t num_sectors) override;
+
+	// Called by the Controller's IRQ handler.
+	void handleIrq();
+
+	// Called if initialize() fails after the command engine has been started.
+	async::result<void> shutdown();
+
+private:
+	// One PRD entry per page; the last entry covers a buffer that does not start on a page.
+	static constexpr size_t maxSectorsPerCommand = (numPrdEntries - 1) * 8;
+
+	enum class Command {
+		read,
+		write,
+		identify
+	};
+
+	struct Request {
+		Command command;
+		uint64_t sector;
+		void *buffer;
+		size_t numSectors;
+		// Completed with false if the command failed.
+		async::promise<bool> promise;
+	};
+
+	// Returns false if any part of the request failed.
+	async::result<bool> _submit(Command command, uint64_t sector, void *buffer,
+			size_t num_sectors);
+
+	// Issues pending requests as long as there are free command slots.
+	async::detached _issueRequests();
+
+	void _setupCommand(int slot, Request *request);
+
+	// Completes all commands that the HBA has finished.
+	void _retireCompleted();
+
+	// Restarts the port after an error; outstanding commands fail.
+	async::detached _recover();
+
+	// Clears PxCMD.ST (and optionally PxCMD.FRE) and waits until the HBA stops.
+	async::result<bool> _stopEngine(bool stopFisReceive);
+
+	uintptr_t _physical(void *pointer);
+
+	Controller *_controller;
+	int _number;
+	arch::mem_space _space;
+
+	// Command list, received FIS area and command tables (physically contiguous).
+	helix::UniqueDescriptor _memory;
+	helix::Mapping _mapping;
+	uintptr_t _memoryPhysical;
+	CommandHeader *_commandList;
+	CommandTable *_commandTables;
+	uint16_t *_identifyData;
+
+	bool _useNcq = false;
+	size_t _numSlots = 1;
+
+	// No commands are issued while the port recovers from an error.
+	bool _recovering = false;
+	// Set if the port could not be recovered; all requests fail.
+	bool _broken = false;
+
+	std::deque<Request *> _pendingQueue;
+	async::doorbell _pendingDoorbell;
+
+	// Requests that occupy a command slot (indexed by slot).
+	Request *_slots[numCommandSlots] = {};
+	uint32_t _activeSlots = 0;
+};
+
+// --------------------------------------------------------
+// Controller
+// --------------------------------------------------------
+
+struct Controller {
+	friend struct Port;
+
+	Controller(protocols::hw::Device hw_device, helix::Mapping mapping,
+			helix::UniqueDescriptor mmio, helix::UniqueIrq irq);
+
+	async::detached run();
+
+private:
+	async::detached _handleIrqs();
+
+	protocols::hw::Device _hwDevice;
+	helix::Mapping _mapping;
+	helix::UniqueDescriptor _mmio;
+	helix::UniqueIrq _irq;
+	arch::mem_space _space;
+
+	size_t _numSlots;
+	bool _supportsStaggeredSpinUp;
+	bool _supportsNcq;
+	bool _supports64Bit;
+
+	std::unique_ptr<Port> _ports[32];
+};
+
+#endif // AHCI_AHCI_HPP
@@ -0,0 +1,587 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <iostream>
+
+#include <async/result.hpp>
+#include <helix/ipc.hpp>
+#include <protocols/hw/client.hpp>
+#include <protocols/mbus/client.hpp>
+
+#include "ahci.hpp"
+
+namespace {
+	constexpr bool logRequests = false;
+
+	// Layout of the per-port DMA memory.
+	constexpr size_t commandListOffset = 0;
+	constexpr size_t receivedFisOffset = 0x400;
+	constexpr size_t identifyOffset = 0x600;
+	constexpr size_t commandTablesOffset = 0x800;
+	constexpr size_t portMemorySize = (commandTablesOffset
+			+ numCommandSlots * sizeof(CommandTable) + 0xFFF) & ~size_t(0xFFF);
+
+	// Timeouts in nanoseconds (see the AHCI and SATA specifications).
+	constexpr uint64_t hbaResetTimeout = 1'000'000'000;
+	constexpr uint64_t engineStopTimeout = 500'000'000;
+	constexpr uint64_t linkTimeout = 100'000'000;
+	constexpr uint64_t comResetDelay = 1'000'000;
+	// Includes the time that the device needs to spin up.
+	constexpr uint64_t deviceReadyTimeout = 10'000'000'000;
+
+	async::result<void> sleepFor(uint64_t nanos) {
+		uint64_t tick;
+		HEL_CHECK(helGetClock(&tick));
+
+		helix::AwaitClock await_clock;
+		auto &&submit = helix::submitAwaitClock(&await_clock, tick + nanos,
+				helix::Dispatcher::global());
+		co_await submit.async_wait();
+		HEL_CHECK(await_clock.error());
+	}
+
+	// Polls cond() every millisecond. Returns false if it does not become true
+	// within the timeout.
+	template<typename F>
+	async::result<bool> pollFor(uint64_t timeout, F cond) {
+		uint64_t start;
+		HEL_CHECK(helGetClock(&start));
+		while(!cond()) {
+			uint64_t now;
+			HEL_CHECK(helGetClock(&now));
+			if(now - start >= timeout)
+				co_return cond();
+			co_await sleepFor(1'000'000);
+		}
+		co_return true;
+	}
+}
+
+// --------------------------------------------------------
+// Port
+// --------------------------------------------------------
+
+Port::Port(Controller *controller, int number, arch::mem_space space)
+: BlockDevice{512}, _controller{controller}, _number{number}, _space{space} { }
+
+async::result<bool> Port::initialize() {
+	// Stop the command engine before touching the command list.
+	if(!(co_await _stopEngine(true))) {
+		printf("block/ahci: Port %d does not stop\n", _number);
+		co_return false;
+	}
+
+	// With staggered spin-up, the device is only spun up (and the PHY only starts
+	// to communicate) once PxCMD.SUD is set. The controller brings up one port at a time.
+	if(_controller->_supportsStaggeredSpinUp)
+		_space.store(port_regs::cmd, _space.load(port_regs::cmd) | port_cmd::spinUp);
+
+	bool linkUp = co_await pollFor(linkTimeout, [&] {
+		return (_space.load(port_regs::ssts) & sstsDetMask) == sstsDetPresent;
+	});
+	if(!linkUp)
+		co_return false;
+
+	HelHandle memory;
+	HEL_CHECK(helAllocateMemory(portMemorySize, kHelAllocContinuous, nullptr, &memory));
+	_memory = helix::UniqueDescriptor{memory};
+	_mapping = helix::Mapping{_memory, 0, portMemorySize};
+	memset(_mapping.get(), 0, portMemorySize);
+	_memoryPhysical = _physical(_mapping.get());
+
+	auto base = reinterpret_cast<char *>(_mapping.get());
+	_commandList = reinterpret_cast<CommandHeader *>(base + commandListOffset);
+	_commandTables = reinterpret_cast<CommandTable *>(base + commandTablesOffset);
+	_identifyData = reinterpret_cast<uint16_t *>(base + identifyOffset);
+
+	for(size_t i = 0; i < numCommandSlots; i++) {
+		uint64_t table = _memoryPhysical + commandTablesOffset + i * sizeof(CommandTable);
+		_commandList[i].tableBase = table;
+		_commandList[i].tableBaseUpper = table >> 32;
+	}
+
+	uint64_t commandList = _memoryPhysical + commandListOffset;
+	uint64_t receivedFis = _memoryPhysical + receivedFisOffset;
+	_space.store(port_regs::clb, commandList);
+	_space.store(port_regs::clbu, commandList >> 32);
+	_space.store(port_regs::fb, receivedFis);
+	_space.store(port_regs::fbu, receivedFis >> 32);
+
+	// Clear stale errors and IRQs and receive FISes. The signature is only valid
+	// once the device has sent its initial D2H register FIS.
+	_space.store(port_regs::serr, 0xFFFFFFFF);
+	_space.store(port_regs::is, 0xFFFFFFFF);
+	_space.store(port_regs::cmd, _space.load(port_regs::cmd) | port_cmd::fisReceiveEnable);
+	bool ready = co_await pollFor(deviceReadyTimeout, [&] {
+		return !(_space.load(port_regs::tfd) & (port_tfd::bsy | port_tfd::drq));
+	});
+	if(!ready) {
+		printf("block/ahci: Device on port %d does not become ready\n", _number);
+		co_await _stopEngine(true);
+		co_return false;
+	}
+
+	auto sig = _space.load(port_regs::sig);
+	if(sig != sigSataDisk) {
+		printf("block/ahci: Ignoring port %d with signature 0x%x\n", _number, sig);
+		co_await _stopEngine(true);
+		co_return false;
+	}
+
+	_space.store(port_regs::cmd, _space.load(port_regs::cmd) | port_cmd::start);
+	_space.store(port_regs::ie, port_irq::completion | port_irq::error);
+
+	_issueRequests();
+
+	if(!(co_await _submit(Command::identify, 0, _identifyData, 1))) {
+		printf("block/ahci: IDENTIFY failed on port %d\n", _number);
+		co_await shutdown();
+		co_return false;
+	}
+
+	if(!(_identifyData[83] & (1 << 10))) {
+		printf("block/ahci: Device on port %d does not support 48-bit LBA\n", _number);
+		co_await shutdown();
+		co_return false;
+	}
+	uint64_t numSectors = static_cast<uint64_t>(_identifyData[100])
+			| (static_cast<uint64_t>(_identifyData[101]) << 16)
+			| (static_cast<uint64_t>(_identifyData[102]) << 32)
+			| (static_cast<uint64_t>(_identifyData[103]) << 48);
+
+	// The model name is stored as big endian 16-bit words.
+	char model[41];
+	for(int i = 0; i < 20; i++) {
+		model[2 * i] = _identifyData[27 + i] >> 8;
+		model[2 * i + 1] = _identifyData[27 + i] & 0xFF;
+	}
+	model[40] = 0;
+
+	if(_controller->_supportsNcq && (_identifyData[76] & (1 << 8))) {
+		_useNcq = true;
+		_numSlots = std::min(_controller->_numSlots,
+				static_cast<size_t>((_identifyData[75] & 0x1F) + 1));
+	}
+
+	queueDepth = _numSlots;
+	maxMergedSectors = maxSectorsPerCommand;
+
+	printf("block/ahci: Port %d: '%s', %lu sectors, %s (%lu slots)\n",
+			_number, model, numSectors, _useNcq ? "NCQ" : "no NCQ", _numSlots);
+	co_return true;
+}
+
+async::result<void> Port::readSectors(uint64_t sector, void *buffer,
+		size_t num_sectors) {
+	if(!(co_await _submit(Command::read, sector, buffer, num_sectors)))
+		throw std::runtime_error("block/ahci: Read failed");
+}
+
+async::result<void> Port::writeSectors(uint64_t sector, const void *buffer,
+		size_t num_sectors) {
+	if(!(co_await _submit(Command::write, sector, const_cast<void *>(buffer), num_sectors)))
+		throw std::runtime_error("block/ahci: Write failed");
+}
+
+async::result<void> Port::shutdown() {
+	_space.store(port_regs::ie, 0);
+	co_await _stopEngine(true);
+	_broken = true;
+	_pendingDoorbell.ring();
+}
+
+async::result<bool> Port::_submit(Command command, uint64_t sector, void *buffer,
+		size_t num_sectors) {
+	assert(!(reinterpret_cast<uintptr_t>(buffer) & 1));
+	if(_broken)
+		co_return false;
+
+	// Split large requests such that each part fits into a command table.
+	// All parts are submitted at once so that they can be processed concurrently.
+	std::vector<std::unique_ptr<Request>> requests;
+	for(size_t progress = 0; progress < num_sectors; progress += maxSectorsPerCommand) {
+		auto request = std::make_unique<Request>();
+		request->command = command;
+		request->sector = sector + progress;
+		request->buffer = static_cast<char *>(buffer) + progress * sectorSize;
+		request->numSectors = std::min(num_sectors - progress, maxSectorsPerCommand);
+		_pendingQueue.push_back(request.get());
+		requests.push_back(std::move(request));
+	}
+	_pendingDoorbell.ring();
+
+	bool success = true;
+	for(auto &request : requests) {
+		if(!(co_await request->promise.async_get()))
+			success = false;
+	}
+	co_return success;
+}
+
+async::detached Port::_issueRequests() {
+	while(true) {
+		if(_broken) {
+			while(!_pendingQueue.empty()) {
+				_pendingQueue.front()->promise.set_value(false);
+				_pendingQueue.pop_front();
+			}
+			co_await _pendingDoorbell.async_wait();
+			continue;
+		}
+
+		// Non-queued commands must not overlap with any other command.
+		size_t limit = _useNcq ? _numSlots : 1;
+		if(_recovering || _pendingQueue.empty()
+				|| static_cast<size_t>(__builtin_popcount(_activeSlots)) >= limit) {
+			co_await _pendingDoorbell.async_wait();
+			continue;
+		}
+
+		// Issue as many commands as possible with a single register write.
+		uint32_t issue = 0;
+		while(!_pendingQueue.empty()
+				&& static_cast<size_t>(__builtin_popcount(_activeSlots | issue)) < limit) {
+			auto request = _pendingQueue.front();
+			_pendingQueue.pop_front();
+
+			int slot = __builtin_ctz(~(_activeSlots | issue));
+			assert(static_cast<size_t>(slot) < _numSlots);
+			if(logRequests)
+				std::cout << "block/ahci: Issuing " << request->numSectors
+						<< " sectors from " << request->sector
+						<< " in slot " << slot << std::endl;
+			_slots[slot] = request;
+			_setupCommand(slot, request);
+			issue |= uint32_t(1) << slot;
+		}
+
+		_activeSlots |= issue;
+		if(_useNcq)
+			_space.store(port_regs::sact, issue);
+		_space.store(port_regs::ci, issue);
+	}
+}
+
+void Port::_setupCommand(int slot, Request *request) {
+	auto header = &_commandList[slot];
+	auto table = &_commandTables[slot];
+	bool isWrite = request->command == Command::write;
+
+	// Emit one PRD entry per page of the buffer.
+	auto address = reinterpret_cast<uintptr_t>(request->buffer);
+	size_t size = request->numSectors * sectorSize;
+	size_t n = 0;
+	for(size_t progress = 0; progress < size; ) {
+		auto chunk = std::min(size - progress, 0x1000 - ((address + progress) & 0xFFF));
+		assert(n < numPrdEntries);
+
+		// TODO: The physical page can change (see helPointerPhysical()). Lock the memory instead!
+		uint64_t physical = _physical(reinterpret_cast<void *>(address + progress));
+		table->prdt[n].base = physical;
+		table->prdt[n].baseUpper = physical >> 32;
+		table->prdt[n].reserved = 0;
+		table->prdt[n].flags = chunk - 1;
+		n++;
+		progress += chunk;
+	}
+
+	auto fis = reinterpret_cast<FisH2d *>(table->commandFis);
+	memset(fis, 0, sizeof(FisH2d));
+	fis->type = fisTypeH2d;
+	fis->flags = fisH2dCommand;
+
+	if(request->command == Command::identify) {
+		fis->command = ata::identify;
+	}else{
+		fis->device = ata::deviceLba;
+		fis->lba0 = request->sector & 0xFF;
+		fis->lba1 = (request->sector >> 8) & 0xFF;
+		fis->lba2 = (request->sector >> 16) & 0xFF;
+		fis->lba3 = (request->sector >> 24) & 0xFF;
+		fis->lba4 = (request->sector >> 32) & 0xFF;
+		fis->lba5 = (request->sector >> 40) & 0xFF;
+
+		if(_useNcq) {
+			// FPDMA commands pass the sector count in the features field
+			// and the tag in bits 3-7 of the count field.
+			fis->command = isWrite ? ata::writeFpdmaQueued : ata::readFpdmaQueued;
+			fis->featureLow = request->numSectors & 0xFF;
+			fis->featureHigh = (request->numSectors >> 8) & 0xFF;
+			fis->countLow = slot << 3;
+		}else{
+			fis->command = isWrite ? ata::writeDmaExt : ata::readDmaExt;
+			fis->countLow = request->numSectors & 0xFF;
+			fis->countHigh = (request->numSectors >> 8) & 0xFF;
+		}
+	}
+
+	header->flags = ((sizeof(FisH2d) / 4) << command_flags::fisLengthShift)
+			| (isWrite ? command_flags::write : 0);
+	header->prdtLength = n;
+	header->prdByteCount = 0;
+}
+
+void Port::handleIrq() {
+	auto status = _space.load(port_regs::is);
+	_space.store(port_regs::is, status);
+	if(_recovering)
+		return;
+
+	if(status & port_irq::error) {
+		std::cout << "\e[31m" "block/ahci: Error on port " << _number
+				<< ", IS: 0x" << std::hex << status
+				<< ", TFD: 0x" << _space.load(port_regs::tfd)
+				<< ", SERR: 0x" << _space.load(port_regs::serr) << std::dec
+				<< "\e[39m" << std::endl;
+		_recovering = true;
+		_recover();
+		return;
+	}
+
+	_retireCompleted();
+}
+
+void Port::_retireCompleted() {
+	// Retire all commands that the HBA has finished. A single IRQ
+	// usually covers multiple commands (in particular with NCQ).
+	auto outstanding = _space.load(port_regs::ci);
+	if(_useNcq)
+		outstanding |= _space.load(port_regs::sact);
+	auto completed = _activeSlots & ~outstanding;
+	if(!completed)
+		return;
+	_activeSlots &= ~completed;
+
+	Request *retired[numCommandSlots];
+	size_t numRetired = 0;
+	for(size_t i = 0; i < numCommandSlots; i++) {
+		if(!(completed & (uint32_t(1) << i)))
+			continue;
+		assert(_slots[i]);
+		retired[numRetired++] = _slots[i];
+		_slots[i] = nullptr;
+	}
+
+	_pendingDoorbell.ring();
+	for(size_t i = 0; i < numRetired; i++)
+		retired[i]->promise.set_value(true);
+}
+
+// See section 6.2.2 of the AHCI specification.
+async::detached Port::_recover() {
+	// Commands that the HBA finished before the error did succeed.
+	_retireCompleted();
+
+	// Clearing PxCMD.ST also clears PxCI and PxSACT.
+	bool recovered = co_await _stopEngine(false);
+	_space.store(port_regs::serr, 0xFFFFFFFF);
+	_space.store(port_regs::is, 0xFFFFFFFF);
+
+	// If the device is still busy, it has to be reset by a COMRESET.
+	// After an NCQ error, the device also rejects queued commands until its error log
+	// is read; a COMRESET clears that state as well.
+	if(recovered && (_useNcq
+			|| (_space.load(port_regs::tfd) & (port_tfd::bsy | port_tfd::drq)))) {
+		auto sctl = _space.load(port_regs::sctl) & ~sctlDetMask;
+		_space.store(port_regs::sctl, sctl | sctlDetComReset);
+		co_await sleepFor(comResetDelay);
+		_space.store(port_regs::sctl, sctl);
+
+		recovered = co_await pollFor(linkTimeout, [&] {
+			return (_space.load(port_regs::ssts) & sstsDetMask) == sstsDetPresent;
+		});
+		if(recovered)
+			recovered = co_await pollFor(deviceReadyTimeout, [&] {
+				return !(_space.load(port_regs::tfd) & (port_tfd::bsy | port_tfd::drq));
+			});
+		_space.store(port_regs::serr, 0xFFFFFFFF);
+		_space.store(port_regs::is, 0xFFFFFFFF);
+	}
+
+	if(recovered) {
+		_space.store(port_regs::cmd, _space.load(port_regs::cmd) | port_cmd::start);
+	}else{
+		std::cout << "\e[31m" "block/ahci: Port " << _number
+				<< " cannot be recovered" "\e[39m" << std::endl;
+		_space.store(port_regs::ie, 0);
+		_broken = true;
+	}
+
+	// All commands that were still outstanding have been aborted.
+	Request *failed[numCommandSlots];
+	size_t numFailed = 0;
+	for(size_t i = 0; i < numCommandSlots; i++) {
+		if(!(_activeSlots & (uint32_t(1) << i)))
+			continue;
+		assert(_slots[i]);
+		failed[numFailed++] = _slots[i];
+		_slots[i] = nullptr;
+	}
+	_activeSlots = 0;
+	_recovering = false;
+
+	_pendingDoorbell.ring();
+	for(size_t i = 0; i < numFailed; i++)
+		failed[i]->promise.set_value(false);
+}
+
+async::result<bool> Port::_stopEngine(bool stopFisReceive) {
+	uint32_t enable = port_cmd::start;
+	uint32_t running = port_cmd::cmdListRunning;
+	if(stopFisReceive) {
+		enable |= port_cmd::fisReceiveEnable;
+		running |= port_cmd::fisReceiveRunning;
+	}
+
+	_space.store(port_regs::cmd, _space.load(port_regs::cmd) & ~enable);
+	co_return co_await pollFor(engineStopTimeout, [&] {
+		return !(_space.load(port_regs::cmd) & running);
+	});
+}
+
+uintptr_t Port::_physical(void *pointer) {
+	uintptr_t physical;
+	HEL_CHECK(helPointerPhysical(pointer, &physical));
+	if(!_controller->_supports64Bit && (physical >> 32))
+		throw std::runtime_error("block/ahci: Buffer is not reachable by the HBA");
+	return physical;
+}
+
+// --------------------------------------------------------
+// Controller
+// --------------------------------------------------------
+
+Controller::Controller(protocols::hw::Device hw_device, helix::Mapping mapping,
+		helix::UniqueDescriptor mmio, helix::UniqueIrq irq)
+: _hwDevice{std::move(hw_device)}, _mapping{std::move(mapping)},
+		_mmio{std::move(mmio)}, _irq{std::move(irq)},
+		_space{_mapping.get()} { }
+
+async::detached Controller::run() {
+	co_await _hwDevice.enableBusmaster();
+
+	// Reset the HBA to get into a well-defined state.
+	_space.store(regs::ghc, ghc::ahciEnable);
+	_space.store(regs::ghc, ghc::ahciEnable | ghc::hbaReset);
+	bool reset = co_await pollFor(hbaResetTimeout, [&] {
+		return !(_space.load(regs::ghc) & ghc::hbaReset);
+	});
+	if(!reset) {
+		printf("block/ahci: HBA reset timed out\n");
+		co_return;
+	}
+	_space.store(regs::ghc, ghc::ahciEnable);
+
+	auto caps = _space.load(regs::cap);
+	_numSlots = ((caps >> cap::numSlotsShift) & cap::numSlotsMask) + 1;
+	_supportsStaggeredSpinUp = caps & cap::staggeredSpinUp;
+	_supportsNcq = caps & cap::supportsNcq;
+	_supports64Bit = caps & cap::supports64Bit;
+	auto version = _space.load(regs::vs);
+	auto implemented = _space.load(regs::pi);
+	printf("block/ahci: AHCI %u.%u, %lu command slots, NCQ %s\n",
+			version >> 16, version & 0xFFFF, _numSlots,
+			_supportsNcq ? "supported" : "not supported");
+
+	// We need IRQs to complete the IDENTIFY commands below.
+	_handleIrqs();
+	co_await _hwDevice.enableBusIrq();
+	_space.store(regs::is, 0xFFFFFFFF);
+	_space.store(regs::ghc, ghc::ahciEnable | ghc::irqEnable);
+
+	for(int i = 0; i < 32; i++) {
+		if(!(implemented & (uint32_t(1) << i)))
+			continue;
+		// Ports that fail to initialize are kept alive since their request loop
+		// might already be running; they do not raise IRQs.
+		_ports[i] = std::make_unique<Port>(this, i, _space.subspace(0x100 + i * 0x80));
+		if(!(co_await _ports[i]->initialize()))
+			continue;
+		blockfs::runDevice(_ports[i].get());
+	}
+}
+
+async::detached Controller::_handleIrqs() {
+	uint64_t sequence = 0;
+
+	while(true) {
+		auto await = co_await helix_ng::awaitEvent(_irq, sequence);
+		HEL_CHECK(await.error());
+		sequence = await.sequence();
+
+		auto pending = _space.load(regs::is);
+		if(!pending) {
+			HEL_CHECK(helAcknowledgeIrq(_irq.getHandle(), kHelAckNack, sequence));
+			continue;
+		}
+
+		// Port IRQ status has to be cleared before the HBA's status.
+		for(int i = 0; i < 32; i++) {
+			if(!(pending & (uint32_t(1) << i)))
+				continue;
+			if(_ports[i]) {
+				_ports[i]->handleIrq();
+			}else{
+				auto space = _space.subspace(0x100 + i * 0x80);
+				space.store(port_regs::is, space.load(port_regs::is));
+			}
+		}
+		_space.store(regs::is, pending);
+		HEL_CHECK(helAcknowledgeIrq(_irq.getHandle(), kHelAckAcknowledge, sequence));
+	}
+}
+
+std::vector<std::shared_ptr<Controller>> globalControllers;
+
+// ------------------------------------------------------------------------
+// Freestanding PCI discovery functions.
+// ------------------------------------------------------------------------
+
+async::detached bindController(mbus::Entity entity) {
+	protocols::hw::Device device(co_await entity.bind());
+	auto info = co_await device.getPciInfo();
+	assert(info.barInfo[5].ioType == protocols::hw::IoType::kIoTypeMemory);
+	auto bar = co_await device.accessBar(5);
+	auto irq = co_await device.accessIrq();
+
+	helix::Mapping mapping{bar, info.barInfo[5].offset, info.barInfo[5].length};
+
+	auto controller = std::make_shared<Controller>(std::move(device), std::move(mapping),
+			std::move(bar), std::move(irq));
+	controller->run();
+	globalControllers.push_back(std::move(controller));
+}
+
+async::detached observeControllers() {
+	auto root = co_await mbus::Instance::global().getRoot();
+
+	auto filter = mbus::Conjunction({
+		mbus::EqualsFilter("pci-class", "01"),
+		mbus::EqualsFilter("pci-subclass", "06"),
+		mbus::EqualsFilter("pci-interface", "01")
+	});
+
+	auto handler = mbus::ObserverHandler{}
+	.withAttach([] (mbus::Entity entity, mbus::Properties) {
+		printf("block/ahci: Detected controller\n");
+		bindController(std::move(entity));
+	});
+
+	co_await root.linkObserver(std::move(filter), std::move(handler));
+}
+
+// --------------------------------------------------------
+// main() function
+// --------------------------------------------------------
+
+int main() {
+	printf("block/ahci: Starting driver\n");
+
+	{
+		async::queue_scope scope{helix::globalQueue()};
+		observeControllers();
+	}
+
+	async::run_forever(helix::globalQueue()->run_token(), helix::currentDispatcher);
+}
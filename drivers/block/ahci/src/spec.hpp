@@ -0,0 +1,176 @@
+#ifndef AHCI_SPEC_HPP
+#define AHCI_SPEC_HPP
+
+#include <stdint.h>
+
+#include <arch/register.hpp>
+
+// --------------------------------------------------------
+// HBA registers.
+// --------------------------------------------------------
+
+namespace regs {
+	inline constexpr arch::scalar_register<uint32_t> cap{0x00};
+	inline constexpr arch::scalar_register<uint32_t> ghc{0x04};
+	inline constexpr arch::scalar_register<uint32_t> is{0x08};
+	inline constexpr arch::scalar_register<uint32_t> pi{0x0C};
+	inline constexpr arch::scalar_register<uint32_t> vs{0x10};
+}
+
+namespace cap {
+	inline constexpr uint32_t numPortsMask = 0x1F;
+	inline constexpr int numSlotsShift = 8;
+	inline constexpr uint32_t numSlotsMask = 0x1F;
+	inline constexpr uint32_t staggeredSpinUp = 1u << 27;
+	inline constexpr uint32_t supportsNcq = 1u << 30;
+	inline constexpr uint32_t supports64Bit = 1u << 31;
+}
+
+namespace ghc {
+	inline constexpr uint32_t hbaReset = 1u << 0;
+	inline constexpr uint32_t irqEnable = 1u << 1;
+	inline constexpr uint32_t ahciEnable = 1u << 31;
+}
+
+// --------------------------------------------------------
+// Port registers (relative to 0x100 + port * 0x80).
+// --------------------------------------------------------
+
+namespace port_regs {
+	inline constexpr arch::scalar_register<uint32_t> clb{0x00};
+	inline constexpr arch::scalar_register<uint32_t> clbu{0x04};
+	inline constexpr arch::scalar_register<uint32_t> fb{0x08};
+	inline constexpr arch::scalar_register<uint32_t> fbu{0x0C};
+	inline constexpr arch::scalar_register<uint32_t> is{0x10};
+	inline constexpr arch::scalar_register<uint32_t> ie{0x14};
+	inline constexpr arch::scalar_register<uint32_t> cmd{0x18};
+	inline constexpr arch::scalar_register<uint32_t> tfd{0x20};
+	inline constexpr arch::scalar_register<uint32_t> sig{0x24};
+	inline constexpr arch::scalar_register<uint32_t> ssts{0x28};
+	inline constexpr arch::scalar_register<uint32_t> sctl{0x2C};
+	inline constexpr arch::scalar_register<uint32_t> serr{0x30};
+	inline constexpr arch::scalar_register<uint32_t> sact{0x34};
+	inline constexpr arch::scalar_register<uint32_t> ci{0x38};
+}
+
+namespace port_cmd {
+	inline constexpr uint32_t start = 1u << 0;
+	inline constexpr uint32_t spinUp = 1u << 1;
+	inline constexpr uint32_t powerOn = 1u << 2;
+	inline constexpr uint32_t fisReceiveEnable = 1u << 4;
+	inline constexpr uint32_t fisReceiveRunning = 1u << 14;
+	inline constexpr uint32_t cmdListRunning = 1u << 15;
+}
+
+namespace port_irq {
+	inline constexpr uint32_t d2hRegisterFis = 1u << 0;
+	inline constexpr uint32_t pioSetupFis = 1u << 1;
+	inline constexpr uint32_t dmaSetupFis = 1u << 2;
+	inline constexpr uint32_t setDeviceBits = 1u << 3;
+	inline constexpr uint32_t interfaceFatal = 1u << 27;
+	inline constexpr uint32_t hostBusData = 1u << 28;
+	inline constexpr uint32_t hostBusFatal = 1u << 29;
+	inline constexpr uint32_t taskFileError = 1u << 30;
+
+	inline constexpr uint32_t completion = d2hRegisterFis | pioSetupFis
+			| dmaSetupFis | setDeviceBits;
+	inline constexpr uint32_t error = interfaceFatal | hostBusData
+			| hostBusFatal | taskFileError;
+}
+
+namespace port_tfd {
+	inline constexpr uint32_t err = 0x01;
+	inline constexpr uint32_t drq = 0x08;
+	inline constexpr uint32_t bsy = 0x80;
+}
+
+inline constexpr uint32_t sstsDetMask = 0x0F;
+inline constexpr uint32_t sstsDetPresent = 3;
+inline constexpr uint32_t sctlDetMask = 0x0F;
+inline constexpr uint32_t sctlDetComReset = 1;
+inline constexpr uint32_t sigSataDisk = 0x00000101;
+
+// --------------------------------------------------------
+// In-memory structures.
+// --------------------------------------------------------
+
+inline constexpr size_t numCommandSlots = 32;
+
+struct CommandHeader {
+	uint16_t flags;
+	uint16_t prdtLength;
+	uint32_t prdByteCount;
+	uint32_t tableBase;
+	uint32_t tableBaseUpper;
+	uint32_t reserved[4];
+};
+static_assert(sizeof(CommandHeader) == 32, "Bad sizeof(CommandHeader)");
+
+namespace command_flags {
+	// Length of the command FIS in dwords.
+	inline constexpr uint16_t fisLengthShift = 0;
+	inline constexpr uint16_t write = 1 << 6;
+	inline constexpr uint16_t prefetchable = 1 << 7;
+	inline constexpr uint16_t clearBusy = 1 << 10;
+}
+
+struct PrdEntry {
+	uint32_t base;
+	uint32_t baseUpper;
+	uint32_t reserved;
+	// Bits 0-21: byte count - 1. Bit 31: interrupt on completion.
+	uint32_t flags;
+};
+static_assert(sizeof(PrdEntry) == 16, "Bad sizeof(PrdEntry)");
+
+// Register FIS, host to device.
+struct FisH2d {
+	uint8_t type;
+	uint8_t flags;
+	uint8_t command;
+	uint8_t featureLow;
+	uint8_t lba0;
+	uint8_t lba1;
+	uint8_t lba2;
+	uint8_t device;
+	uint8_t lba3;
+	uint8_t lba4;
+	uint8_t lba5;
+	uint8_t featureHigh;
+	uint8_t countLow;
+	uint8_t countHigh;
+	uint8_t icc;
+	uint8_t control;
+	uint8_t reserved[4];
+};
+static_assert(sizeof(FisH2d) == 20, "Bad sizeof(FisH2d)");
+
+inline constexpr uint8_t fisTypeH2d = 0x27;
+inline constexpr uint8_t fisH2dCommand = 0x80;
+
+// Each command table holds the command FIS and a fixed number of PRD entries.
+inline constexpr size_t numPrdEntries = 56;
+
+struct CommandTable {
+	uint8_t commandFis[64];
+	uint8_t atapiCommand[16];
+	uint8_t reserved[48];
+	PrdEntry prdt[numPrdEntries];
+};
+static_assert(sizeof(CommandTable) == 1024, "Bad sizeof(CommandTable)");
+
+// --------------------------------------------------------
+// ATA commands.
+// --------------------------------------------------------
+
+namespace ata {
+	inline constexpr uint8_t readDmaExt = 0x25;
+	inline constexpr uint8_t writeDmaExt = 0x35;
+	inline constexpr uint8_t readFpdmaQueued = 0x60;
+	inline constexpr uint8_t writeFpdmaQueued = 0x61;
+	inline constexpr uint8_t identify = 0xEC;
+
+	inline constexpr uint8_t deviceLba = 0x40;
+}
+
+#endif // AHCI_SPEC_HPP
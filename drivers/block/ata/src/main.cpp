@@ -1,7 +1,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <algorithm>
 #include <iostream>
+#include <optional>
 #include <queue>
 
 #include <async/result.hpp>
@@ -9,6 +11,7 @@
 #include <arch/io_space.hpp>
 #include <arch/register.hpp>
 #include <helix/ipc.hpp>
+#include <helix/memory.hpp>
 #include <protocols/hw/client.hpp>
 #include <protocols/mbus/client.hpp>
 
@@ -39,6 +42,21 @@ namespace alt_regs {
 	inline constexpr arch::scalar_register<uint8_t> inStatus{0};
 }
 
+// Bus master IDE registers of the primary channel (relative to BAR4 of the PCI function).
+namespace bm_regs {
+	inline constexpr arch::scalar_register<uint8_t> command{0};
+	inline constexpr arch::scalar_register<uint8_t> status{2};
+	inline constexpr arch::scalar_register<uint32_t> prdTable{4};
+}
+
+// Physical region descriptor, i.e., an entry of the bus master's scatter-gather list.
+struct PrdEntry {
+	uint32_t base;
+	uint16_t size;
+	uint16_t flags;
+};
+static_assert(sizeof(PrdEntry) == 8, "Bad sizeof(PrdEntry)");
+
 class Controller : public blockfs::BlockDevice {
 	enum class IoResult {
 		none,
@@ -55,6 +73,9 @@ public:
 public:
 	async::detached run();
 
+	// Switches to bus master DMA. Before this is called, all requests use PIO.
+	void attachBusMaster(uint16_t offset, helix::UniqueDescriptor bar);
+
 private:
 	async::detached _doRequestLoop();
 	async::result<IoResult> _pollForBsy();
@@ -71,11 +92,29 @@ private:
 	enum Commands {
 		kCommandReadSectors = 0x20,
 		kCommandReadSectorsExt = 0x24,
+		kCommandReadDmaExt = 0x25,
 		kCommandWriteSectors = 0x30,
 		kCommandWriteSectorsExt = 0x34,
+		kCommandWriteDmaExt = 0x35,
+		kCommandReadDma = 0xC8,
+		kCommandWriteDma = 0xCA,
 		kCommandIdentify = 0xEC,
 	};
 
+	enum BusMasterFlags {
+		kBmCommandStart = 0x01,
+		kBmCommandRead = 0x08,
+
+		kBmStatusActive = 0x01,
+		kBmStatusError = 0x02,
+		kBmStatusIrq = 0x04,
+
+		kPrdEndOfTable = 0x8000
+	};
+
+	// A PRD table must not cross a 64 KiB boundary; a single page is sufficient.
+	static constexpr size_t maxPrdEntries = 0x1000 / sizeof(PrdEntry);
+
 	enum Flags {
 		kStatusErr = 0x01,
 		kStatusDrq = 0x08,
@@ -96,6 +135,12 @@ private:
 	};
 
 	async::result<void> _performRequest(Request *request);
+	void _setupTaskFile(Request *request);
+
+	// Returns false if the request cannot be done via DMA (e.g., because
+	// the buffer is not reachable by the bus master). Use PIO in that case.
+	async::result<bool> _performDmaRequest(Request *request);
+	bool _setupPrdTable(Request *request);
 
 	async::result<bool> _detectDevice();
 
@@ -108,6 +153,13 @@ private:
 
 	bool _supportsLBA48;
 
+	bool _useDma = false;
+	helix::UniqueDescriptor _bmBar;
+	arch::io_space _bmSpace;
+	helix::UniqueDescriptor _prdMemory;
+	helix::Mapping _prdMapping;
+	uintptr_t _prdPhysical;
+
 	uint64_t _irqSequence;
 };
 
@@ -130,6 +182,9 @@ async::detached Controller::run() {
 
 	_doRequestLoop();
 
+	// PIO commands transfer at most 255 sectors. DMA uses the same limit
+	// since we fall back to PIO on a per-request basis.
+	maxMergedSectors = 255;
 	blockfs::runDevice(this);
 }
 
@@ -263,11 +318,26 @@ async::result<bool> Controller::_detectDevice() {
 	co_return true;
 }
 
-async::result<void> Controller::_performRequest(Request *request) {
-	if(logRequests)
-		std::cout << "block/ata: Reading/writing " << request->numSectors
-				<< " sectors from " << request->sector << std::endl;
+void Controller::attachBusMaster(uint16_t offset, helix::UniqueDescriptor bar) {
+	HEL_CHECK(helEnableIo(bar.getHandle()));
+	_bmBar = std::move(bar);
+	_bmSpace = arch::io_space{offset};
+
+	HelHandle memory;
+	HEL_CHECK(helAllocateMemory(0x1000, kHelAllocContinuous, nullptr, &memory));
+	_prdMemory = helix::UniqueDescriptor{memory};
+	_prdMapping = helix::Mapping{_prdMemory, 0, 0x1000};
+	HEL_CHECK(helPointerPhysical(_prdMapping.get(), &_prdPhysical));
+	if((_prdPhysical & 0xFFFFFFFF) != _prdPhysical) {
+		std::cout << "block/ata: PRD table is not below 4 GiB, not using DMA" << std::endl;
+		return;
+	}
 
+	_useDma = true;
+	std::cout << "block/ata: Using bus master DMA" << std::endl;
+}
+
+void Controller::_setupTaskFile(Request *request) {
 	assert(!(request->sector & ~((size_t(1) << 48) - 1)));
 	assert(request->numSectors <= 255);
 
@@ -287,6 +357,85 @@ async::result<void> Controller::_performRequest(Request *request) {
 	_ioSpace.store(regs::outLba1, request->sector & 0xFF);
 	_ioSpace.store(regs::outLba2, (request->sector >> 8) & 0xFF);
 	_ioSpace.store(regs::outLba3, (request->sector >> 16) & 0xFF);
+}
+
+bool Controller::_setupPrdTable(Request *request) {
+	auto table = reinterpret_cast<PrdEntry *>(_prdMapping.get());
+	auto address = reinterpret_cast<uintptr_t>(request->buffer);
+	size_t size = request->numSectors * 512;
+	if(address & 1)
+		return false;
+
+	// Emit one entry per page. Since entries never cross pages,
+	// they also satisfy the bus master's 64 KiB boundary restriction.
+	size_t n = 0;
+	for(size_t progress = 0; progress < size; ) {
+		auto chunk = std::min(size - progress, 0x1000 - ((address + progress) & 0xFFF));
+		assert(n < maxPrdEntries);
+
+		// TODO: The physical page can change (see helPointerPhysical()). Lock the memory instead!
+		uintptr_t physical;
+		HEL_CHECK(helPointerPhysical(reinterpret_cast<void *>(address + progress), &physical));
+		if(physical + chunk > (uintptr_t(1) << 32))
+			return false;
+
+		table[n].base = physical;
+		table[n].size = chunk;
+		table[n].flags = 0;
+		n++;
+		progress += chunk;
+	}
+	assert(n);
+	table[n - 1].flags = kPrdEndOfTable;
+	return true;
+}
+
+async::result<bool> Controller::_performDmaRequest(Request *request) {
+	if(!_setupPrdTable(request))
+		co_return false;
+
+	// Make sure the bus master is stopped and its status is clear.
+	uint8_t direction = request->isWrite ? 0 : kBmCommandRead;
+	_bmSpace.store(bm_regs::command, direction);
+	_bmSpace.store(bm_regs::status, kBmStatusError | kBmStatusIrq);
+	_bmSpace.store(bm_regs::prdTable, _prdPhysical);
+
+	_setupTaskFile(request);
+	if(!request->isWrite) {
+		_ioSpace.store(regs::outCommand,
+				_supportsLBA48 ? kCommandReadDmaExt : kCommandReadDma);
+	}else{
+		_ioSpace.store(regs::outCommand,
+				_supportsLBA48 ? kCommandWriteDmaExt : kCommandWriteDma);
+	}
+	_bmSpace.store(bm_regs::command, direction | kBmCommandStart);
+
+	// The device raises a single IRQ once the entire transfer is done.
+	auto ioRes = co_await _waitForBsyIrq();
+	auto bmStatus = _bmSpace.load(bm_regs::status);
+	_bmSpace.store(bm_regs::command, direction);
+	_bmSpace.store(bm_regs::status, kBmStatusError | kBmStatusIrq);
+
+	// TODO: Report those errors to the caller.
+	assert(ioRes == IoResult::noData);
+	assert(!(bmStatus & kBmStatusError));
+	assert(!(bmStatus & kBmStatusActive));
+	co_return true;
+}
+
+async::result<void> Controller::_performRequest(Request *request) {
+	if(logRequests)
+		std::cout << "block/ata: Reading/writing " << request->numSectors
+				<< " sectors from " << request->sector << std::endl;
+
+	if(_useDma && (co_await _performDmaRequest(request))) {
+		if(logRequests)
+			std::cout << "block/ata: DMA to/from " << request->sector
+					<< " complete" << std::endl;
+		co_return;
+	}
+
+	_setupTaskFile(request);
 
 	if(!request->isWrite) {
 		if (_supportsLBA48)
@@ -342,6 +491,10 @@ async::result<void> Controller::_performRequest(Request *request) {
 
 std::vector<std::shared_ptr<Controller>> globalControllers;
 
+// Bus master registers of the PCI IDE function (if we found one).
+// The legacy controller and the PCI function are discovered independently.
+std::optional<std::pair<uint16_t, helix::UniqueDescriptor>> globalBusMaster;
+
 // ------------------------------------------------------------------------
 // Freestanding discovery functions.
 // ------------------------------------------------------------------------
@@ -359,10 +512,40 @@ async::detached bindController(mbus::Entity entity) {
 			info.barInfo[0].address, info.barInfo[1].address,
 			std::move(mainBar), std::move(altBar),
 			std::move(irq));
+	if(globalBusMaster) {
+		controller->attachBusMaster(globalBusMaster->first, std::move(globalBusMaster->second));
+		globalBusMaster = std::nullopt;
+	}
 	controller->run();
 	globalControllers.push_back(std::move(controller));
 }
 
+async::detached bindBusMaster(mbus::Entity entity) {
+	protocols::hw::Device device(co_await entity.bind());
+
+	// Bit 7 of the programming interface indicates bus master support.
+	auto progIf = co_await device.loadPciSpace(0x09, 1);
+	if(!(progIf & 0x80)) {
+		printf("block/ata: IDE controller does not support bus mastering\n");
+		co_return;
+	}
+
+	auto info = co_await device.getPciInfo();
+	if(info.barInfo[4].ioType != protocols::hw::IoType::kIoTypePort) {
+		printf("block/ata: IDE controller has no bus master registers\n");
+		co_return;
+	}
+	auto bar = co_await device.accessBar(4);
+	co_await device.enableBusmaster();
+
+	// We only drive the legacy primary channel; its bus master registers come first.
+	if(!globalControllers.empty()) {
+		globalControllers.front()->attachBusMaster(info.barInfo[4].address, std::move(bar));
+	}else{
+		globalBusMaster.emplace(info.barInfo[4].address, std::move(bar));
+	}
+}
+
 async::detached observeControllers() {
 	auto root = co_await mbus::Instance::global().getRoot();
 
@@ -379,6 +562,23 @@ async::detached observeControllers() {
 	co_await root.linkObserver(std::move(filter), std::move(handler));
 }
 
+async::detached observeBusMasters() {
+	auto root = co_await mbus::Instance::global().getRoot();
+
+	auto filter = mbus::Conjunction({
+		mbus::EqualsFilter("pci-class", "01"),
+		mbus::EqualsFilter("pci-subclass", "01")
+	});
+
+	auto handler = mbus::ObserverHandler{}
+	.withAttach([] (mbus::Entity entity, mbus::Properties) {
+		printf("block/ata: detected PCI IDE controller\n");
+		bindBusMaster(std::move(entity));
+	});
+
+	co_await root.linkObserver(std::move(filter), std::move(handler));
+}
+
 // --------------------------------------------------------
 // main() function
 // --------------------------------------------------------
@@ -389,6 +589,7 @@ int main() {
 	{
 		async::queue_scope scope{helix::globalQueue()};
 		observeControllers();
+		observeBusMasters();
 	}
 
 	async::run_forever(helix::globalQueue()->run_token(), helix::currentDispatcher);
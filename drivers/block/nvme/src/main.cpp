@@ -0,0 +1,564 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+#include <async/result.hpp>
+#include <helix/ipc.hpp>
+#include <protocols/hw/client.hpp>
+#include <protocols/mbus/client.hpp>
+
+#include "nvme.hpp"
+
+namespace {
+	constexpr bool logRequests = false;
+
+	// Number of I/O queue pairs that we ask the controller for.
+	constexpr size_t maxIoQueues = 4;
+	constexpr size_t adminQueueDepth = 16;
+	// Bounded by the width of Queue::_activeSlots and by the size
+	// of the submission queue (which has to fit into a single page).
+	constexpr size_t ioQueueDepth = 64;
+
+	// Size of a single PRP list; we only use one list per command.
+	constexpr size_t prpListEntries = 0x1000 / sizeof(uint64_t);
+
+	async::result<void> sleepFor(uint64_t nanos) {
+		uint64_t tick;
+		HEL_CHECK(helGetClock(&tick));
+
+		helix::AwaitClock await_clock;
+		auto &&submit = helix::submitAwaitClock(&await_clock, tick + nanos,
+				helix::Dispatcher::global());
+		co_await submit.async_wait();
+		HEL_CHECK(await_clock.error());
+	}
+
+	// Polls cond() every millisecond. Returns false if it does not become true
+	// within the timeout.
+	template<typename F>
+	async::result<bool> pollFor(uint64_t timeout, F cond) {
+		uint64_t start;
+		HEL_CHECK(helGetClock(&start));
+		while(!cond()) {
+			uint64_t now;
+			HEL_CHECK(helGetClock(&now));
+			if(now - start >= timeout)
+				co_return cond();
+			co_await sleepFor(1'000'000);
+		}
+		co_return true;
+	}
+
+	// Copies an ASCII field of an IDENTIFY structure and strips the padding.
+	void copyIdentifyString(char *out, const char *data, size_t length) {
+		memcpy(out, data, length);
+		out[length] = 0;
+		for(size_t i = length; i > 0 && out[i - 1] == ' '; i--)
+			out[i - 1] = 0;
+	}
+}
+
+// --------------------------------------------------------
+// Queue
+// --------------------------------------------------------
+
+Queue::Queue(Controller *controller, int id, size_t depth)
+: _controller{controller}, _id{id}, _depth{depth}, _slots(depth, nullptr) {
+	assert(depth <= ioQueueDepth);
+
+	size_t size = prpListsOffset + _depth * 0x1000;
+	HelHandle memory;
+	HEL_CHECK(helAllocateMemory(size, kHelAllocContinuous, nullptr, &memory));
+	_memory = helix::UniqueDescriptor{memory};
+	_mapping = helix::Mapping{_memory, 0, size};
+	memset(_mapping.get(), 0, size);
+	_memoryPhysical = _controller->_physical(_mapping.get());
+
+	auto base = reinterpret_cast<char *>(_mapping.get());
+	_sq = reinterpret_cast<SubmissionEntry *>(base + sqOffset);
+	_cq = reinterpret_cast<CompletionEntry *>(base + cqOffset);
+	_prpLists = reinterpret_cast<uint64_t *>(base + prpListsOffset);
+
+	_issueRequests();
+}
+
+void Queue::submit(Request *request) {
+	assert(!(reinterpret_cast<uintptr_t>(request->buffer) & 3));
+	_pendingQueue.push_back(request);
+}
+
+void Queue::issue() {
+	_pendingDoorbell.ring();
+}
+
+async::detached Queue::_issueRequests() {
+	// Keep one submission queue entry free; otherwise a full queue
+	// would be indistinguishable from an empty one.
+	size_t limit = _depth - 1;
+
+	while(true) {
+		if(_pendingQueue.empty()
+				|| static_cast<size_t>(__builtin_popcountll(_activeSlots)) >= limit) {
+			co_await _pendingDoorbell.async_wait();
+			continue;
+		}
+
+		while(!_pendingQueue.empty()
+				&& static_cast<size_t>(__builtin_popcountll(_activeSlots)) < limit) {
+			auto request = _pendingQueue.front();
+			_pendingQueue.pop_front();
+
+			int slot = __builtin_ctzll(~_activeSlots);
+			assert(static_cast<size_t>(slot) < _depth);
+			if(logRequests)
+				std::cout << "block/nvme: Issuing opcode " << (int)request->command.opcode
+						<< " on queue " << _id << " with ID " << slot << std::endl;
+			_slots[slot] = request;
+			_activeSlots |= uint64_t(1) << slot;
+
+			auto entry = &_sq[_sqTail];
+			*entry = request->command;
+			entry->commandId = slot;
+			_setupPrps(slot, request, entry);
+			_sqTail = (_sqTail + 1) % _depth;
+		}
+
+		// Pass the whole batch to the controller with a single doorbell write.
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		_controller->_space.store(_controller->_sqDoorbell(_id), _sqTail);
+	}
+}
+
+void Queue::_setupPrps(int slot, Request *request, SubmissionEntry *entry) {
+	auto address = reinterpret_cast<uintptr_t>(request->buffer);
+	size_t size = request->size;
+	entry->prp1 = 0;
+	entry->prp2 = 0;
+	if(!size)
+		return;
+
+	// TODO: The physical page can change (see helPointerPhysical()). Lock the memory instead!
+	// PRP1 may start anywhere within a page; all further entries are page aligned.
+	entry->prp1 = _controller->_physical(request->buffer);
+	size_t progress = 0x1000 - (address & 0xFFF);
+	if(progress >= size)
+		return;
+
+	// If the buffer spans exactly two pages, PRP2 points to the second page.
+	if(size - progress <= 0x1000) {
+		entry->prp2 = _controller->_physical(reinterpret_cast<void *>(address + progress));
+		return;
+	}
+
+	// Otherwise, PRP2 points to a list of the remaining pages.
+	auto list = _prpLists + slot * prpListEntries;
+	size_t n = 0;
+	for(; progress < size; progress += 0x1000) {
+		assert(n < prpListEntries);
+		list[n++] = _controller->_physical(reinterpret_cast<void *>(address + progress));
+	}
+	entry->prp2 = _memoryPhysical + prpListsOffset + slot * 0x1000;
+}
+
+bool Queue::processCompletions() {
+	Request *retired[ioQueueDepth];
+	size_t numRetired = 0;
+
+	// The controller inverts the phase tag each time it wraps around the queue.
+	while(true) {
+		auto entry = &_cq[_cqHead];
+		auto status = __atomic_load_n(&entry->status, __ATOMIC_ACQUIRE);
+		if((status & 1) != _cqPhase)
+			break;
+
+		auto slot = entry->commandId;
+		assert(slot < _depth && (_activeSlots & (uint64_t(1) << slot)));
+		auto request = _slots[slot];
+		request->status = status >> 1;
+		request->result = entry->result;
+		_slots[slot] = nullptr;
+		_activeSlots &= ~(uint64_t(1) << slot);
+		retired[numRetired++] = request;
+
+		if(++_cqHead == _depth) {
+			_cqHead = 0;
+			_cqPhase ^= 1;
+		}
+	}
+	if(!numRetired)
+		return false;
+
+	// Release all consumed entries with a single doorbell write.
+	_controller->_space.store(_controller->_cqDoorbell(_id), _cqHead);
+
+	_pendingDoorbell.ring();
+	for(size_t i = 0; i < numRetired; i++)
+		retired[i]->promise.set_value();
+	return true;
+}
+
+// --------------------------------------------------------
+// Namespace
+// --------------------------------------------------------
+
+Namespace::Namespace(Controller *controller, uint32_t nsid, size_t sector_size,
+		uint64_t num_sectors)
+: BlockDevice{sector_size}, _controller{controller}, _nsid{nsid},
+		_numSectors{num_sectors} {
+	_maxSectorsPerCommand = _controller->_maxTransferSize / sector_size;
+	assert(_maxSectorsPerCommand);
+
+	queueDepth = 0;
+	for(auto &queue : _controller->_ioQueues)
+		queueDepth += queue->depth() - 1;
+	maxMergedSectors = _maxSectorsPerCommand;
+}
+
+async::result<void> Namespace::readSectors(uint64_t sector, void *buffer,
+		size_t num_sectors) {
+	return _transfer(io_opcode::read, sector, buffer, num_sectors);
+}
+
+async::result<void> Namespace::writeSectors(uint64_t sector, const void *buffer,
+		size_t num_sectors) {
+	return _transfer(io_opcode::write, sector, const_cast<void *>(buffer), num_sectors);
+}
+
+async::result<void> Namespace::_transfer(uint8_t opcode, uint64_t sector, void *buffer,
+		size_t num_sectors) {
+	assert(sector + num_sectors <= _numSectors);
+
+	// Concurrent transfers are spread over the I/O queues. All parts of a single
+	// transfer go to the same queue such that they share a doorbell write.
+	auto queue = _controller->_pickQueue();
+
+	std::vector<std::unique_ptr<Request>> requests;
+	for(size_t progress = 0; progress < num_sectors; progress += _maxSectorsPerCommand) {
+		auto chunk = std::min(num_sectors - progress, _maxSectorsPerCommand);
+		uint64_t lba = sector + progress;
+
+		auto request = std::make_unique<Request>();
+		request->command.opcode = opcode;
+		request->command.nsid = _nsid;
+		request->command.cdw10 = lba & 0xFFFFFFFF;
+		request->command.cdw11 = lba >> 32;
+		request->command.cdw12 = chunk - 1;
+		request->buffer = static_cast<char *>(buffer) + progress * sectorSize;
+		request->size = chunk * sectorSize;
+		queue->submit(request.get());
+		requests.push_back(std::move(request));
+	}
+	queue->issue();
+
+	// Wait for all parts before failing; the controller still owns the remaining requests.
+	bool success = true;
+	for(auto &request : requests) {
+		co_await request->promise.async_get();
+		if(request->status) {
+			std::cout << "\e[31m" "block/nvme: Error on namespace " << _nsid
+					<< ", status: 0x" << std::hex << request->status << std::dec
+					<< "\e[39m" << std::endl;
+			success = false;
+		}
+	}
+	if(!success)
+		throw std::runtime_error("block/nvme: Giving up");
+}
+
+// --------------------------------------------------------
+// Controller
+// --------------------------------------------------------
+
+Controller::Controller(protocols::hw::Device hw_device, helix::Mapping mapping,
+		helix::UniqueDescriptor mmio, helix::UniqueIrq irq)
+: _hwDevice{std::move(hw_device)}, _mapping{std::move(mapping)},
+		_mmio{std::move(mmio)}, _irq{std::move(irq)},
+		_space{_mapping.get()} { }
+
+async::detached Controller::run() {
+	co_await _hwDevice.enableBusmaster();
+
+	uint64_t caps = static_cast<uint64_t>(_space.load(regs::capLow))
+			| (static_cast<uint64_t>(_space.load(regs::capHigh)) << 32);
+	_doorbellStride = size_t(4) << ((caps >> cap::doorbellStrideShift) & cap::doorbellStrideMask);
+	_maxQueueEntries = (caps & cap::maxQueueEntriesMask) + 1;
+	if(!(caps & cap::supportsNvmCommandSet)) {
+		printf("block/nvme: Controller does not support the NVM command set\n");
+		co_return;
+	}
+	if((caps >> cap::minPageSizeShift) & cap::minPageSizeMask) {
+		printf("block/nvme: Controller does not support 4 KiB pages\n");
+		co_return;
+	}
+
+	// CAP.TO bounds the time that CSTS.RDY takes to follow CC.EN.
+	uint64_t readyTimeout = ((caps >> cap::timeoutShift) & cap::timeoutMask) * 500'000'000;
+
+	// The admin queue can only be set up while the controller is disabled.
+	if(_space.load(regs::cc) & cc::enable) {
+		_space.store(regs::cc, 0);
+		bool disabled = co_await pollFor(readyTimeout, [&] {
+			return !(_space.load(regs::csts) & csts::ready);
+		});
+		if(!disabled) {
+			printf("block/nvme: Controller does not become disabled\n");
+			co_return;
+		}
+	}
+
+	_adminQueue = std::make_unique<Queue>(this, 0,
+			std::min(adminQueueDepth, _maxQueueEntries));
+	auto adminDepth = _adminQueue->depth();
+	_space.store(regs::aqa, ((adminDepth - 1) << 16) | (adminDepth - 1));
+	_space.store(regs::asqLow, _adminQueue->sqPhysical());
+	_space.store(regs::asqHigh, _adminQueue->sqPhysical() >> 32);
+	_space.store(regs::acqLow, _adminQueue->cqPhysical());
+	_space.store(regs::acqHigh, _adminQueue->cqPhysical() >> 32);
+
+	_space.store(regs::cc, cc::enable
+			| (6 << cc::sqEntrySizeShift) | (4 << cc::cqEntrySizeShift));
+	bool started = co_await pollFor(readyTimeout, [&] {
+		return _space.load(regs::csts) & (csts::ready | csts::fatal);
+	});
+	if(!started) {
+		printf("block/nvme: Controller does not become ready\n");
+		co_return;
+	}
+	if(_space.load(regs::csts) & csts::fatal) {
+		printf("block/nvme: Controller failed to start\n");
+		co_return;
+	}
+
+	// We need IRQs to complete the admin commands below.
+	_handleIrqs();
+	co_await _hwDevice.enableBusIrq();
+
+	HelHandle memory;
+	HEL_CHECK(helAllocateMemory(0x1000, kHelAllocContinuous, nullptr, &memory));
+	_identifyMemory = helix::UniqueDescriptor{memory};
+	_identifyMapping = helix::Mapping{_identifyMemory, 0, 0x1000};
+
+	SubmissionEntry identify{};
+	identify.opcode = admin_opcode::identify;
+	identify.cdw10 = identify_cns::controller;
+	co_await _submitAdmin(identify, _identifyMapping.get(), 0x1000);
+
+	auto data = reinterpret_cast<const char *>(_identifyMapping.get());
+	char model[identify_controller::modelLength + 1];
+	char serial[identify_controller::serialLength + 1];
+	copyIdentifyString(model, data + identify_controller::modelOffset,
+			identify_controller::modelLength);
+	copyIdentifyString(serial, data + identify_controller::serialOffset,
+			identify_controller::serialLength);
+
+	// The maximum transfer size is reported in units of the minimum page size (4 KiB).
+	_maxTransferSize = prpListEntries * 0x1000;
+	auto mdts = static_cast<uint8_t>(data[identify_controller::mdtsOffset]);
+	if(mdts && mdts < 20)
+		_maxTransferSize = std::min(_maxTransferSize, size_t(0x1000) << mdts);
+
+	auto version = _space.load(regs::vs);
+	printf("block/nvme: '%s' (serial '%s'), NVMe %u.%u, max. transfer %lu KiB\n",
+			model, serial, version >> 16, (version >> 8) & 0xFF,
+			_maxTransferSize / 1024);
+
+	co_await _setupIoQueues();
+	co_await _setupNamespaces();
+}
+
+async::result<uint32_t> Controller::_submitAdmin(SubmissionEntry command,
+		void *buffer, size_t size) {
+	Request request;
+	request.command = command;
+	request.buffer = buffer;
+	request.size = size;
+	_adminQueue->submit(&request);
+	_adminQueue->issue();
+
+	co_await request.promise.async_get();
+	if(request.status) {
+		printf("block/nvme: Admin command 0x%x failed with status 0x%x\n",
+				command.opcode, request.status);
+		throw std::runtime_error("block/nvme: Admin command failed");
+	}
+	co_return request.result;
+}
+
+async::result<void> Controller::_setupIoQueues() {
+	// Both counts are zero-based.
+	SubmissionEntry setQueues{};
+	setQueues.opcode = admin_opcode::setFeatures;
+	setQueues.cdw10 = feature::numQueues;
+	setQueues.cdw11 = ((maxIoQueues - 1) << 16) | (maxIoQueues - 1);
+	auto allocated = co_await _submitAdmin(setQueues);
+
+	size_t numQueues = std::min({maxIoQueues,
+			static_cast<size_t>(allocated & 0xFFFF) + 1,
+			static_cast<size_t>(allocated >> 16) + 1});
+	size_t depth = std::min(ioQueueDepth, _maxQueueEntries);
+
+	for(size_t i = 0; i < numQueues; i++) {
+		int qid = i + 1;
+		auto queue = std::make_unique<Queue>(this, qid, depth);
+
+		// protocols::hw only exposes the pin-based IRQ, hence all
+		// completion queues use interrupt vector 0.
+		SubmissionEntry createCq{};
+		createCq.opcode = admin_opcode::createCq;
+		createCq.prp1 = queue->cqPhysical();
+		createCq.cdw10 = ((depth - 1) << 16) | qid;
+		createCq.cdw11 = queue_flags::physicallyContiguous | queue_flags::irqEnable;
+		co_await _submitAdmin(createCq);
+
+		SubmissionEntry createSq{};
+		createSq.opcode = admin_opcode::createSq;
+		createSq.prp1 = queue->sqPhysical();
+		createSq.cdw10 = ((depth - 1) << 16) | qid;
+		createSq.cdw11 = (qid << 16) | queue_flags::physicallyContiguous;
+		co_await _submitAdmin(createSq);
+
+		_ioQueues.push_back(std::move(queue));
+	}
+
+	printf("block/nvme: Using %lu I/O queues with %lu entries each\n",
+			_ioQueues.size(), depth);
+}
+
+async::result<void> Controller::_setupNamespaces() {
+	SubmissionEntry listNamespaces{};
+	listNamespaces.opcode = admin_opcode::identify;
+	listNamespaces.cdw10 = identify_cns::activeNamespaces;
+	co_await _submitAdmin(listNamespaces, _identifyMapping.get(), 0x1000);
+
+	// The list is terminated by a zero entry unless it is full.
+	std::vector<uint32_t> nsids;
+	auto list = reinterpret_cast<const uint32_t *>(_identifyMapping.get());
+	for(size_t i = 0; i < 0x1000 / sizeof(uint32_t) && list[i]; i++)
+		nsids.push_back(list[i]);
+
+	for(auto nsid : nsids) {
+		SubmissionEntry identify{};
+		identify.opcode = admin_opcode::identify;
+		identify.nsid = nsid;
+		identify.cdw10 = identify_cns::nameSpace;
+		co_await _submitAdmin(identify, _identifyMapping.get(), 0x1000);
+
+		auto data = reinterpret_cast<const char *>(_identifyMapping.get());
+		uint64_t numSectors;
+		memcpy(&numSectors, data + identify_namespace::sizeOffset, sizeof(uint64_t));
+		auto index = data[identify_namespace::formattedLbaSizeOffset] & 0xF;
+		LbaFormat format;
+		memcpy(&format, data + identify_namespace::lbaFormatsOffset
+				+ index * sizeof(LbaFormat), sizeof(LbaFormat));
+
+		if(format.metadataSize) {
+			printf("block/nvme: Ignoring namespace %u with metadata\n", nsid);
+			continue;
+		}
+		size_t sectorSize = size_t(1) << format.lbaDataSize;
+		printf("block/nvme: Namespace %u: %lu sectors of %lu bytes\n",
+				nsid, numSectors, sectorSize);
+
+		_namespaces.push_back(std::make_unique<Namespace>(this, nsid, sectorSize, numSectors));
+	}
+
+	// libblockfs serves each device separately and names them in the order of the
+	// runDevice() calls. Only start the devices once all namespaces have been identified,
+	// so that the admin identify buffer is no longer in use and names follow the NSIDs.
+	for(auto &ns : _namespaces)
+		blockfs::runDevice(ns.get());
+}
+
+Queue *Controller::_pickQueue() {
+	assert(!_ioQueues.empty());
+	auto it = std::min_element(_ioQueues.begin(), _ioQueues.end(),
+			[] (const auto &a, const auto &b) { return a->load() < b->load(); });
+	return it->get();
+}
+
+async::detached Controller::_handleIrqs() {
+	uint64_t sequence = 0;
+
+	while(true) {
+		auto await = co_await helix_ng::awaitEvent(_irq, sequence);
+		HEL_CHECK(await.error());
+		sequence = await.sequence();
+
+		// All queues share the IRQ. Completing admin commands may create
+		// new I/O queues, hence we do not use iterators here.
+		bool any = _adminQueue->processCompletions();
+		for(size_t i = 0; i < _ioQueues.size(); i++) {
+			if(_ioQueues[i]->processCompletions())
+				any = true;
+		}
+
+		if(!any) {
+			HEL_CHECK(helAcknowledgeIrq(_irq.getHandle(), kHelAckNack, sequence));
+			continue;
+		}
+		HEL_CHECK(helAcknowledgeIrq(_irq.getHandle(), kHelAckAcknowledge, sequence));
+	}
+}
+
+uintptr_t Controller::_physical(void *pointer) {
+	uintptr_t physical;
+	HEL_CHECK(helPointerPhysical(pointer, &physical));
+	return physical;
+}
+
+std::vector<std::shared_ptr<Controller>> globalControllers;
+
+// ------------------------------------------------------------------------
+// Freestanding PCI discovery functions.
+// ------------------------------------------------------------------------
+
+async::detached bindController(mbus::Entity entity) {
+	protocols::hw::Device device(co_await entity.bind());
+	auto info = co_await device.getPciInfo();
+	assert(info.barInfo[0].ioType == protocols::hw::IoType::kIoTypeMemory);
+	auto bar = co_await device.accessBar(0);
+	auto irq = co_await device.accessIrq();
+
+	helix::Mapping mapping{bar, info.barInfo[0].offset, info.barInfo[0].length};
+
+	auto controller = std::make_shared<Controller>(std::move(device), std::move(mapping),
+			std::move(bar), std::move(irq));
+	controller->run();
+	globalControllers.push_back(std::move(controller));
+}
+
+async::detached observeControllers() {
+	auto root = co_await mbus::Instance::global().getRoot();
+
+	auto filter = mbus::Conjunction({
+		mbus::EqualsFilter("pci-class", "01"),
+		mbus::EqualsFilter("pci-subclass", "08"),
+		mbus::EqualsFilter("pci-interface", "02")
+	});
+
+	auto handler = mbus::ObserverHandler{}
+	.withAttach([] (mbus::Entity entity, mbus::Properties) {
+		printf("block/nvme: Detected controller\n");
+		bindController(std::move(entity));
+	});
+
+	co_await root.linkObserver(std::move(filter), std::move(handler));
+}
+
+// --------------------------------------------------------
+// main() function
+// --------------------------------------------------------
+
+int main() {
+	printf("block/nvme: Starting driver\n");
+
+	{
+		async::queue_scope scope{helix::globalQueue()};
+		observeControllers();
+	}
+
+	async::run_forever(helix::globalQueue()->run_token(), helix::currentDispatcher);
+}
@@ -0,0 +1,177 @@
+#ifndef NVME_NVME_HPP
+#define NVME_NVME_HPP
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <arch/mem_space.hpp>
+#include <async/doorbell.hpp>
+#include <async/result.hpp>
+#include <blockfs.hpp>
+#include <helix/ipc.hpp>
+#include <helix/memory.hpp>
+#include <protocols/hw/client.hpp>
+
+#include "spec.hpp"
+
+struct Controller;
+
+// A command together with its data buffer. The queue fills in the command ID
+// and the PRP entries before the command is submitted.
+struct Request {
+	SubmissionEntry command = {};
+	void *buffer = nullptr;
+	size_t size = 0;
+
+	// Set on completion.
+	uint16_t status = 0;
+	uint32_t result = 0;
+	async::promise<void> promise;
+};
+
+// --------------------------------------------------------
+// Queue
+// --------------------------------------------------------
+
+// A submission queue together with its completion queue.
+struct Queue {
+	Queue(Controller *controller, int id, size_t depth);
+
+	int id() { return _id; }
+	size_t depth() { return _depth; }
+	uintptr_t sqPhysical() { return _memoryPhysical + sqOffset; }
+	uintptr_t cqPhysical() { return _memoryPhysical + cqOffset; }
+
+	// Number of commands that are either pending or owned by the controller.
+	size_t load() { return _pendingQueue.size() + __builtin_popcountll(_activeSlots); }
+
+	// Queues a request; its promise is set once the controller has processed it.
+	// The request is not issued before the next call to issue().
+	void submit(Request *request);
+
+	// Issues all submitted requests. Requests that are submitted together
+	// are passed to the controller with a single doorbell write.
+	void issue();
+
+	// Retires all completion entries that the controller has posted.
+	// Returns true if there was at least one entry.
+	bool processCompletions();
+
+private:
+	static constexpr size_t sqOffset = 0;
+	static constexpr size_t cqOffset = 0x1000;
+	// One page of PRP entries per command ID.
+	static constexpr size_t prpListsOffset = 0x2000;
+
+	// Issues pending requests as long as there are free command IDs.
+	async::detached _issueRequests();
+
+	void _setupPrps(int slot, Request *request, SubmissionEntry *entry);
+
+	Controller *_controller;
+	int _id;
+	size_t _depth;
+
+	helix::UniqueDescriptor _memory;
+	helix::Mapping _mapping;
+	uintptr_t _memoryPhysical;
+	SubmissionEntry *_sq;
+	CompletionEntry *_cq;
+	uint64_t *_prpLists;
+
+	size_t _sqTail = 0;
+	size_t _cqHead = 0;
+	uint16_t _cqPhase = 1;
+
+	std::deque<Request *> _pendingQueue;
+	async::doorbell _pendingDoorbell;
+
+	// Requests that are owned by the controller (indexed by command ID).
+	std::vector<Request *> _slots;
+	uint64_t _activeSlots = 0;
+};
+
+// --------------------------------------------------------
+// Namespace
+// --------------------------------------------------------
+
+struct Namespace final : blockfs::BlockDevice {
+	Namespace(Controller *controller, uint32_t nsid, size_t sector_size,
+			uint64_t num_sectors);
+
+	async::result<void> readSectors(uint64_t sector, void *buffer,
+			size_t num_sectors) override;
+
+	async::result<void> writeSectors(uint64_t sector, const void *buffer,
+			size_t num_sectors) override;
+
+private:
+	async::result<void> _transfer(uint8_t opcode, uint64_t sector, void *buffer,
+			size_t num_sectors);
+
+	Controller *_controller;
+	uint32_t _nsid;
+	uint64_t _numSectors;
+	size_t _maxSectorsPerCommand;
+};
+
+// --------------------------------------------------------
+// Controller
+// --------------------------------------------------------
+
+struct Controller {
+	friend struct Queue;
+	friend struct Namespace;
+
+	Controller(protocols::hw::Device hw_device, helix::Mapping mapping,
+			helix::UniqueDescriptor mmio, helix::UniqueIrq irq);
+
+	async::detached run();
+
+private:
+	// Submits an admin command. Throws if the command fails.
+	async::result<uint32_t> _submitAdmin(SubmissionEntry command,
+			void *buffer = nullptr, size_t size = 0);
+
+	async::result<void> _setupIoQueues();
+
+	async::result<void> _setupNamespaces();
+
+	// Returns the I/O queue with the fewest outstanding commands.
+	Queue *_pickQueue();
+
+	async::detached _handleIrqs();
+
+	arch::scalar_register<uint32_t> _sqDoorbell(int qid) {
+		return arch::scalar_register<uint32_t>{doorbellOffset
+				+ static_cast<ptrdiff_t>(2 * qid) * _doorbellStride};
+	}
+
+	arch::scalar_register<uint32_t> _cqDoorbell(int qid) {
+		return arch::scalar_register<uint32_t>{doorbellOffset
+				+ static_cast<ptrdiff_t>(2 * qid + 1) * _doorbellStride};
+	}
+
+	uintptr_t _physical(void *pointer);
+
+	protocols::hw::Device _hwDevice;
+	helix::Mapping _mapping;
+	helix::UniqueDescriptor _mmio;
+	helix::UniqueIrq _irq;
+	arch::mem_space _space;
+
+	size_t _doorbellStride;
+	size_t _maxQueueEntries;
+	size_t _maxTransferSize;
+
+	// Page that receives the data of IDENTIFY commands.
+	helix::UniqueDescriptor _identifyMemory;
+	helix::Mapping _identifyMapping;
+
+	std::unique_ptr<Queue> _adminQueue;
+	std::vector<std::unique_ptr<Queue>> _ioQueues;
+	std::vector<std::unique_ptr<Namespace>> _namespaces;
+};
+
+#endif // NVME_NVME_HPP
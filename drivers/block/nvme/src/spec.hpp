@@ -0,0 +1,142 @@
+#ifndef NVME_SPEC_HPP
+#define NVME_SPEC_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <arch/register.hpp>
+
+// --------------------------------------------------------
+// Controller registers.
+// --------------------------------------------------------
+
+namespace regs {
+	inline constexpr arch::scalar_register<uint32_t> capLow{0x00};
+	inline constexpr arch::scalar_register<uint32_t> capHigh{0x04};
+	inline constexpr arch::scalar_register<uint32_t> vs{0x08};
+	inline constexpr arch::scalar_register<uint32_t> intms{0x0C};
+	inline constexpr arch::scalar_register<uint32_t> intmc{0x10};
+	inline constexpr arch::scalar_register<uint32_t> cc{0x14};
+	inline constexpr arch::scalar_register<uint32_t> csts{0x1C};
+	inline constexpr arch::scalar_register<uint32_t> aqa{0x24};
+	inline constexpr arch::scalar_register<uint32_t> asqLow{0x28};
+	inline constexpr arch::scalar_register<uint32_t> asqHigh{0x2C};
+	inline constexpr arch::scalar_register<uint32_t> acqLow{0x30};
+	inline constexpr arch::scalar_register<uint32_t> acqHigh{0x34};
+}
+
+// Offset of the first doorbell register.
+inline constexpr ptrdiff_t doorbellOffset = 0x1000;
+
+namespace cap {
+	inline constexpr uint64_t maxQueueEntriesMask = 0xFFFF;
+	// Worst-case time until CSTS.RDY changes, in units of 500 ms.
+	inline constexpr int timeoutShift = 24;
+	inline constexpr uint64_t timeoutMask = 0xFF;
+	inline constexpr int doorbellStrideShift = 32;
+	inline constexpr uint64_t doorbellStrideMask = 0xF;
+	inline constexpr uint64_t supportsNvmCommandSet = uint64_t(1) << 37;
+	inline constexpr int minPageSizeShift = 48;
+	inline constexpr uint64_t minPageSizeMask = 0xF;
+}
+
+namespace cc {
+	inline constexpr uint32_t enable = 1u << 0;
+	// Log2 of the submission and completion queue entry sizes.
+	inline constexpr int sqEntrySizeShift = 16;
+	inline constexpr int cqEntrySizeShift = 20;
+}
+
+namespace csts {
+	inline constexpr uint32_t ready = 1u << 0;
+	inline constexpr uint32_t fatal = 1u << 1;
+}
+
+// --------------------------------------------------------
+// Commands.
+// --------------------------------------------------------
+
+namespace admin_opcode {
+	inline constexpr uint8_t createSq = 0x01;
+	inline constexpr uint8_t createCq = 0x05;
+	inline constexpr uint8_t identify = 0x06;
+	inline constexpr uint8_t setFeatures = 0x09;
+}
+
+namespace io_opcode {
+	inline constexpr uint8_t flush = 0x00;
+	inline constexpr uint8_t write = 0x01;
+	inline constexpr uint8_t read = 0x02;
+}
+
+namespace identify_cns {
+	inline constexpr uint32_t nameSpace = 0x00;
+	inline constexpr uint32_t controller = 0x01;
+	inline constexpr uint32_t activeNamespaces = 0x02;
+}
+
+namespace feature {
+	inline constexpr uint32_t numQueues = 0x07;
+}
+
+namespace queue_flags {
+	inline constexpr uint32_t physicallyContiguous = 1u << 0;
+	inline constexpr uint32_t irqEnable = 1u << 1;
+}
+
+struct SubmissionEntry {
+	uint8_t opcode;
+	uint8_t flags;
+	uint16_t commandId;
+	uint32_t nsid;
+	uint32_t reserved[2];
+	uint64_t metadata;
+	uint64_t prp1;
+	uint64_t prp2;
+	uint32_t cdw10;
+	uint32_t cdw11;
+	uint32_t cdw12;
+	uint32_t cdw13;
+	uint32_t cdw14;
+	uint32_t cdw15;
+};
+static_assert(sizeof(SubmissionEntry) == 64, "Bad sizeof(SubmissionEntry)");
+
+struct CompletionEntry {
+	uint32_t result;
+	uint32_t reserved;
+	uint16_t sqHead;
+	uint16_t sqId;
+	uint16_t commandId;
+	// Bit 0: phase tag. Bits 1-15: status field.
+	uint16_t status;
+};
+static_assert(sizeof(CompletionEntry) == 16, "Bad sizeof(CompletionEntry)");
+
+// --------------------------------------------------------
+// Identify data structures (only the fields that we use).
+// --------------------------------------------------------
+
+namespace identify_controller {
+	inline constexpr size_t serialOffset = 4;
+	inline constexpr size_t serialLength = 20;
+	inline constexpr size_t modelOffset = 24;
+	inline constexpr size_t modelLength = 40;
+	// Log2 of the maximum transfer size in units of the minimum page size.
+	inline constexpr size_t mdtsOffset = 77;
+}
+
+namespace identify_namespace {
+	inline constexpr size_t sizeOffset = 0;
+	inline constexpr size_t formattedLbaSizeOffset = 26;
+	inline constexpr size_t lbaFormatsOffset = 128;
+}
+
+struct LbaFormat {
+	uint16_t metadataSize;
+	uint8_t lbaDataSize;
+	uint8_t relativePerformance;
+};
+static_assert(sizeof(LbaFormat) == 4, "Bad sizeof(LbaFormat)");
+
+#endif // NVME_SPEC_HPP
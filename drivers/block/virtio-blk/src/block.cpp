@@ -45,6 +45,9 @@ void Device::runDevice() {
 	// setup an interrupt for the device
 	_processRequests();
 
+	// readSectors() splits requests into chunks of a quarter of the virtq,
+	// hence the device can usually process four requests concurrently.
+	queueDepth = 4;
 	blockfs::runDevice(this);
 }
 
@@ -383,8 +383,8 @@ uint32_t GfxDevice::FrameBuffer::getPixelPitch() {
 	return _pixelPitch;
 }
 
-void GfxDevice::FrameBuffer::notifyDirty() {
-	
+void GfxDevice::FrameBuffer::notifyDirty(const std::vector<drm_clip_rect> &) {
+	// We scan out directly from the buffer object; there is nothing to do.
 }
 
 // ----------------------------------------------------------------
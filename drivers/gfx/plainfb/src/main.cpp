@@ -2,6 +2,7 @@
 #include <assert.h>
 #include <immintrin.h>
 #include <stdio.h>
+#include <algorithm>
 #include <deque>
 #include <experimental/optional>
 #include <functional>
@@ -212,25 +213,12 @@ async::detached GfxDevice::Configuration::_dispatch() {
 		auto bo = _state->fb->getBufferObject();
 		assert(bo->getWidth() == _device->_screenWidth);
 		assert(bo->getHeight() == _device->_screenHeight);
-		auto dest = reinterpret_cast<char *>(_device->_fbMapping.get());
-		auto src = reinterpret_cast<char *>(bo->accessMapping());
-
-		if(_state->fb->fastScanout()) {
-			for(unsigned int k = 0; k < bo->getHeight(); k++) {
-				drm_core::fastCopy16(dest, src, bo->getWidth() * 4);
-				dest += _device->_screenPitch;
-				src += _state->fb->getPitch();
-			}
-		}else{
-			for(unsigned int k = 0; k < bo->getHeight(); k++) {
-				memcpy(dest, src, bo->getWidth() * 4);
-				dest += _device->_screenPitch;
-				src += _state->fb->getPitch();
-			}
-		}
+		_state->fb->blit(0, 0, bo->getWidth(), bo->getHeight());
+		_device->_scanoutFb = _state->fb;
 	}else if(_state) {
 		assert(!_state->mode);
 		std::cout << "gfx/plainfb: Disable scanout" << std::endl;
+		_device->_scanoutFb = nullptr;
 	}
 
 	complete();
@@ -292,9 +280,49 @@ GfxDevice::BufferObject *GfxDevice::FrameBuffer::getBufferObject() {
 	return _bo.get();
 }
 
-void GfxDevice::FrameBuffer::notifyDirty() {
-	// TODO: Re-blit the FrameBuffer if it is currently displayed.
-	std::cout << "gfx/plainfb: notifyDirty() is not implemented correctly" << std::endl;
+void GfxDevice::FrameBuffer::notifyDirty(const std::vector<drm_clip_rect> &clips) {
+	if(_device->_scanoutFb != this)
+		return;
+
+	if(clips.empty()) {
+		blit(0, 0, _bo->getWidth(), _bo->getHeight());
+		return;
+	}
+	for(auto &clip : clips)
+		blit(clip.x1, clip.y1, clip.x2, clip.y2);
+}
+
+void GfxDevice::FrameBuffer::blit(unsigned int x1, unsigned int y1,
+		unsigned int x2, unsigned int y2) {
+	x2 = std::min(x2, _bo->getWidth());
+	y2 = std::min(y2, _bo->getHeight());
+	if(x1 >= x2 || y1 >= y2)
+		return;
+
+	if(_fastScanout) {
+		// fastCopy16() moves 16 bytes (= 4 pixels) at a time.
+		x1 &= ~3u;
+		x2 = std::min((x2 + 3) & ~3u, _bo->getWidth());
+	}
+
+	auto dest = reinterpret_cast<char *>(_device->_fbMapping.get())
+			+ y1 * _device->_screenPitch + x1 * 4;
+	auto src = reinterpret_cast<char *>(_bo->accessMapping())
+			+ y1 * _pitch + x1 * 4;
+
+	if(_fastScanout) {
+		for(unsigned int k = y1; k < y2; k++) {
+			drm_core::fastCopy16(dest, src, (x2 - x1) * 4);
+			dest += _device->_screenPitch;
+			src += _pitch;
+		}
+	}else{
+		for(unsigned int k = y1; k < y2; k++) {
+			memcpy(dest, src, (x2 - x1) * 4);
+			dest += _device->_screenPitch;
+			src += _pitch;
+		}
+	}
 }
 
 // ----------------------------------------------------------------
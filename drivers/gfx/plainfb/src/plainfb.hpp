@@ -90,7 +90,10 @@ struct GfxDevice final : drm_core::Device, std::enable_shared_from_this<GfxDevic
 		bool fastScanout() { return _fastScanout; }
 
 		GfxDevice::BufferObject *getBufferObject();
-		void notifyDirty() override;
+		void notifyDirty(const std::vector<drm_clip_rect> &clips) override;
+
+		// Copies the given rectangle to the hardware frame buffer.
+		void blit(unsigned int x1, unsigned int y1, unsigned int x2, unsigned int y2);
 
 	private:
 		GfxDevice *_device;
@@ -127,6 +130,9 @@ private:
 
 	bool _claimedDevice = false;
 	bool _hardwareFbIsAligned = true;
+
+	// FrameBuffer that is currently scanned out (if any).
+	FrameBuffer *_scanoutFb = nullptr;
 };
 
 #endif // DRIVERS_GFX_PLAINFB_PLAINFB_HPP
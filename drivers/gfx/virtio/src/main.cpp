@@ -1,6 +1,7 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <algorithm>
 #include <deque>
 #include <optional>
 #include <functional>
@@ -418,18 +419,34 @@ GfxDevice::BufferObject *GfxDevice::FrameBuffer::getBufferObject() {
 	return _bo.get();
 }
 
-void GfxDevice::FrameBuffer::notifyDirty() {
-	_xferAndFlush();
+void GfxDevice::FrameBuffer::notifyDirty(const std::vector<drm_clip_rect> &clips) {
+	if(clips.empty()) {
+		_xferAndFlush({0, 0, _bo->getWidth(), _bo->getHeight()});
+		return;
+	}
+
+	// Transfer the bounding box of all clip rectangles.
+	uint32_t x1 = _bo->getWidth();
+	uint32_t y1 = _bo->getHeight();
+	uint32_t x2 = 0;
+	uint32_t y2 = 0;
+	for(auto &clip : clips) {
+		x1 = std::min(x1, static_cast<uint32_t>(clip.x1));
+		y1 = std::min(y1, static_cast<uint32_t>(clip.y1));
+		x2 = std::max(x2, std::min(static_cast<uint32_t>(clip.x2), _bo->getWidth()));
+		y2 = std::max(y2, std::min(static_cast<uint32_t>(clip.y2), _bo->getHeight()));
+	}
+	if(x1 >= x2 || y1 >= y2)
+		return;
+	_xferAndFlush({x1, y1, x2 - x1, y2 - y1});
 }
 
-async::detached GfxDevice::FrameBuffer::_xferAndFlush() {
+async::detached GfxDevice::FrameBuffer::_xferAndFlush(spec::Rect rect) {
 	spec::XferToHost2d xfer;
 	memset(&xfer, 0, sizeof(spec::XferToHost2d));
 	xfer.header.type = spec::cmd::xferToHost2d;
-	xfer.rect.x = 0;
-	xfer.rect.y = 0;
-	xfer.rect.width = _bo->getWidth();
-	xfer.rect.height = _bo->getHeight();
+	xfer.rect = rect;
+	xfer.offset = (rect.y * _bo->getWidth() + rect.x) * 4;
 	xfer.resourceId = _bo->hardwareId();
 
 	spec::Header xfer_result;
@@ -443,10 +460,7 @@ async::detached GfxDevice::FrameBuffer::_xferAndFlush() {
 	spec::ResourceFlush flush;
 	memset(&flush, 0, sizeof(spec::ResourceFlush));
 	flush.header.type = spec::cmd::resourceFlush;
-	flush.rect.x = 0;
-	flush.rect.y = 0;
-	flush.rect.width = _bo->getWidth();
-	flush.rect.height = _bo->getHeight();
+	flush.rect = rect;
 	flush.resourceId = _bo->hardwareId();
 
 	spec::Header flush_result;
@@ -103,8 +103,8 @@ struct GfxDevice final : drm_core::Device, std::enable_shared_from_this<GfxDevic
 		FrameBuffer(GfxDevice *device, std::shared_ptr<GfxDevice::BufferObject> bo);
 
 		GfxDevice::BufferObject *getBufferObject();
-		void notifyDirty() override;
-		async::detached _xferAndFlush();
+		void notifyDirty(const std::vector<drm_clip_rect> &clips) override;
+		async::detached _xferAndFlush(spec::Rect rect);
 
 	private:
 		std::shared_ptr<GfxDevice::BufferObject> _bo;
@@ -83,7 +83,7 @@ struct GfxDevice final : drm_core::Device, std::enable_shared_from_this<GfxDevic
 
 		GfxDevice::BufferObject *getBufferObject();
 		uint32_t getPixelPitch();
-		void notifyDirty() override;
+		void notifyDirty(const std::vector<drm_clip_rect> &clips) override;
 
 	private:
 		std::shared_ptr<GfxDevice::BufferObject> _bo;
@@ -0,0 +1,363 @@
+// Micro-benchmark for kernlets. Compiles kernlets that resemble those of our drivers,
+// loads them into this process and measures their execution time.
+// Device registers are simulated by plain memory.
+
+#include <assert.h>
+#include <elf.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+#include <fafnir/dsl.hpp>
+#include "common.hpp"
+
+namespace {
+
+constexpr size_t numIterations = 1'000'000;
+constexpr size_t imageSize = 0x10000;
+
+// Synthetic register state. Writes go to a separate array such that
+// all iterations observe the same state.
+alignas(8) uint32_t registers[64];
+uint32_t writtenRegisters[64];
+uint8_t ioRegisters[64];
+uint64_t numTriggers;
+
+uint8_t fakePioRead8(ptrdiff_t offset) {
+	return ioRegisters[offset];
+}
+
+uint16_t fakePioRead16(ptrdiff_t offset) {
+	uint16_t value;
+	memcpy(&value, ioRegisters + offset, sizeof(uint16_t));
+	return value;
+}
+
+void fakePioWrite16(ptrdiff_t offset, uint16_t value) {
+	writtenRegisters[offset / 4] = value;
+}
+
+uint8_t fakeMmioRead8(const char *base, ptrdiff_t offset) {
+	return *reinterpret_cast<const volatile uint8_t *>(base + offset);
+}
+
+uint32_t fakeMmioRead32(const char *base, ptrdiff_t offset) {
+	return *reinterpret_cast<const volatile uint32_t *>(base + offset);
+}
+
+void fakeMmioWrite32(char *, ptrdiff_t offset, uint32_t value) {
+	writtenRegisters[offset / 4] = value;
+}
+
+void fakeTriggerBitset(void *, uint32_t) {
+	numTriggers++;
+}
+
+void *resolveExternal(std::string_view name) {
+	if(name == "__pio_read8")
+		return reinterpret_cast<void *>(&fakePioRead8);
+	if(name == "__pio_read16")
+		return reinterpret_cast<void *>(&fakePioRead16);
+	if(name == "__pio_write16")
+		return reinterpret_cast<void *>(&fakePioWrite16);
+	if(name == "__mmio_read8")
+		return reinterpret_cast<void *>(&fakeMmioRead8);
+	if(name == "__mmio_read32")
+		return reinterpret_cast<void *>(&fakeMmioRead32);
+	if(name == "__mmio_write32")
+		return reinterpret_cast<void *>(&fakeMmioWrite32);
+	if(name == "__trigger_bitset")
+		return reinterpret_cast<void *>(&fakeTriggerBitset);
+	std::cerr << "kernletcc-bench: Could not resolve external " << name << std::endl;
+	abort();
+}
+
+// Loads a kernlet DSO in the same way as the kernel does. Returns its entry point.
+using KernletEntry = int (*)(const void *);
+
+KernletEntry loadKernlet(const std::vector<uint8_t> &elf) {
+	auto buffer = reinterpret_cast<const char *>(elf.data());
+	auto base = reinterpret_cast<char *>(mmap(nullptr, imageSize,
+			PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+	assert(base != MAP_FAILED);
+
+	Elf64_Ehdr ehdr;
+	memcpy(&ehdr, buffer, sizeof(Elf64_Ehdr));
+	assert(ehdr.e_ident[0] == 0x7F
+			&& ehdr.e_ident[1] == 'E'
+			&& ehdr.e_ident[2] == 'L'
+			&& ehdr.e_ident[3] == 'F');
+
+	Elf64_Dyn *dynamic = nullptr;
+	for(int i = 0; i < ehdr.e_phnum; i++) {
+		Elf64_Phdr phdr;
+		memcpy(&phdr, buffer + ehdr.e_phoff + i * ehdr.e_phentsize, sizeof(Elf64_Phdr));
+
+		if(phdr.p_type == PT_LOAD) {
+			assert(phdr.p_vaddr + phdr.p_memsz <= imageSize);
+			memcpy(base + phdr.p_vaddr, buffer + phdr.p_offset, phdr.p_filesz);
+		}else if(phdr.p_type == PT_DYNAMIC) {
+			dynamic = reinterpret_cast<Elf64_Dyn *>(base + phdr.p_vaddr);
+		}
+	}
+	assert(dynamic);
+
+	const char *str_tab = nullptr;
+	const Elf64_Sym *sym_tab = nullptr;
+	const Elf64_Word *hash_tab = nullptr;
+	const char *plt_rels = nullptr;
+	size_t plt_rel_sectionsize = 0;
+
+	for(size_t i = 0; dynamic[i].d_tag != DT_NULL; i++) {
+		auto ent = dynamic + i;
+		switch(ent->d_tag) {
+		case DT_STRTAB:
+			str_tab = base + ent->d_ptr;
+			break;
+		case DT_SYMTAB:
+			sym_tab = reinterpret_cast<const Elf64_Sym *>(base + ent->d_ptr);
+			break;
+		case DT_HASH:
+			hash_tab = reinterpret_cast<const Elf64_Word *>(base + ent->d_ptr);
+			break;
+		case DT_JMPREL:
+			plt_rels = base + ent->d_ptr;
+			break;
+		case DT_PLTRELSZ:
+			plt_rel_sectionsize = ent->d_val;
+			break;
+		default:
+			break;
+		}
+	}
+	assert(str_tab);
+	assert(sym_tab);
+	assert(hash_tab);
+
+	for(size_t off = 0; off < plt_rel_sectionsize; off += sizeof(Elf64_Rela)) {
+		auto reloc = reinterpret_cast<const Elf64_Rela *>(plt_rels + off);
+		assert(ELF64_R_TYPE(reloc->r_info) == R_X86_64_JUMP_SLOT);
+
+		auto rp = reinterpret_cast<uint64_t *>(base + reloc->r_offset);
+		auto symbol = sym_tab + ELF64_R_SYM(reloc->r_info);
+		*rp = reinterpret_cast<uint64_t>(resolveExternal(str_tab + symbol->st_name));
+	}
+
+	// The symbol table is small; a linear search is good enough.
+	auto num_symbols = hash_tab[1];
+	for(Elf64_Word i = 1; i < num_symbols; i++) {
+		auto symbol = sym_tab + i;
+		if(symbol->st_shndx == SHN_UNDEF)
+			continue;
+		if(std::string_view{str_tab + symbol->st_name} == "automate_irq")
+			return reinterpret_cast<KernletEntry>(base + symbol->st_value);
+	}
+	std::cerr << "kernletcc-bench: Kernlet has no entry point" << std::endl;
+	abort();
+}
+
+struct Program {
+	const char *name;
+	std::vector<uint8_t> code;
+	std::vector<BindType> bindTypes;
+	// Values of the offset bindings (in the order of the bindings).
+	std::vector<uint32_t> offsets;
+	// Sets up the register state. pending determines whether the IRQ
+	// was raised by the device or whether it is spurious.
+	void (*setup)(bool pending);
+};
+
+Program makeEhciProgram() {
+	Program program{"ehci"};
+	fnr::emit_to(std::back_inserter(program.code),
+		fnr::scope_push{} (
+			fnr::intrin{"__mmio_read32", 2, 1} (
+				fnr::binding{0},
+				fnr::binding{1} + fnr::literal{4}
+			) & fnr::literal{23}
+		),
+		fnr::check_if{},
+			fnr::scope_get{0},
+		fnr::then{},
+			fnr::intrin{"__mmio_write32", 3, 0} (
+				fnr::binding{0},
+				fnr::binding{1} + fnr::literal{4},
+				fnr::scope_get{0}
+			),
+			fnr::intrin{"__trigger_bitset", 2, 0} (
+				fnr::binding{2},
+				fnr::scope_get{0}
+			),
+			fnr::scope_push{} ( fnr::literal{1} ),
+		fnr::else_then{},
+			fnr::scope_push{} ( fnr::literal{2} ),
+		fnr::end{}
+	);
+	program.bindTypes = {BindType::memoryView, BindType::offset, BindType::bitsetEvent};
+	program.offsets = {0x20};
+	program.setup = [] (bool pending) {
+		registers[(0x20 + 4) / 4] = pending ? 1 : 0;
+	};
+	return program;
+}
+
+Program makeVirtioLegacyProgram() {
+	Program program{"virtio-legacy"};
+	fnr::emit_to(std::back_inserter(program.code),
+		fnr::scope_push{} (
+			fnr::intrin{"__pio_read8", 1, 1} (
+				fnr::binding{0} + fnr::literal{19}
+			) & fnr::literal{3}
+		),
+		fnr::check_if{},
+			fnr::scope_get{0},
+		fnr::then{},
+			fnr::intrin{"__trigger_bitset", 2, 0} (
+				fnr::binding{1},
+				fnr::scope_get{0}
+			),
+			fnr::scope_push{} ( fnr::literal{1} ),
+		fnr::else_then{},
+			fnr::scope_push{} ( fnr::literal{2} ),
+		fnr::end{}
+	);
+	program.bindTypes = {BindType::offset, BindType::bitsetEvent};
+	program.offsets = {0};
+	program.setup = [] (bool pending) {
+		ioRegisters[19] = pending ? 1 : 0;
+	};
+	return program;
+}
+
+Program makeXhciProgram() {
+	Program program{"xhci"};
+	fnr::emit_to(std::back_inserter(program.code),
+		fnr::scope_push{} (
+			fnr::intrin{"__mmio_read32", 2, 1} (
+				fnr::binding{0},
+				fnr::binding{2}
+			) & fnr::literal{1}
+		),
+		fnr::scope_push{} (
+			fnr::intrin{"__mmio_read32", 2, 1} (
+				fnr::binding{0},
+				fnr::binding{3}
+			) & fnr::literal{1}
+		),
+		fnr::scope_push{} (
+			fnr::scope_get{0} + fnr::scope_get{1} + fnr::scope_get{1}
+		),
+		fnr::check_if{},
+			fnr::scope_get{2},
+		fnr::then{},
+			fnr::intrin{"__mmio_write32", 3, 0} (
+				fnr::binding{0},
+				fnr::binding{1},
+				fnr::literal{8}
+			),
+			fnr::intrin{"__mmio_write32", 3, 0} (
+				fnr::binding{0},
+				fnr::binding{2},
+				fnr::scope_get{0} + fnr::literal{2}
+			),
+			fnr::intrin{"__mmio_write32", 3, 0} (
+				fnr::binding{0},
+				fnr::binding{3},
+				fnr::scope_get{1} + fnr::literal{2}
+			),
+			fnr::intrin{"__trigger_bitset", 2, 0} (
+				fnr::binding{4},
+				fnr::scope_get{2}
+			),
+			fnr::scope_push{} ( fnr::literal{1} ),
+		fnr::else_then{},
+			fnr::scope_push{} ( fnr::literal{2} ),
+		fnr::end{}
+	);
+	program.bindTypes = {BindType::memoryView, BindType::offset,
+			BindType::offset, BindType::offset, BindType::bitsetEvent};
+	program.offsets = {0x24, 0x40, 0x60};
+	program.setup = [] (bool pending) {
+		registers[0x40 / 4] = pending ? 3 : 2;
+		registers[0x60 / 4] = 2;
+	};
+	return program;
+}
+
+// Binds the parameters in the same layout as the kernel (one 8-byte slot per binding).
+void bindInstance(const Program &program, char *instance) {
+	size_t n = 0;
+	for(size_t i = 0; i < program.bindTypes.size(); i++) {
+		uint64_t value;
+		if(program.bindTypes[i] == BindType::offset) {
+			assert(n < program.offsets.size());
+			value = program.offsets[n++];
+		}else if(program.bindTypes[i] == BindType::memoryView) {
+			value = reinterpret_cast<uint64_t>(registers);
+		}else{
+			assert(program.bindTypes[i] == BindType::bitsetEvent);
+			value = reinterpret_cast<uint64_t>(&numTriggers);
+		}
+		memcpy(instance + 8 * i, &value, sizeof(uint64_t));
+	}
+}
+
+uint64_t currentNanos() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1'000'000'000ull + ts.tv_nsec;
+}
+
+void runBenchmark(const Program &program, bool optimize) {
+	auto elf = compileFafnir(program.code.data(), program.code.size(),
+			program.bindTypes, optimize);
+	auto entry = loadKernlet(elf);
+
+	alignas(8) char instance[64];
+	assert(program.bindTypes.size() * 8 <= sizeof(instance));
+	bindInstance(program, instance);
+
+	for(bool pending : {false, true}) {
+		memset(registers, 0, sizeof(registers));
+		memset(ioRegisters, 0, sizeof(ioRegisters));
+		program.setup(pending);
+
+		// Check that the kernlet ACKs exactly the IRQs that the device raised.
+		auto expected = pending ? 1 : 2;
+		if(entry(instance) != expected) {
+			std::cerr << "kernletcc-bench: " << program.name
+					<< " returned an unexpected value" << std::endl;
+			abort();
+		}
+
+		auto before = currentNanos();
+		for(size_t i = 0; i < numIterations; i++)
+			entry(instance);
+		auto elapsed = currentNanos() - before;
+
+		printf("kernletcc-bench: %-14s %-10s %-9s %6lu bytes, %6.2f ns/invocation\n",
+				program.name, optimize ? "optimized" : "baseline",
+				pending ? "pending" : "spurious", elf.size(),
+				static_cast<double>(elapsed) / numIterations);
+	}
+}
+
+} // anonymous namespace
+
+int main() {
+	std::vector<Program> programs{
+		makeEhciProgram(),
+		makeVirtioLegacyProgram(),
+		makeXhciProgram()
+	};
+
+	for(auto &program : programs) {
+		runBenchmark(program, false);
+		runBenchmark(program, true);
+	}
+	return 0;
+}
@@ -3,6 +3,8 @@
 
 #include <protocols/kernlet/compiler.hpp>
 
+// If optimize is set, constants are folded, branches with constant conditions
+// are eliminated and bindings are only loaded once per basic block.
 std::vector<uint8_t> compileFafnir(const uint8_t *code, size_t size,
-		const std::vector<BindType> &bind_types);
+		const std::vector<BindType> &bind_types, bool optimize = true);
 
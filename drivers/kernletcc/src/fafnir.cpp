@@ -1,6 +1,7 @@
-
 #include <stdint.h>
 #include <iostream>
+#include <optional>
+#include <unordered_map>
 #include <vector>
 #include <fafnir/language.h>
 #include <lewis/elf/object.hpp>
@@ -19,26 +20,45 @@ struct Scope {
 	lewis::BasicBlock *insertBb = nullptr;
 	lewis::Value *instance = nullptr;
 	std::vector<lewis::Value *> sstack;
+
+	// Dead scopes are never executed. We do not emit code for them;
+	// their values are represented by null pointers.
+	bool dead = false;
+
+	// Bindings that were already loaded in insertBb (indexed by binding).
+	// The instance is immutable, hence these loads can be reused.
+	std::unordered_map<unsigned int, lewis::Value *> loadedBindings;
 };
 
 struct Ite {
 	Scope *ifScope = nullptr;
 	Scope *elseScope = nullptr;
+
+	// Set if the condition is known at compile time (or if the ITE is dead).
+	// In this case, we do not emit a branch; the live scope continues
+	// the BB of the outer scope instead.
+	bool folded = false;
+	bool taken = false;
 };
 
 struct Compilation {
+	bool optimize;
 	std::vector<Binding> bindings;
 
 	lewis::Function fn;
 	std::vector<lewis::Value *> opstack;
 	std::vector<Scope *> activeScopes;
 	std::vector<Ite> activeBlocks;
+
+	// Values that are known at compile time.
+	std::unordered_map<lewis::Value *, uint32_t> constants;
 };
 
 std::vector<uint8_t> compileFafnir(const uint8_t *code, size_t size,
-		const std::vector<BindType> &bind_types) {
+		const std::vector<BindType> &bind_types, bool optimize) {
 	Compilation compilation;
 	Compilation *comp = &compilation;
+	comp->optimize = optimize;
 
 	auto initial_scope = new Scope;
 	initial_scope->insertBb = comp->fn.addBlock(std::make_unique<lewis::BasicBlock>());
@@ -78,6 +98,60 @@ std::vector<uint8_t> compileFafnir(const uint8_t *code, size_t size,
 		return str;
 	};
 
+	auto constantOf = [&] (lewis::Value *value) -> std::optional<uint32_t> {
+		auto it = comp->constants.find(value);
+		if(it == comp->constants.end())
+			return std::nullopt;
+		return it->second;
+	};
+
+	auto emitConstant = [&] (Scope *scope, uint32_t x) -> lewis::Value * {
+		auto inst = scope->insertBb->insertNewInstruction<lewis::LoadConstInstruction>(x);
+		auto result = inst->result.setNew<lewis::LocalValue>();
+		result->setType(lewis::globalInt32Type());
+		comp->constants[result] = x;
+		return result;
+	};
+
+	auto emitBinary = [&] (Scope *scope, lewis::BinaryMathOpcode math_opcode,
+			lewis::Value *left, lewis::Value *right) -> lewis::Value * {
+		if(comp->optimize) {
+			auto lc = constantOf(left);
+			auto rc = constantOf(right);
+			if(math_opcode == lewis::BinaryMathOpcode::add) {
+				if(lc && rc)
+					return emitConstant(scope, *lc + *rc);
+				if(lc && !*lc)
+					return right;
+				if(rc && !*rc)
+					return left;
+			}else{
+				assert(math_opcode == lewis::BinaryMathOpcode::bitwiseAnd);
+				if(lc && rc)
+					return emitConstant(scope, *lc & *rc);
+				if((lc && !*lc) || (rc && !*rc))
+					return emitConstant(scope, 0);
+			}
+		}
+
+		auto inst = scope->insertBb->insertNewInstruction<lewis::BinaryMathInstruction>(
+				math_opcode, left, right);
+		auto result = inst->result.setNew<lewis::LocalValue>();
+		result->setType(lewis::globalInt32Type());
+		return result;
+	};
+
+	// Creates a scope that continues the BB of the outer scope (for folded ITEs).
+	auto continueScope = [&] (Scope *outer, bool dead) -> Scope * {
+		auto inner = new Scope;
+		inner->insertBb = outer->insertBb;
+		inner->instance = outer->instance;
+		inner->sstack = outer->sstack;
+		inner->dead = dead;
+		inner->loadedBindings = outer->loadedBindings;
+		return inner;
+	};
+
 	while(s < code + size) {
 		assert(!comp->activeScopes.empty());
 		Scope *scope = comp->activeScopes.back();
@@ -92,33 +166,50 @@ std::vector<uint8_t> compileFafnir(const uint8_t *code, size_t size,
 		}else if(opcode == FNR_OP_LITERAL) {
 			auto operand = extractUint();
 
-			auto inst = scope->insertBb->insertNewInstruction<lewis::LoadConstInstruction>(operand);
-			auto result = inst->result.setNew<lewis::LocalValue>();
-			result->setType(lewis::globalInt32Type());
-			comp->opstack.push_back(result);
+			if(scope->dead) {
+				comp->opstack.push_back(nullptr);
+				continue;
+			}
+			comp->opstack.push_back(emitConstant(scope, operand));
 		}else if(opcode == FNR_OP_BINDING) {
 			auto index = extractUint();
 			assert(index < comp->bindings.size());
 
+			if(scope->dead) {
+				comp->opstack.push_back(nullptr);
+				continue;
+			}
+			if(comp->optimize) {
+				auto it = scope->loadedBindings.find(index);
+				if(it != scope->loadedBindings.end()) {
+					comp->opstack.push_back(it->second);
+					continue;
+				}
+			}
+
+			lewis::Value *value = nullptr;
 			if(comp->bindings[index].type == BindType::offset) {
 				auto inst = scope->insertBb->insertNewInstruction<lewis::LoadOffsetInstruction>(
 						scope->instance, comp->bindings[index].disp);
 				auto result = inst->result.setNew<lewis::LocalValue>();
 				result->setType(lewis::globalInt32Type());
-				comp->opstack.push_back(result);
+				value = result;
 			}else if(comp->bindings[index].type == BindType::memoryView) {
 				auto inst = scope->insertBb->insertNewInstruction<lewis::LoadOffsetInstruction>(
 						scope->instance, comp->bindings[index].disp);
 				auto result = inst->result.setNew<lewis::LocalValue>();
 				result->setType(lewis::globalPointerType());
-				comp->opstack.push_back(result);
+				value = result;
 			}else if(comp->bindings[index].type == BindType::bitsetEvent) {
 				auto inst = scope->insertBb->insertNewInstruction<lewis::LoadOffsetInstruction>(
 						scope->instance, comp->bindings[index].disp);
 				auto result = inst->result.setNew<lewis::LocalValue>();
 				result->setType(lewis::globalPointerType());
-				comp->opstack.push_back(result);
+				value = result;
 			}else assert(!"Unexpected binding type");
+
+			scope->loadedBindings[index] = value;
+			comp->opstack.push_back(value);
 		}else if(opcode == FNR_OP_S_DEFINE) {
 			assert(comp->opstack.size());
 			auto operand = comp->opstack.back();
@@ -137,11 +228,24 @@ std::vector<uint8_t> compileFafnir(const uint8_t *code, size_t size,
 			assert(comp->opstack.size() == 1);
 			assert(!comp->activeBlocks.empty());
 
-			// Add a jump to the current BB.
 			auto outer = scope;
 			auto operand = comp->opstack.back();
 			comp->opstack.pop_back();
 
+			// If the condition is known, only the taken branch is compiled.
+			auto condition = constantOf(operand);
+			if(outer->dead || (comp->optimize && condition)) {
+				auto ite = &comp->activeBlocks.back();
+				ite->folded = true;
+				ite->taken = !outer->dead && *condition;
+
+				auto inner = continueScope(outer, !ite->taken);
+				ite->ifScope = inner;
+				comp->activeScopes.push_back(inner);
+				continue;
+			}
+
+			// Add a jump to the current BB.
 			auto branch = outer->insertBb->setBranch(std::make_unique<lewis::ConditionalBranch>());
 			branch->operand = operand;
 
@@ -181,6 +285,15 @@ std::vector<uint8_t> compileFafnir(const uint8_t *code, size_t size,
 			// The previous scope ends here. It is still accessible via the Ite struct.
 			comp->activeScopes.pop_back();
 			auto outer = comp->activeScopes.back();
+
+			if(comp->activeBlocks.back().folded) {
+				auto ite = &comp->activeBlocks.back();
+				auto inner = continueScope(outer, outer->dead || ite->taken);
+				ite->elseScope = inner;
+				comp->activeScopes.push_back(inner);
+				continue;
+			}
+
 			auto branch = lewis::hierarchy_cast<lewis::ConditionalBranch *>(outer->insertBb->branch());
 
 			// Setup the scope with a new BB.
@@ -221,8 +334,32 @@ std::vector<uint8_t> compileFafnir(const uint8_t *code, size_t size,
 			auto ite = &comp->activeBlocks.back();
 			auto outer = comp->activeScopes.back();
 
+			if(ite->folded) {
+				auto n = ite->ifScope->sstack.size();
+				assert(n == ite->elseScope->sstack.size());
+				assert(n >= outer->sstack.size());
+
+				// The outer scope continues in the BB of the live scope.
+				auto live = ite->taken ? ite->ifScope : ite->elseScope;
+				if(!outer->dead) {
+					outer->insertBb = live->insertBb;
+					outer->instance = live->instance;
+					outer->loadedBindings = live->loadedBindings;
+					for(size_t i = 0; i < outer->sstack.size(); i++)
+						outer->sstack[i] = live->sstack[i];
+				}
+
+				// Push items from the inner sstack to the opstack.
+				for(size_t i = outer->sstack.size(); i < n; i++)
+					comp->opstack.push_back(outer->dead ? nullptr : live->sstack[i]);
+
+				comp->activeBlocks.pop_back();
+				continue;
+			}
+
 			// Set up a new BB for the existing scope.
 			outer->insertBb = comp->fn.addBlock(std::make_unique<lewis::BasicBlock>());
+			outer->loadedBindings.clear();
 			ite->ifScope->insertBb->setBranch(std::make_unique<lewis::UnconditionalBranch>(outer->insertBb));
 			ite->elseScope->insertBb->setBranch(std::make_unique<lewis::UnconditionalBranch>(outer->insertBb));
 
@@ -273,36 +410,35 @@ std::vector<uint8_t> compileFafnir(const uint8_t *code, size_t size,
 			}
 
 			comp->activeBlocks.pop_back();
-		}else if(opcode == FNR_OP_BITWISE_AND) {
-			assert(comp->opstack.size() >= 2);
-			auto right = comp->opstack.back();
-			comp->opstack.pop_back();
-			auto left = comp->opstack.back();
-			comp->opstack.pop_back();
-
-			auto inst = scope->insertBb->insertNewInstruction<lewis::BinaryMathInstruction>(
-					lewis::BinaryMathOpcode::bitwiseAnd, left, right);
-			auto result = inst->result.setNew<lewis::LocalValue>();
-			result->setType(lewis::globalInt32Type());
-			comp->opstack.push_back(result);
-		}else if(opcode == FNR_OP_ADD) {
+		}else if(opcode == FNR_OP_BITWISE_AND || opcode == FNR_OP_ADD) {
 			assert(comp->opstack.size() >= 2);
 			auto right = comp->opstack.back();
 			comp->opstack.pop_back();
 			auto left = comp->opstack.back();
 			comp->opstack.pop_back();
 
-			auto inst = scope->insertBb->insertNewInstruction<lewis::BinaryMathInstruction>(
-					lewis::BinaryMathOpcode::add, left, right);
-			auto result = inst->result.setNew<lewis::LocalValue>();
-			result->setType(lewis::globalInt32Type());
-			comp->opstack.push_back(result);
+			if(scope->dead) {
+				comp->opstack.push_back(nullptr);
+				continue;
+			}
+			comp->opstack.push_back(emitBinary(scope, (opcode == FNR_OP_ADD)
+					? lewis::BinaryMathOpcode::add : lewis::BinaryMathOpcode::bitwiseAnd,
+					left, right));
 		}else if(opcode == FNR_OP_INTRIN) {
 			int nargs = extractUint();
 			int nrvs = extractUint();
 			auto function = extractString();
 			assert(comp->opstack.size() >= nargs);
 
+			if(scope->dead) {
+				comp->opstack.resize(comp->opstack.size() - nargs);
+				for(int i = 0; i < nrvs; i++)
+					comp->opstack.push_back(nullptr);
+				continue;
+			}
+
+			// Note that intrinsics are never eliminated or merged (not even MMIO loads):
+			// device registers can change at any time and reads may have side effects.
 			auto inst = scope->insertBb->insertNewInstruction<lewis::InvokeInstruction>(
 					std::move(function), nargs, nrvs);
 			for(int i = nargs - 1; i >= 0; i--) {
@@ -2,6 +2,8 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <iostream>
+#include <string>
+#include <unordered_map>
 
 #include <async/jump.hpp>
 #include <helix/memory.hpp>
@@ -11,6 +13,10 @@
 
 static bool dumpHex = false;
 
+// Kernlet objects that were already uploaded, keyed by the bind types and the code.
+// Kernlet objects are immutable, hence the same object can be handed to all clients.
+std::unordered_map<std::string, helix::UniqueDescriptor> objectCache;
+
 // ----------------------------------------------------------------------------
 // kernletctl handling.
 // ----------------------------------------------------------------------------
@@ -117,21 +123,34 @@ async::detached serveCompiler(helix::UniqueLane lane) {
 				bind_types.push_back(bt);
 			}
 
-			auto elf = compileFafnir(reinterpret_cast<const uint8_t *>(recv_code.data()),
-					recv_code.length(), bind_types);
-
-			if(dumpHex) {
-				for(size_t i = 0; i < elf.size(); i++) {
-					printf("%02x", elf[i]);
-					if((i % 32) == 31)
-						putchar('\n');
-					else if((i % 8) == 7)
-						putchar(' ');
+			std::string key;
+			for(auto bt : bind_types)
+				key.push_back(static_cast<char>(bt));
+			key.push_back(0);
+			key.append(reinterpret_cast<const char *>(recv_code.data()), recv_code.length());
+
+			auto it = objectCache.find(key);
+			if(it == objectCache.end()) {
+				auto elf = compileFafnir(reinterpret_cast<const uint8_t *>(recv_code.data()),
+						recv_code.length(), bind_types);
+
+				if(dumpHex) {
+					for(size_t i = 0; i < elf.size(); i++) {
+						printf("%02x", elf[i]);
+						if((i % 32) == 31)
+							putchar('\n');
+						else if((i % 8) == 7)
+							putchar(' ');
+					}
+					putchar('\n');
 				}
-				putchar('\n');
-			}
 
-			auto object = co_await upload(elf.data(), elf.size(), bind_types);
+				auto object = co_await upload(elf.data(), elf.size(), bind_types);
+				it = objectCache.emplace(std::move(key), std::move(object)).first;
+			}else{
+				std::cout << "kernletcc: Using cached kernlet" << std::endl;
+			}
+			auto &object = it->second;
 
 			managarm::kernlet::SvrResponse resp;
 			resp.set_error(managarm::kernlet::Error::SUCCESS);
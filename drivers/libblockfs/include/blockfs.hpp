@@ -20,8 +20,18 @@ struct BlockDevice {
 	}
 
 	const size_t sectorSize;
+
+	// The following fields are used by the request scheduler
+	// that sits in front of the device. Drivers may adjust them before runDevice().
+
+	// Maximal number of requests that are submitted to the device concurrently.
+	size_t queueDepth = 1;
+	// Upper bound on the size of requests that are formed by merging.
+	size_t maxMergedSectors = 128;
 };
 
+// Parses the partition table of the device and exports its file systems.
+// May be called for multiple devices; posix assigns their names (sda, sdb, ...).
 async::detached runDevice(BlockDevice *device);
 
 } // namespace blockfs
@@ -12,14 +12,11 @@
 #include <blockfs.hpp>
 #include "gpt.hpp"
 #include "ext2fs.hpp"
+#include "scheduler.hpp"
 #include "fs.bragi.hpp"
 
 namespace blockfs {
 
-// TODO: Support more than one table.
-gpt::Table *table;
-ext2fs::FileSystem *fs;
-
 namespace {
 
 async::result<protocols::fs::SeekResult> seekAbs(void *object, int64_t offset) {
@@ -469,7 +466,7 @@ constexpr protocols::fs::NodeOperations nodeOperations{
 BlockDevice::BlockDevice(size_t sector_size)
 : sectorSize(sector_size) { }
 
-async::detached servePartition(helix::UniqueLane lane) {
+async::detached servePartition(helix::UniqueLane lane, ext2fs::FileSystem *fs) {
 	std::cout << "unix device: Connection" << std::endl;
 
 	while(true) {
@@ -584,7 +581,19 @@ async::detached servePartition(helix::UniqueLane lane) {
 }
 
 async::detached runDevice(BlockDevice *device) {
-	table = new gpt::Table(device);
+	// Device names have to be unique across all driver processes, hence posix names
+	// the devices. Partitions refer to an mbus object that represents the whole disk;
+	// they are numbered in the order in which they are exported.
+	auto root = co_await mbus::Instance::global().getRoot();
+	mbus::Properties disk_descriptor{
+		{"unix.devtype", mbus::StringItem{"disk"}}
+	};
+	auto disk = co_await root.createObject("disk", disk_descriptor, mbus::ObjectHandler{});
+	int numExported = 0;
+
+	// All I/O (including the partition table) goes through the scheduler.
+	auto scheduler = new Scheduler{device};
+	auto table = new gpt::Table(scheduler);
 	co_await table->parse();
 
 	for(size_t i = 0; i < table->numPartitions(); ++i) {
@@ -597,23 +606,22 @@ async::detached runDevice(BlockDevice *device) {
 			continue;
 		printf("It's a Windows data partition!\n");
 
-		fs = new ext2fs::FileSystem(&table->getPartition(i));
+		auto fs = new ext2fs::FileSystem(&table->getPartition(i));
 		co_await fs->init();
 		printf("ext2fs is ready!\n");
 
 		// Create an mbus object for the partition.
-		auto root = co_await mbus::Instance::global().getRoot();
-
 		mbus::Properties descriptor{
 			{"unix.devtype", mbus::StringItem{"block"}},
-			{"unix.devname", mbus::StringItem{"sda0"}}
+			{"drvcore.mbus-parent", mbus::StringItem{std::to_string(disk.getId())}},
+			{"block.partition", mbus::StringItem{std::to_string(numExported++)}}
 		};
 
 		auto handler = mbus::ObjectHandler{}
-		.withBind([] () -> async::result<helix::UniqueDescriptor> {
+		.withBind([fs] () -> async::result<helix::UniqueDescriptor> {
 			helix::UniqueLane local_lane, remote_lane;
 			std::tie(local_lane, remote_lane) = helix::createStream();
-			servePartition(std::move(local_lane));
+			servePartition(std::move(local_lane), fs);
 
 			async::promise<helix::UniqueDescriptor> promise;
 			promise.set_value(std::move(remote_lane));
@@ -0,0 +1,135 @@
+#include <assert.h>
+#include <iostream>
+
+#include <hel.h>
+#include <hel-syscalls.h>
+#include <helix/clock.hpp>
+
+#include "scheduler.hpp"
+
+namespace blockfs {
+
+namespace {
+	constexpr bool logStatistics = false;
+
+	size_t bucketOf(uint64_t value) {
+		size_t bucket = 0;
+		while(value && bucket < Scheduler::numBuckets - 1) {
+			value >>= 1;
+			bucket++;
+		}
+		return bucket;
+	}
+}
+
+Scheduler::Scheduler(BlockDevice *device)
+: BlockDevice{device->sectorSize}, _device{device} {
+	_dispatch();
+}
+
+async::result<void> Scheduler::readSectors(uint64_t sector, void *buffer,
+		size_t num_sectors) {
+	return _submit(false, sector, buffer, num_sectors);
+}
+
+async::result<void> Scheduler::writeSectors(uint64_t sector, const void *buffer,
+		size_t num_sectors) {
+	return _submit(true, sector, const_cast<void *>(buffer), num_sectors);
+}
+
+async::result<void> Scheduler::_submit(bool is_write, uint64_t sector, void *buffer,
+		size_t num_sectors) {
+	Request request{is_write, sector, buffer, num_sectors, helix::currentClock(), {}};
+
+	_pending.emplace(sector, &request);
+	_doorbell.ring();
+	co_await request.promise.async_get();
+}
+
+async::detached Scheduler::_dispatch() {
+	while(true) {
+		if(_pending.empty() || _inFlight >= _device->queueDepth) {
+			co_await _doorbell.async_wait();
+			continue;
+		}
+
+		// Serve requests in ascending sector order, then wrap around (C-LOOK).
+		auto it = _pending.lower_bound(_headPosition);
+		if(it == _pending.end())
+			it = _pending.begin();
+
+		std::vector<Request *> batch;
+		auto first = it->second;
+		size_t numSectors = first->numSectors;
+		batch.push_back(first);
+		it = _pending.erase(it);
+
+		// Merge requests that directly follow the first one. We only merge if the
+		// buffers are contiguous, too, since drivers do not take scatter lists.
+		while(it != _pending.end()) {
+			auto next = it->second;
+			auto last = batch.back();
+			if(next->sector != last->sector + last->numSectors
+					|| next->isWrite != first->isWrite
+					|| next->buffer != static_cast<char *>(last->buffer)
+							+ last->numSectors * sectorSize
+					|| numSectors + next->numSectors > _device->maxMergedSectors)
+				break;
+			numSectors += next->numSectors;
+			batch.push_back(next);
+			it = _pending.erase(it);
+		}
+
+		_headPosition = first->sector + numSectors;
+		_numMerged += batch.size() - 1;
+		_inFlight++;
+		_queueDepthHistogram[bucketOf(_inFlight)]++;
+		_issue(std::move(batch));
+	}
+}
+
+async::detached Scheduler::_issue(std::vector<Request *> batch) {
+	auto first = batch.front();
+	size_t numSectors = 0;
+	for(auto request : batch)
+		numSectors += request->numSectors;
+
+	if(first->isWrite) {
+		co_await _device->writeSectors(first->sector, first->buffer, numSectors);
+	}else{
+		co_await _device->readSectors(first->sector, first->buffer, numSectors);
+	}
+
+	auto now = helix::currentClock();
+	for(auto request : batch) {
+		_latencyHistogram[bucketOf((now - request->submitTime) / 1000)]++;
+		request->promise.set_value();
+	}
+
+	assert(_inFlight);
+	_inFlight--;
+	_doorbell.ring();
+
+	_numCompleted += batch.size();
+	if(logStatistics && !(_numCompleted % 1024))
+		dumpStatistics();
+}
+
+void Scheduler::dumpStatistics() {
+	std::cout << "libblockfs: " << _numCompleted << " requests completed, "
+			<< _numMerged << " merged" << std::endl;
+	for(size_t i = 0; i < numBuckets; i++) {
+		if(!_latencyHistogram[i])
+			continue;
+		std::cout << "    Latency < " << (uint64_t(1) << i) << " us: "
+				<< _latencyHistogram[i] << std::endl;
+	}
+	for(size_t i = 0; i < numBuckets; i++) {
+		if(!_queueDepthHistogram[i])
+			continue;
+		std::cout << "    Queue depth < " << (uint64_t(1) << i) << ": "
+				<< _queueDepthHistogram[i] << std::endl;
+	}
+}
+
+} // namespace blockfs
@@ -0,0 +1,75 @@
+#ifndef LIBBLOCKFS_SCHEDULER_HPP
+#define LIBBLOCKFS_SCHEDULER_HPP
+
+#include <array>
+#include <map>
+#include <vector>
+
+#include <async/doorbell.hpp>
+#include <blockfs.hpp>
+
+namespace blockfs {
+
+// Sits between the file system and the driver's BlockDevice.
+// Requests are collected from all coroutines, issued in elevator order
+// and merged if they are adjacent both on disk and in memory.
+// At most device->queueDepth requests are in flight at any time.
+struct Scheduler final : BlockDevice {
+	// Histograms use power-of-two buckets.
+	static constexpr size_t numBuckets = 32;
+
+	Scheduler(BlockDevice *device);
+
+	async::result<void> readSectors(uint64_t sector, void *buffer,
+			size_t num_sectors) override;
+
+	async::result<void> writeSectors(uint64_t sector, const void *buffer,
+			size_t num_sectors) override;
+
+	// Completion latency of requests (bucket i counts latencies < 2^i us).
+	const std::array<uint64_t, numBuckets> &latencyHistogram() {
+		return _latencyHistogram;
+	}
+
+	// Number of requests in flight whenever a request is issued to the device.
+	const std::array<uint64_t, numBuckets> &queueDepthHistogram() {
+		return _queueDepthHistogram;
+	}
+
+	void dumpStatistics();
+
+private:
+	struct Request {
+		bool isWrite;
+		uint64_t sector;
+		void *buffer;
+		size_t numSectors;
+		uint64_t submitTime;
+		async::promise<void> promise;
+	};
+
+	async::result<void> _submit(bool is_write, uint64_t sector, void *buffer,
+			size_t num_sectors);
+
+	async::detached _dispatch();
+
+	async::detached _issue(std::vector<Request *> batch);
+
+	BlockDevice *_device;
+
+	// Requests that were not issued yet, indexed by their first sector.
+	std::multimap<uint64_t, Request *> _pending;
+	// Sector behind the last issued request (for elevator ordering).
+	uint64_t _headPosition = 0;
+	size_t _inFlight = 0;
+	async::doorbell _doorbell;
+
+	uint64_t _numCompleted = 0;
+	uint64_t _numMerged = 0;
+	std::array<uint64_t, numBuckets> _latencyHistogram{};
+	std::array<uint64_t, numBuckets> _queueDepthHistogram{};
+};
+
+} // namespace blockfs
+
+#endif // LIBBLOCKFS_SCHEDULER_HPP
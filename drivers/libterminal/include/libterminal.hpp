@@ -32,6 +32,20 @@ struct Display {
 	virtual void setChar(int x, int y, char c, Attribute attribute) = 0;
 	virtual void setCursor(int x, int y) = 0;
 
+	// Draws count cells starting at (x, y). The default implementation
+	// calls setChar() for each cell; displays should override this if they
+	// can draw whole spans at once.
+	virtual void setChars(int x, int y, const char *c,
+			const Attribute *attributes, int count);
+
+	// Moves the cells inside the given rectangle by (dx, dy).
+	// Returns false if the display cannot do that; the Emulator then redraws
+	// the affected cells instead.
+	virtual bool moveRect(int x, int y, int width, int height, int dx, int dy);
+
+	// Called after each batch of updates, e.g. to flush damage to the hardware.
+	virtual void flush();
+
 	int width = 50;
 	int height = 10;
 };
@@ -46,11 +60,17 @@ struct Emulator {
 	};
 
 	void setChar(int x, int y, char c, Attribute attribute);
+	void scrollUp();
 	void handleControlSeq(char character);
 	void handleCsi(char character);
 	void printChar(char character);
 	void printString(std::string string);
 
+	// Draws all cells that changed since the last call and moves the cursor.
+	// printString() calls this unless coalesce is set; in that case, the owner
+	// of the Emulator is expected to call it once per refresh interval.
+	void flush();
+
 	Display *display;
 	Status status = kStatusNormal;
 	std::vector<int> params;
@@ -62,6 +82,13 @@ struct Emulator {
 	std::experimental::optional<int> currentNumber;
 	Attribute *attributes;
 	char *chars;
+
+	bool coalesce = false;
+	// Number of lines that were scrolled since the last flush().
+	int pendingScroll = 0;
+	// Per line, the range of columns [dirtyBegin, dirtyEnd) that need to be redrawn.
+	std::vector<int> dirtyBegin;
+	std::vector<int> dirtyEnd;
 };
 
 } // namespace libterminal
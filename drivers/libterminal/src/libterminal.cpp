@@ -1,10 +1,23 @@
 
+#include <algorithm>
 #include <libterminal.hpp>
 
 namespace libterminal {
 
 bool logSequences = false;
 
+void Display::setChars(int x, int y, const char *c,
+		const Attribute *attributes, int count) {
+	for(int i = 0; i < count; i++)
+		setChar(x + i, y, c[i], attributes[i]);
+}
+
+bool Display::moveRect(int, int, int, int, int, int) {
+	return false;
+}
+
+void Display::flush() { }
+
 Emulator::Emulator(Display *display) {
 	this->display = display;
 	this->height = display->height;
@@ -12,12 +25,59 @@ Emulator::Emulator(Display *display) {
 
 	chars = new char[width * height];
 	attributes = new Attribute[width * height];
+	memset(chars, ' ', width * height);
+
+	dirtyBegin.resize(height, width);
+	dirtyEnd.resize(height, 0);
 }
 
 void Emulator::setChar(int x, int y, char c, Attribute attribute) {
-	attributes[y * x + x] = attribute;
-	chars[y * x + x] = c;
-	display->setChar(x, y, c, attribute);
+	if(x < 0 || x >= width || y < 0 || y >= height)
+		return;
+	attributes[y * width + x] = attribute;
+	chars[y * width + x] = c;
+	dirtyBegin[y] = std::min(dirtyBegin[y], x);
+	dirtyEnd[y] = std::max(dirtyEnd[y], x + 1);
+}
+
+void Emulator::scrollUp() {
+	memmove(chars, chars + width, width * (height - 1));
+	std::copy(attributes + width, attributes + width * height, attributes);
+
+	// Pending damage moves together with the contents.
+	std::copy(dirtyBegin.begin() + 1, dirtyBegin.end(), dirtyBegin.begin());
+	std::copy(dirtyEnd.begin() + 1, dirtyEnd.end(), dirtyEnd.begin());
+	dirtyBegin[height - 1] = width;
+	dirtyEnd[height - 1] = 0;
+	pendingScroll++;
+
+	Attribute attribute;
+	for(int j = 0; j < width; j++)
+		setChar(j, height - 1, ' ', attribute);
+}
+
+void Emulator::flush() {
+	if(pendingScroll) {
+		// Let the display move everything at once; redraw otherwise.
+		if(pendingScroll >= height || !display->moveRect(0, pendingScroll,
+				width, height - pendingScroll, 0, -pendingScroll)) {
+			std::fill(dirtyBegin.begin(), dirtyBegin.end(), 0);
+			std::fill(dirtyEnd.begin(), dirtyEnd.end(), width);
+		}
+		pendingScroll = 0;
+	}
+
+	for(int i = 0; i < height; i++) {
+		if(dirtyBegin[i] >= dirtyEnd[i])
+			continue;
+		display->setChars(dirtyBegin[i], i, chars + i * width + dirtyBegin[i],
+				attributes + i * width + dirtyBegin[i], dirtyEnd[i] - dirtyBegin[i]);
+		dirtyBegin[i] = width;
+		dirtyEnd[i] = 0;
+	}
+
+	display->setCursor(cursorX, cursorY);
+	display->flush();
 }
 
 void Emulator::handleControlSeq(char character) {
@@ -33,7 +93,6 @@ void Emulator::handleControlSeq(char character) {
 		}else{
 			cursorY = 0;
 		}
-		display->setCursor(cursorX, cursorY);
 	}else if(character == 'B') {
 		int n = 1;
 		if(!params.empty())
@@ -46,7 +105,6 @@ void Emulator::handleControlSeq(char character) {
 		}else{
 			cursorY = height;
 		}
-		display->setCursor(cursorX, cursorY);
 	}else if(character == 'C') {
 		int n = 1;
 		if(!params.empty())
@@ -59,7 +117,6 @@ void Emulator::handleControlSeq(char character) {
 		}else{
 			cursorX = width;
 		}
-		display->setCursor(cursorX, cursorY);
 	}else if(character == 'D') {
 		int n = 1;
 		if(!params.empty())
@@ -72,7 +129,6 @@ void Emulator::handleControlSeq(char character) {
 		}else{
 			cursorX = 0;
 		}
-		display->setCursor(cursorX, cursorY);
 	}else if(character == 'E') {
 		int n = 1;
 		if(!params.empty())
@@ -84,7 +140,6 @@ void Emulator::handleControlSeq(char character) {
 			cursorY = height;
 		}
 		cursorX = 0;
-		display->setCursor(cursorX, cursorY);
 	}else if(character == 'F') {
 		int n = 1;
 		if(!params.empty())
@@ -96,7 +151,6 @@ void Emulator::handleControlSeq(char character) {
 			cursorY = 0;
 		}
 		cursorX = 0;
-		display->setCursor(cursorX, cursorY);
 	}else if(character == 'G') {
 		int n = 0;
 		if(!params.empty())
@@ -105,7 +159,6 @@ void Emulator::handleControlSeq(char character) {
 		if(n >= 0 && n <= width){
 			cursorX = n;
 		}
-		display->setCursor(cursorX, cursorY);
 	}else if(character == 'J') {
 		int n = 0;
 		if(!params.empty())
@@ -266,21 +319,9 @@ void Emulator::printChar(char character) {
 			}
 		}
 		if(cursorY >= height) {
-			for(int i = 1; i < height; i++) {
-				for(int j = 0; j < width; j++) {
-					char moved_char = chars[j * width + width];
-					Attribute moved_attribute = attributes[j * width + width];
-					setChar(j, i - 1, moved_char, moved_attribute);
-				}
-			}
-			for(int j = 0; j < width; j++) {
-				Attribute attribute;
-				attribute.fgColor = kColorWhite;
-				setChar(j, height - 1, ' ', attribute);
-			}
+			scrollUp();
 			cursorY = height - 1;
 		}
-		display->setCursor(cursorX, cursorY);
 	}else if(status == kStatusEscape) {
 		if(character == '[') {
 			status = kStatusCsi;
@@ -299,6 +340,8 @@ void Emulator::printString(std::string string){
 		}
 		printChar(string[i]);
 	}
+	if(!coalesce)
+		flush();
 }
 
 } // namespace libterminal
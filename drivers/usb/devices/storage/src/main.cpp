@@ -1,12 +1,14 @@
 
+#include <algorithm>
 #include <deque>
-#include <experimental/optional>
 #include <iostream>
+#include <optional>
 
 #include <stdlib.h>
 #include <assert.h>
 #include <stdio.h>
 
+#include <async/algorithm.hpp>
 #include <async/result.hpp>
 #include <protocols/mbus/client.hpp>
 #include <protocols/usb/usb.hpp>
@@ -24,20 +26,102 @@ namespace {
 	constexpr bool enableRead6 = false;
 }
 
-async::detached StorageDevice::run(int config_num, int intf_num) {
+namespace {
+	// Number of times a BOT command is retried after reset recovery.
+	constexpr int maxBotRetries = 3;
+
+	// Upper bound on the number of UAS commands in flight.
+	constexpr size_t maxUasTags = 16;
+}
+
+size_t StorageDevice::_buildCdb(Request *req, uint8_t *cdb) {
+	assert(req->numSectors);
+	assert(req->numSectors <= 0xFFFF);
+
+	if(!req->isWrite) {
+		if(enableRead6 && req->sector <= 0x1FFFFF && req->numSectors <= 0xFF) {
+			scsi::Read6 command;
+			memset(&command, 0, sizeof(scsi::Read6));
+			command.opCode = 0x08;
+			command.lba[0] = req->sector >> 16;
+			command.lba[1] = (req->sector >> 8) & 0xFF;
+			command.lba[2] = req->sector & 0xFF;
+			command.transferLength = req->numSectors;
+
+			memcpy(cdb, &command, sizeof(scsi::Read6));
+			return sizeof(scsi::Read6);
+		}else if(req->sector <= 0xFFFFFFFF) {
+			scsi::Read10 command;
+			memset(&command, 0, sizeof(scsi::Read10));
+			command.opCode = 0x28;
+			command.lba[0] = req->sector >> 24;
+			command.lba[1] = (req->sector >> 16) & 0xFF;
+			command.lba[2] = (req->sector >> 8) & 0xFF;
+			command.lba[3] = req->sector & 0xFF;
+			command.transferLength[0] = req->numSectors >> 8;
+			command.transferLength[1] = req->numSectors & 0xFF;
+
+			memcpy(cdb, &command, sizeof(scsi::Read10));
+			return sizeof(scsi::Read10);
+		}else{
+			throw std::logic_error("USB storage does not currently support high LBAs!");
+		}
+	}else{
+		if(req->sector <= 0xFFFFFFFF) {
+			scsi::Write10 command;
+			memset(&command, 0, sizeof(scsi::Write10));
+			command.opCode = 0x2A;
+			command.lba[0] = req->sector >> 24;
+			command.lba[1] = (req->sector >> 16) & 0xFF;
+			command.lba[2] = (req->sector >> 8) & 0xFF;
+			command.lba[3] = req->sector & 0xFF;
+			command.transferLength[0] = req->numSectors >> 8;
+			command.transferLength[1] = req->numSectors & 0xFF;
+
+			memcpy(cdb, &command, sizeof(scsi::Write10));
+			return sizeof(scsi::Write10);
+		}else{
+			throw std::logic_error("USB storage does not currently support high LBAs!");
+		}
+	}
+}
+
+async::detached StorageDevice::run(int config_num, int intf_num,
+		std::optional<int> bot_alternative, std::optional<int> uas_alternative) {
+	if(logSteps)
+		std::cout << "block-usb: Setting up configuration" << std::endl;
+
+	auto config = co_await _usbDevice.useConfiguration(config_num);
+	if(uas_alternative) {
+		if(co_await _runUas(config, intf_num, *uas_alternative))
+			co_return;
+		if(!bot_alternative)
+			co_return;
+		std::cout << "block-usb: Falling back to BOT" << std::endl;
+	}
+	co_await _runBot(std::move(config), intf_num, bot_alternative.value());
+}
+
+// --------------------------------------------------------
+// Bulk-Only Transport
+// --------------------------------------------------------
+
+async::result<void> StorageDevice::_runBot(Configuration config, int intf_num,
+		int alternative) {
 	auto descriptor = co_await _usbDevice.configurationDescriptor();
 
-	std::experimental::optional<int> in_endp_number;
-	std::experimental::optional<int> out_endp_number;
-	
+	std::optional<int> in_endp_number;
+	std::optional<int> out_endp_number;
+
 	walkConfiguration(descriptor, [&] (int type, size_t length, void *p, const auto &info) {
 		if(type == descriptor_type::endpoint) {
+			if(info.interfaceNumber.value() != intf_num
+					|| info.interfaceAlternative.value() != alternative)
+				return;
 			if(info.endpointIn.value()) {
 				in_endp_number = info.endpointNumber.value();
-			}else if(!info.endpointIn.value()) {
+			}else{
 				out_endp_number = info.endpointNumber.value();
-			}else {
-				throw std::runtime_error("Illegal endpoint!\n");
 			}
 		}else{
 			if(logEnumeration)
@@ -45,139 +129,263 @@ async::detached StorageDevice::run(int config_num, int intf_num) {
 		}
 	});
 
-	if(logSteps)
-		std::cout << "block-usb: Setting up configuration" << std::endl;
-	
-	auto config = co_await _usbDevice.useConfiguration(config_num);
-	auto intf = co_await config.useInterface(intf_num, 0);
+	auto intf = co_await config.useInterface(intf_num, alternative);
 	auto endp_in = co_await intf.getEndpoint(PipeType::in, in_endp_number.value());
 	auto endp_out = co_await intf.getEndpoint(PipeType::out, out_endp_number.value());
 
+	// BOT only allows a single outstanding command: the next CBW must not be sent
+	// before the CSW of the previous command has been received.
+	queueDepth = 1;
+	blockfs::runDevice(this);
+
 	if(logSteps)
-		std::cout << "block-usb: Device is ready" << std::endl;
+		std::cout << "block-usb: Device is ready (BOT)" << std::endl;
 
 	while(true) {
 		if(!_queue.empty()) {
 			auto req = &_queue.front();
-			
+			_queue.pop_front();
+
 			if(logRequests)
 				std::cout << "block-usb: Reading " << req->numSectors << " sectors" << std::endl;
-			assert(req->numSectors);
-			assert(req->numSectors <= 0xFFFF);
-
-			CommandBlockWrapper cbw;
-			memset(&cbw, 0, sizeof(CommandBlockWrapper));
-			cbw.signature = Signatures::kSignCbw;
-			cbw.tag = 1;
-			cbw.transferLength = req->numSectors * 512;
-			if(!req->isWrite) {
-				cbw.flags = 0x80; // Direction: Device-to-Host.
-			}else{
-				cbw.flags = 0; // Direction: Host-to-Device.
-			}
-			cbw.lun = 0;
-
-			if(!req->isWrite) {
-				if(enableRead6 && req->sector <= 0x1FFFFF && req->numSectors <= 0xFF) {
-					scsi::Read6 command;
-					memset(&command, 0, sizeof(scsi::Read6));
-					command.opCode = 0x08;
-					command.lba[0] = req->sector >> 16;
-					command.lba[1] = (req->sector >> 8) & 0xFF;
-					command.lba[2] = req->sector & 0xFF;
-					command.transferLength = req->numSectors;
-
-					cbw.cmdLength = sizeof(scsi::Read6);
-					memcpy(cbw.cmdData, &command, sizeof(scsi::Read6));
-				}else if(req->sector <= 0xFFFFFFFF) {
-					scsi::Read10 command;
-					memset(&command, 0, sizeof(scsi::Read10));
-					command.opCode = 0x28;
-					command.lba[0] = req->sector >> 24;
-					command.lba[1] = (req->sector >> 16) & 0xFF;
-					command.lba[2] = (req->sector >> 8) & 0xFF;
-					command.lba[3] = req->sector & 0xFF;
-					command.transferLength[0] = req->numSectors >> 8;
-					command.transferLength[1] = req->numSectors & 0xFF;
-
-					cbw.cmdLength = sizeof(scsi::Read10);
-					memcpy(cbw.cmdData, &command, sizeof(scsi::Read10));
-				}else{
-					throw std::logic_error("USB storage does not currently support high LBAs!");
-				}
-			}else{
-				if(req->sector <= 0xFFFFFFFF) {
-					scsi::Write10 command;
-					memset(&command, 0, sizeof(scsi::Write10));
-					command.opCode = 0x2A;
-					command.lba[0] = req->sector >> 24;
-					command.lba[1] = (req->sector >> 16) & 0xFF;
-					command.lba[2] = (req->sector >> 8) & 0xFF;
-					command.lba[3] = req->sector & 0xFF;
-					command.transferLength[0] = req->numSectors >> 8;
-					command.transferLength[1] = req->numSectors & 0xFF;
-
-					cbw.cmdLength = sizeof(scsi::Write10);
-					memcpy(cbw.cmdData, &command, sizeof(scsi::Write10));
-				}else{
-					throw std::logic_error("USB storage does not currently support high LBAs!");
-				}
+
+			int attempt = 0;
+			while(!(co_await _executeBot(req, _nextTag++, endp_in, endp_out))) {
+				if(attempt++ == maxBotRetries)
+					throw std::runtime_error("block-usb: Giving up");
+				co_await _resetBot(intf_num, 0x80 | in_endp_number.value(),
+						out_endp_number.value());
 			}
 
-			// TODO: Respect USB device DMA requirements.
+			req->promise.set_value();
+			delete req;
+		}else{
+			co_await _doorbell.async_wait();
+		}
+	}
+}
 
-			// TODO: Ideally, we want to post the IN-transfer first.
-			// We do this to try to avoid unnecessary IRQs
-			// and round-trips to the device and host-controller driver.
-			CommandStatusWrapper csw;
+async::result<bool> StorageDevice::_executeBot(Request *req, uint32_t tag,
+		Endpoint endp_in, Endpoint endp_out) {
+	CommandBlockWrapper cbw;
+	memset(&cbw, 0, sizeof(CommandBlockWrapper));
+	cbw.signature = Signatures::kSignCbw;
+	cbw.tag = tag;
+	cbw.transferLength = req->numSectors * 512;
+	if(!req->isWrite) {
+		cbw.flags = 0x80; // Direction: Device-to-Host.
+	}else{
+		cbw.flags = 0; // Direction: Host-to-Device.
+	}
+	cbw.lun = 0;
+	cbw.cmdLength = _buildCdb(req, cbw.cmdData);
 
-			if(logSteps)
-				std::cout << "block-usb: Sending CBW" << std::endl;
-			co_await endp_out.transfer(BulkTransfer{XferFlags::kXferToDevice,
-					arch::dma_buffer_view{nullptr, &cbw, sizeof(CommandBlockWrapper)}});
-			
-			if(logSteps)
-				std::cout << "block-usb: Waiting for data" << std::endl;
-			if(!req->isWrite) {
-				BulkTransfer data_info{XferFlags::kXferToHost,
-						arch::dma_buffer_view{nullptr, req->buffer, req->numSectors * 512}};
-				// TODO: We want this to be lazy but that only works if can ensure that
-				// the next transaction is also posted to the queue.
-	//			data_info.lazyNotification = true;
-				auto data_xfer = endp_in.transfer(data_info);
-				co_await std::move(data_xfer);
-			}else{
-				co_await endp_out.transfer(BulkTransfer{XferFlags::kXferToDevice,
-						arch::dma_buffer_view{nullptr, req->buffer, req->numSectors * 512}});
-			}
+	// TODO: Respect USB device DMA requirements.
 
-			if(logSteps)
-				std::cout << "block-usb: Waiting for CSW" << std::endl;
-			auto csw_xfer = endp_in.transfer(BulkTransfer{XferFlags::kXferToHost,
-					arch::dma_buffer_view{nullptr, &csw, sizeof(CommandStatusWrapper)}});
-			co_await std::move(csw_xfer);
-
-			if(logSteps)
-				std::cout << "block-usb: Request complete" << std::endl;
-			assert(csw.signature == Signatures::kSignCsw);
-			assert(csw.tag == 1);
-			assert(!csw.dataResidue);
-			if(csw.status) {
-				std::cout << "block-usb: Error status 0x"
-						<< std::hex << (unsigned int)csw.status << std::dec
-						<<  " in CSW" << std::endl;
-				throw std::runtime_error("block-usb: Giving up");
-			}
+	CommandStatusWrapper csw;
+	memset(&csw, 0, sizeof(CommandStatusWrapper));
 
-			req->promise.set_value();
+	if(logSteps)
+		std::cout << "block-usb: Sending CBW" << std::endl;
+	co_await endp_out.transfer(BulkTransfer{XferFlags::kXferToDevice,
+			arch::dma_buffer_view{nullptr, &cbw, sizeof(CommandBlockWrapper)}});
+
+	if(logSteps)
+		std::cout << "block-usb: Waiting for data" << std::endl;
+	BulkTransfer data_info{req->isWrite ? XferFlags::kXferToDevice : XferFlags::kXferToHost,
+			arch::dma_buffer_view{nullptr, req->buffer, req->numSectors * 512}};
+	if(!req->isWrite) {
+		co_await endp_in.transfer(data_info);
+	}else{
+		co_await endp_out.transfer(data_info);
+	}
+
+	if(logSteps)
+		std::cout << "block-usb: Waiting for CSW" << std::endl;
+	BulkTransfer csw_info{XferFlags::kXferToHost,
+			arch::dma_buffer_view{nullptr, &csw, sizeof(CommandStatusWrapper)}};
+	csw_info.allowShortPackets = true;
+	auto csw_length = co_await endp_in.transfer(csw_info);
+
+	if(logSteps)
+		std::cout << "block-usb: Request complete" << std::endl;
+	if(csw_length != sizeof(CommandStatusWrapper)
+			|| csw.signature != Signatures::kSignCsw || csw.tag != tag) {
+		std::cout << "block-usb: Invalid CSW for tag " << tag << std::endl;
+		co_return false;
+	}
+	if(csw.status == 2) {
+		std::cout << "block-usb: Phase error for tag " << tag << std::endl;
+		co_return false;
+	}
+	if(csw.status || csw.dataResidue) {
+		std::cout << "block-usb: Error status 0x"
+				<< std::hex << (unsigned int)csw.status << std::dec
+				<<  " (residue " << csw.dataResidue << ") in CSW" << std::endl;
+		throw std::runtime_error("block-usb: Giving up");
+	}
+
+	co_return true;
+}
+
+// Performs the reset recovery of the BOT specification:
+// a Bulk-Only Mass Storage Reset followed by clearing the halt of both bulk endpoints.
+async::result<void> StorageDevice::_resetBot(int intf_num, int in_endp_address,
+		int out_endp_address) {
+	std::cout << "block-usb: Performing reset recovery" << std::endl;
+
+	arch::dma_object<SetupPacket> reset{_usbDevice.setupPool()};
+	reset->type = setup_type::targetInterface | setup_type::byClass
+			| setup_type::toDevice;
+	reset->request = 0xFF;
+	reset->value = 0;
+	reset->index = intf_num;
+	reset->length = 0;
+	co_await _usbDevice.transfer(ControlTransfer{kXferToDevice,
+			reset, arch::dma_buffer_view{}});
+
+	for(int address : {in_endp_address, out_endp_address}) {
+		arch::dma_object<SetupPacket> clear_halt{_usbDevice.setupPool()};
+		clear_halt->type = setup_type::targetEndpoint | setup_type::byStandard
+				| setup_type::toDevice;
+		clear_halt->request = request_type::clearFeature;
+		clear_halt->value = 0; // ENDPOINT_HALT.
+		clear_halt->index = address;
+		clear_halt->length = 0;
+		co_await _usbDevice.transfer(ControlTransfer{kXferToDevice,
+				clear_halt, arch::dma_buffer_view{}});
+	}
+}
+
+// --------------------------------------------------------
+// USB Attached SCSI
+// --------------------------------------------------------
+
+async::result<bool> StorageDevice::_runUas(Configuration config, int intf_num,
+		int alternative) {
+	auto descriptor = co_await _usbDevice.configurationDescriptor();
+
+	// The pipe usage descriptor follows the endpoint descriptor of each pipe.
+	std::optional<int> pipes[5];
+	walkConfiguration(descriptor, [&] (int type, size_t length, void *p, const auto &info) {
+		if(type != descriptor_type::uasPipeUsage)
+			return;
+		if(info.interfaceNumber.value() != intf_num
+				|| info.interfaceAlternative.value() != alternative
+				|| !info.endpointNumber)
+			return;
+
+		auto desc = (uas::PipeUsageDescriptor *)p;
+		if(desc->pipeId < uas::kPipeCommand || desc->pipeId > uas::kPipeDataOut) {
+			if(logEnumeration)
+				printf("block-usb: Unexpected UAS pipe ID %d\n", desc->pipeId);
+			return;
+		}
+		pipes[desc->pipeId] = info.endpointNumber.value();
+	});
+
+	for(int i = uas::kPipeCommand; i <= uas::kPipeDataOut; i++) {
+		if(!pipes[i]) {
+			std::cout << "block-usb: UAS interface lacks pipe " << i << std::endl;
+			co_return false;
+		}
+	}
+
+	auto intf = co_await config.useInterface(intf_num, alternative);
+	auto command_endp = co_await intf.getEndpoint(PipeType::out, *pipes[uas::kPipeCommand]);
+	auto status_endp = co_await intf.getEndpoint(PipeType::in, *pipes[uas::kPipeStatus]);
+	auto in_endp = co_await intf.getEndpoint(PipeType::in, *pipes[uas::kPipeDataIn]);
+	auto out_endp = co_await intf.getEndpoint(PipeType::out, *pipes[uas::kPipeDataOut]);
+
+	// Each tag is also the stream ID of the status and data pipes.
+	auto num_tags = std::min({status_endp.numStreams(), in_endp.numStreams(),
+			out_endp.numStreams(), maxUasTags});
+	if(!num_tags) {
+		std::cout << "block-usb: Host controller does not support UAS streams" << std::endl;
+		co_return false;
+	}
+
+	queueDepth = num_tags;
+	blockfs::runDevice(this);
+
+	if(logSteps)
+		std::cout << "block-usb: Device is ready (UAS, " << num_tags << " tags)" << std::endl;
+
+	while(true) {
+		if(!_queue.empty() && _inFlight < num_tags) {
+			auto req = &_queue.front();
 			_queue.pop_front();
-			delete req;
+
+			if(logRequests)
+				std::cout << "block-usb: Reading " << req->numSectors << " sectors" << std::endl;
+
+			// Tags start at 1.
+			int tag = __builtin_ffs(~_usedTags);
+			assert(tag && static_cast<size_t>(tag) <= num_tags);
+			_usedTags |= uint32_t(1) << (tag - 1);
+
+			_inFlight++;
+			_executeUas(req, tag, command_endp, status_endp, in_endp, out_endp);
 		}else{
 			co_await _doorbell.async_wait();
 		}
 	}
 }
 
+async::detached StorageDevice::_executeUas(Request *req, int tag, Endpoint command_endp,
+		Endpoint status_endp, Endpoint in_endp, Endpoint out_endp) {
+	uas::CommandIu command;
+	memset(&command, 0, sizeof(uas::CommandIu));
+	command.iuId = uas::kIuCommand;
+	command.tag[0] = tag >> 8;
+	command.tag[1] = tag & 0xFF;
+	_buildCdb(req, command.cdb);
+
+	// TODO: Respect USB device DMA requirements.
+
+	// Post the status and data stages before the command so that the device
+	// can complete the command without waiting for the host.
+	uas::SenseIu sense;
+	BulkTransfer status_info{XferFlags::kXferToHost,
+			arch::dma_buffer_view{nullptr, &sense, sizeof(uas::SenseIu)}};
+	status_info.allowShortPackets = true;
+	status_info.streamId = tag;
+
+	BulkTransfer data_info{req->isWrite ? XferFlags::kXferToDevice : XferFlags::kXferToHost,
+			arch::dma_buffer_view{nullptr, req->buffer, req->numSectors * 512}};
+	data_info.streamId = tag;
+
+	if(logSteps)
+		std::cout << "block-usb: Posting command IU with tag " << tag << std::endl;
+	auto status_xfer = status_endp.transfer(status_info);
+	auto data_xfer = req->isWrite ? out_endp.transfer(data_info) : in_endp.transfer(data_info);
+	auto command_xfer = command_endp.transfer(BulkTransfer{XferFlags::kXferToDevice,
+			arch::dma_buffer_view{nullptr, &command, sizeof(uas::CommandIu)}});
+	co_await async::when_all(std::move(status_xfer), std::move(data_xfer),
+			std::move(command_xfer));
+
+	if(logSteps)
+		std::cout << "block-usb: Request complete" << std::endl;
+	if(sense.iuId != uas::kIuSense || ((sense.tag[0] << 8) | sense.tag[1]) != tag) {
+		std::cout << "block-usb: Unexpected IU 0x" << std::hex << (unsigned int)sense.iuId
+				<< std::dec << " for tag " << tag << std::endl;
+		throw std::runtime_error("block-usb: Giving up");
+	}
+	if(sense.status) {
+		std::cout << "block-usb: Error status 0x"
+				<< std::hex << (unsigned int)sense.status << std::dec
+				<<  " in sense IU" << std::endl;
+		throw std::runtime_error("block-usb: Giving up");
+	}
+
+	req->promise.set_value();
+	delete req;
+
+	_usedTags &= ~(uint32_t(1) << (tag - 1));
+	_inFlight--;
+	_doorbell.ring();
+}
+
 async::result<void> StorageDevice::readSectors(uint64_t sector,
 		void *buffer, size_t numSectors) {
 	auto req = new Request{false, sector, buffer, numSectors};
@@ -200,11 +408,12 @@ async::detached bindDevice(mbus::Entity entity) {
 	auto lane = helix::UniqueLane(co_await entity.bind());
 	auto device = protocols::usb::connect(std::move(lane));
 	
-	std::experimental::optional<int> config_number;
-	std::experimental::optional<int> intf_number;
-	std::experimental::optional<int> intf_class;
-	std::experimental::optional<int> intf_subclass;
-	std::experimental::optional<int> intf_protocol;
+	std::optional<int> config_number;
+	std::optional<int> intf_number;
+	std::optional<int> bot_alternative;
+	std::optional<int> uas_alternative;
+	// Number of bulk endpoints of the UAS interface that support streams.
+	int uas_stream_endpoints = 0;
 	
 	if(logEnumeration)
 		std::cout << "block-usb: Getting configuration descriptor" << std::endl;
@@ -215,7 +424,7 @@ async::detached bindDevice(mbus::Entity entity) {
 			assert(!config_number);
 			config_number = info.configNumber.value();
 		}else if(type == descriptor_type::interface) {
-			if(intf_number) {
+			if(intf_number && intf_number.value() != info.interfaceNumber.value()) {
 				std::cout << "block-usb: Ignoring interface "
 						<< info.interfaceNumber.value() << std::endl;
 				return;
@@ -225,32 +434,45 @@ async::detached bindDevice(mbus::Entity entity) {
 						<< ", alternative: " << info.interfaceAlternative.value() << std::endl;
 			intf_number = info.interfaceNumber.value();
 			
-			assert(!intf_class);
-			assert(!intf_subclass);
-			assert(!intf_protocol);
 			auto desc = (InterfaceDescriptor *)p;
-			intf_class = desc->interfaceClass;
-			intf_subclass = desc->interfaceSubClass;
-			intf_protocol = desc->interfaceProtocoll;
+			if(logEnumeration)
+				std::cout << "block-usb: Interface class: 0x" << std::hex
+						<< (int)desc->interfaceClass
+						<< ", subclass: 0x" << (int)desc->interfaceSubClass
+						<< ", protocol: 0x" << (int)desc->interfaceProtocoll
+						<< std::dec << std::endl;
+			if(desc->interfaceClass != 0x08 || desc->interfaceSubClass != 0x06)
+				return;
+			if(desc->interfaceProtocoll == 0x50 && !bot_alternative)
+				bot_alternative = info.interfaceAlternative.value();
+			if(desc->interfaceProtocoll == 0x62 && !uas_alternative)
+				uas_alternative = info.interfaceAlternative.value();
+		}else if(type == descriptor_type::endpointCompanion) {
+			if(!uas_alternative || info.interfaceNumber.value() != intf_number.value()
+					|| info.interfaceAlternative.value() != uas_alternative.value())
+				return;
+			auto desc = (EndpointCompanionDescriptor *)p;
+			if(info.endpointType.value() == EndpointType::bulk && (desc->attributes & 0x1F))
+				uas_stream_endpoints++;
 		}
 	});
 
-	if(logEnumeration)
-		std::cout << "block-usb: Device class: 0x" << std::hex << intf_class.value()
-				<< ", subclass: 0x" << intf_subclass.value()
-				<< ", protocol: 0x" << intf_protocol.value()
-				<< std::dec << std::endl;
-	if(intf_class.value() != 0x08
-			|| intf_subclass.value() != 0x06
-			|| intf_protocol.value() != 0x50)
+	// The status, data-in and data-out pipes all need streams.
+	// TODO: Support UAS on USB 2.0 devices (which use READ READY and WRITE READY IUs
+	// instead of streams).
+	if(uas_alternative && uas_stream_endpoints < 3)
+		uas_alternative = std::nullopt;
+
+	if(!bot_alternative && !uas_alternative)
 		co_return;
 
 	if(logEnumeration)
-		std::cout << "block-usb: Detected USB device" << std::endl;
+		std::cout << "block-usb: Detected USB device ("
+				<< (uas_alternative ? "UAS" : "BOT") << ")" << std::endl;
 
 	auto storage_device = new StorageDevice(device);
-	storage_device->run(config_number.value(), intf_number.value());
-	blockfs::runDevice(storage_device);
+	storage_device->run(config_number.value(), intf_number.value(),
+			bot_alternative, uas_alternative);
 }
 
 async::detached observeDevices() {
@@ -1,4 +1,6 @@
 
+#include <optional>
+
 #include <async/doorbell.hpp>
 #include <async/result.hpp>
 #include <blockfs.hpp>
@@ -94,11 +96,66 @@ struct Read32 {
 
 } // namespace scsi
 
+// USB Attached SCSI (UAS) information units.
+namespace uas {
+
+enum IuId {
+	kIuCommand = 0x01,
+	kIuSense = 0x03,
+	kIuResponse = 0x04
+};
+
+// Values of the pipe ID in the pipe usage descriptor.
+enum PipeId {
+	kPipeCommand = 1,
+	kPipeStatus = 2,
+	kPipeDataIn = 3,
+	kPipeDataOut = 4
+};
+
+struct [[ gnu::packed ]] PipeUsageDescriptor {
+	uint8_t length;
+	uint8_t descriptorType;
+	uint8_t pipeId;
+	uint8_t reserved;
+};
+static_assert(sizeof(PipeUsageDescriptor) == 4);
+
+struct CommandIu {
+	uint8_t iuId;
+	uint8_t reserved;
+	uint8_t tag[2];
+	uint8_t attributes;
+	uint8_t reserved2;
+	uint8_t additionalCdbLength;
+	uint8_t reserved3;
+	uint8_t lun[8];
+	uint8_t cdb[16];
+};
+static_assert(sizeof(CommandIu) == 32);
+
+// Large enough to hold fixed format sense data.
+struct SenseIu {
+	uint8_t iuId;
+	uint8_t reserved;
+	uint8_t tag[2];
+	uint8_t statusQualifier[2];
+	uint8_t status;
+	uint8_t reserved2[7];
+	uint8_t senseLength[2];
+	uint8_t senseData[48];
+};
+static_assert(sizeof(SenseIu) == 64);
+
+} // namespace uas
+
 struct StorageDevice : blockfs::BlockDevice {
 	StorageDevice(Device usb_device) 
 	: blockfs::BlockDevice(512), _usbDevice(std::move(usb_device)) { }
 
-	async::detached run(int config_num, int intf_num);
+	// Uses UAS if uas_alternative is set and usable, and Bulk-Only Transport otherwise.
+	async::detached run(int config_num, int intf_num,
+			std::optional<int> bot_alternative, std::optional<int> uas_alternative);
 
 	async::result<void> readSectors(uint64_t sector,
 			void *buffer, size_t numSectors) override;
@@ -119,9 +176,29 @@ private:
 		boost::intrusive::list_member_hook<> requestHook;
 	};
 
+	// Writes the READ or WRITE command for req to cdb. Returns its length.
+	static size_t _buildCdb(Request *req, uint8_t *cdb);
+
+	async::result<void> _runBot(Configuration config, int intf_num, int alternative);
+	// Returns false (before the device is exposed) if UAS cannot be used.
+	async::result<bool> _runUas(Configuration config, int intf_num, int alternative);
+
+	// Returns false if the device needs reset recovery before the command is retried.
+	async::result<bool> _executeBot(Request *req, uint32_t tag, Endpoint endp_in,
+			Endpoint endp_out);
+	async::result<void> _resetBot(int intf_num, int in_endp_address, int out_endp_address);
+	async::detached _executeUas(Request *req, int tag, Endpoint command_endp,
+			Endpoint status_endp, Endpoint in_endp, Endpoint out_endp);
+
 	Device _usbDevice;
 	async::doorbell _doorbell;
 
+	// Number of UAS commands that are currently submitted to the device.
+	size_t _inFlight = 0;
+	uint32_t _nextTag = 1;
+	// Bitmask of the UAS tags that are in use.
+	uint32_t _usedTags = 0;
+
 	boost::intrusive::list<
 		Request,
 		boost::intrusive::member_hook<
@@ -2,6 +2,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <algorithm>
 #include <deque>
 #include <optional>
 #include <functional>
@@ -10,6 +11,7 @@
 
 #include <arch/dma_pool.hpp>
 #include <async/result.hpp>
+#include <fafnir/dsl.hpp>
 #include <helix/ipc.hpp>
 #include <protocols/hw/client.hpp>
 #include <protocols/kernlet/compiler.hpp>
@@ -23,6 +25,14 @@
 #include "spec.hpp"
 #include "xhci.hpp"
 
+// Upper bound on the size of the primary stream array of an endpoint.
+// Stream 0 is reserved, hence one entry less is usable.
+constexpr size_t maxStreamArraySize = 32;
+
+// Interrupt moderation interval of the bulk interrupter (in units of 250ns).
+// This bounds the IRQ rate under load while keeping the added latency small.
+constexpr uint32_t bulkInterruptModeration = 160;
+
 constexpr const char *completionCodeNames[256] = {
 	"Invalid",
 	"Success",
@@ -75,7 +85,7 @@ Controller::Controller(protocols::hw::Device hw_device, helix::Mapping mapping,
 		_mmio{std::move(mmio)}, _irq{std::move(irq)},
 		_space{_mapping.get()}, _memoryPool{},
 		_dcbaa{&_memoryPool, 256}, _cmdRing{this},
-		_eventRing{this} { 
+		_eventRing{this, 0} { 
 	auto op_offset = _space.load(cap_regs::caplength);
 	auto runtime_offset = _space.load(cap_regs::rtsoff);
 	auto doorbell_offset = _space.load(cap_regs::dboff);
@@ -85,6 +95,10 @@ Controller::Controller(protocols::hw::Device hw_device, helix::Mapping mapping,
 
 	_numPorts = _space.load(cap_regs::hcsparams1) & hcsparams1::maxPorts;
 	printf("xhci: %u ports\n", _numPorts);
+
+	auto max_psa_size = _space.load(cap_regs::hccparams1) & hccparams1::maxPsaSize;
+	_maxPrimaryStreams = max_psa_size ? (size_t(1) << (max_psa_size + 1)) : 0;
+	printf("xhci: max primary stream array size: %lu\n", _maxPrimaryStreams);
 }
 
 std::vector<std::pair<uint8_t, uint16_t>> Controller::getExtendedCapabilityOffsets() {
@@ -307,7 +321,14 @@ async::detached Controller::initialize() {
 	_interrupters[0]->setEventRing(&_eventRing);
 	_interrupters[0]->setEnable(true);
 
-	co_await _hw_device.enableBusIrq();
+	if (max_intrs > 1) {
+		_bulkInterrupter = 1;
+		_bulkEventRing = std::make_unique<EventRing>(this, _bulkInterrupter);
+		_interrupters[_bulkInterrupter]->setEventRing(_bulkEventRing.get());
+		_interrupters[_bulkInterrupter]->setModeration(bulkInterruptModeration);
+		_interrupters[_bulkInterrupter]->setEnable(true);
+	}
+
 	handleIrqs();
 
 	_ports.resize(_numPorts);
@@ -327,32 +348,133 @@ async::detached Controller::initialize() {
 }
 
 async::detached Controller::handleIrqs() {
-	uint64_t sequence = 0;
+	co_await connectKernletCompiler();
+
+	// The kernlet checks (and clears) the pending bits of our interrupters.
+	// IRQs of other devices on the same line do not wake up this process.
+	std::vector<uint8_t> kernlet_program;
+	fnr::emit_to(std::back_inserter(kernlet_program),
+		// Load the IP bit of the primary interrupter.
+		fnr::scope_push{} (
+			fnr::intrin{"__mmio_read32", 2, 1} (
+				fnr::binding{0}, // xHCI MMIO region (bound to slot 0).
+				fnr::binding{2} // Offset of IMAN of the primary interrupter (bound to slot 2).
+			) & fnr::literal{1} // IP bit.
+		),
+		// Load the IP bit of the bulk interrupter.
+		fnr::scope_push{} (
+			fnr::intrin{"__mmio_read32", 2, 1} (
+				fnr::binding{0}, // xHCI MMIO region (bound to slot 0).
+				fnr::binding{3} // Offset of IMAN of the bulk interrupter (bound to slot 3).
+			) & fnr::literal{1} // IP bit.
+		),
+		// Bit 0 is the primary interrupter, bit 1 is the bulk interrupter.
+		fnr::scope_push{} (
+			fnr::scope_get{0} + fnr::scope_get{1} + fnr::scope_get{1}
+		),
+		// Ack the IRQ iff one of the bits was set.
+		fnr::check_if{},
+			fnr::scope_get{2},
+		fnr::then{},
+			// Clear the EINT bit of USBSTS.
+			fnr::intrin{"__mmio_write32", 3, 0} (
+				fnr::binding{0}, // xHCI MMIO region (bound to slot 0).
+				fnr::binding{1}, // Offset of USBSTS (bound to slot 1).
+				fnr::literal{8} // EINT bit.
+			),
+			// Write back the IP bits (and keep IE set) to deassert the IRQ.
+			fnr::intrin{"__mmio_write32", 3, 0} (
+				fnr::binding{0},
+				fnr::binding{2},
+				fnr::scope_get{0} + fnr::literal{2} // IE bit.
+			),
+			fnr::intrin{"__mmio_write32", 3, 0} (
+				fnr::binding{0},
+				fnr::binding{3},
+				fnr::scope_get{1} + fnr::literal{2} // IE bit.
+			),
+			// Trigger the bitset event (bound to slot 4).
+			fnr::intrin{"__trigger_bitset", 2, 0} (
+				fnr::binding{4},
+				fnr::scope_get{2}
+			),
+			fnr::scope_push{} ( fnr::literal{1} ),
+		fnr::else_then{},
+			fnr::scope_push{} ( fnr::literal{2} ),
+		fnr::end{}
+	);
+
+	auto kernlet_object = co_await compile(kernlet_program.data(),
+			kernlet_program.size(), {BindType::memoryView, BindType::offset,
+			BindType::offset, BindType::offset, BindType::bitsetEvent});
+
+	HelHandle event_handle;
+	HEL_CHECK(helCreateBitsetEvent(&event_handle));
+	helix::UniqueDescriptor event{event_handle};
+
+	auto op_offset = _mapping.offset() + _space.load(cap_regs::caplength);
+	auto intr_offset = [&] (int id) {
+		return _mapping.offset() + _space.load(cap_regs::rtsoff)
+				+ 0x20 + id * 32 + interrupter::iman.offset();
+	};
+
+	HelKernletData data[5];
+	data[0].handle = _mmio.getHandle();
+	data[1].handle = op_offset + op_regs::usbsts.offset();
+	data[2].handle = intr_offset(0);
+	// Without a bulk interrupter, both slots refer to the primary interrupter.
+	data[3].handle = intr_offset(_bulkInterrupter);
+	data[4].handle = event.getHandle();
+	HelHandle bound_handle;
+	HEL_CHECK(helBindKernlet(kernlet_object.getHandle(), data, 5, &bound_handle));
+	HEL_CHECK(helAutomateIrq(_irq.getHandle(), 0, bound_handle));
+
+	co_await _hw_device.enableBusIrq();
+
+	// TODO: We should not need this kick anymore.
+	HEL_CHECK(helAcknowledgeIrq(_irq.getHandle(), kHelAckKick, 0));
 
+	uint64_t sequence = 0;
 	while(1) {
-		auto await = co_await helix_ng::awaitEvent(_irq, sequence);
+		auto await = co_await helix_ng::awaitEvent(event, sequence);
 		HEL_CHECK(await.error());
 		sequence = await.sequence();
 
-		if (!_interrupters[0]->isPending()) {
-			HEL_CHECK(helAcknowledgeIrq(_irq.getHandle(), kHelAckNack, sequence));
-			continue;
-		}
-
-		_interrupters[0]->clearPending();
-		HEL_CHECK(helAcknowledgeIrq(_irq.getHandle(), kHelAckAcknowledge, sequence));
+		auto bits = await.bitset();
 
-		_eventRing.processRing();
+		_deferDoorbells = true;
+		if (bits & 1)
+			_eventRing.processRing();
+		if (_bulkEventRing && (bits & 2))
+			_bulkEventRing->processRing();
+		_deferDoorbells = false;
+		flushDoorbells();
 	}
 
 	printf("xhci: interrupt coroutine should not exit...\n");
 }
 
 void Controller::ringDoorbell(uint8_t doorbell, uint8_t target, uint16_t stream_id) {
+	if (_deferDoorbells) {
+		auto it = std::find_if(_pendingDoorbells.begin(), _pendingDoorbells.end(),
+				[&] (const PendingDoorbell &p) {
+			return p.doorbell == doorbell && p.target == target && p.streamId == stream_id;
+		});
+		if (it == _pendingDoorbells.end())
+			_pendingDoorbells.push_back({doorbell, target, stream_id});
+		return;
+	}
+
 	arch::scalar_store<uint32_t>(_doorbells, doorbell * 4,
 			target | (stream_id << 16));
 }
 
+void Controller::flushDoorbells() {
+	for (auto &p : _pendingDoorbells)
+		ringDoorbell(p.doorbell, p.target, p.streamId);
+	_pendingDoorbells.clear();
+}
+
 // ------------------------------------------------------------------------
 // Controller::CommandRing
 // ------------------------------------------------------------------------
@@ -408,9 +530,9 @@ void Controller::CommandRing::submit() {
 // Controller::EventRing
 // ------------------------------------------------------------------------
 
-Controller::EventRing::EventRing(Controller *controller)
+Controller::EventRing::EventRing(Controller *controller, int interrupter)
 :_eventRing{&controller->_memoryPool}, _erst{&controller->_memoryPool, 1},
-	_dequeuePtr{0}, _controller{controller}, _ccs{1} {
+	_dequeuePtr{0}, _controller{controller}, _interrupter{interrupter}, _ccs{1} {
 
 	for (size_t i = 0; i < eventRingSize; i++) {
 		_eventRing->ent[i] = {{0, 0, 0, 0}};
@@ -454,12 +576,10 @@ void Controller::EventRing::processRing() {
 			break; // not the proper cycle state
 
 		Controller::Event ev = Controller::Event::fromRawTrb(raw_ev);
-
-		_dequeuedEvents.push_back(ev);
 		processEvent(ev);
 	}
 
-	_controller->_interrupters[0]->setEventRing(this, true);
+	_controller->_interrupters[_interrupter]->setEventRing(this, true);
 	_doorbell.ring();
 }
 
@@ -479,7 +599,13 @@ void Controller::EventRing::processEvent(Controller::Event ev) {
 		if (_controller->_ports[ev.portId - 1])
 			_controller->_ports[ev.portId - 1]->_doorbell.ring();
 	} else if (ev.type == TrbType::transferEvent) {
-		auto transferRing = _controller->_devices[ev.slotId]->_transferRings[ev.endpointId - 1].get();
+		auto transferRing = _controller->_devices[ev.slotId]->findTransferRing(ev.endpointId,
+				ev.trbPointer);
+		if (!transferRing) {
+			printf("xhci: transfer event for unknown ring\n");
+			ev.printInfo();
+			return;
+		}
 		size_t commandIndex = (ev.trbPointer - transferRing->getPtr()) / sizeof(RawTrb);
 		assert(commandIndex < Controller::TransferRing::transferRingSize);
 		auto transferEv = transferRing->_transferEvents[commandIndex];
@@ -526,6 +652,10 @@ void Controller::Interrupter::setEventRing(EventRing *ring, bool clearEhb) {
 	_space.store(interrupter::erdpHi, ring->getEventRingPtr() >> 32);
 }
 
+void Controller::Interrupter::setModeration(uint16_t interval) {
+	_space.store(interrupter::imod, interval);
+}
+
 bool Controller::Interrupter::isPending() {
 	return _space.load(interrupter::iman) & iman::pending;
 }
@@ -833,6 +963,7 @@ async::detached Controller::Port::initPort() {
 Controller::TransferRing::TransferRing(Controller *controller)
 :_transferRing{&controller->_memoryPool}, _dequeuePtr{0}, _enqueuePtr{0},
 	_controller{controller}, _pcs{true} {
+	HEL_CHECK(helPointerPhysical(_transferRing.data(), &_ptr));
 
 	for (uint32_t i = 0; i < transferRingSize; i++) {
 		_transferRing->ent[i] = {{0, 0, 0, 0}};
@@ -847,9 +978,11 @@ Controller::TransferRing::TransferRing(Controller *controller)
 }
 
 uintptr_t Controller::TransferRing::getPtr() {
-	uintptr_t ptr;
-	HEL_CHECK(helPointerPhysical(_transferRing.data(), &ptr));
-	return ptr;
+	return _ptr;
+}
+
+bool Controller::TransferRing::containsTrb(uintptr_t ptr) {
+	return ptr >= _ptr && ptr < _ptr + transferRingSize * sizeof(RawTrb);
 }
 
 void Controller::TransferRing::pushRawTransfer(RawTrb cmd, 
@@ -909,41 +1042,71 @@ async::result<std::string> Controller::Device::configurationDescriptor() {
 	co_return std::string{(char *)descriptor.data(), descriptor.size()};
 }
 
-async::result<Configuration> Controller::Device::useConfiguration(int number) {
-	auto descriptor = co_await configurationDescriptor();
-
-	struct EndpointInfo {
-		int pipe;
-		PipeType dir;
-		int packet_size;
-		EndpointType type;
-	};
+struct EndpointInfo {
+	int pipe;
+	PipeType dir;
+	int packetSize;
+	EndpointType type;
+	int maxBurst;
+	int maxStreams;
+};
 
-	std::vector<EndpointInfo> _eps = {};
+// Collects the endpoints of an alternate setting. If interface is negative,
+// the endpoints of all interfaces are returned.
+static std::vector<EndpointInfo> collectEndpoints(std::string descriptor,
+		int interface, int alternative) {
+	std::vector<EndpointInfo> eps;
+	bool inEndpoint = false;
 
 	walkConfiguration(descriptor, [&] (int type, size_t length, void *p, const auto &info) {
 		(void)length;
 
-		if(type != descriptor_type::endpoint)
+		if (type == descriptor_type::interface) {
+			inEndpoint = false;
+			return;
+		}
+
+		if (!info.interfaceNumber
+				|| (interface >= 0 && info.interfaceNumber.value() != interface)
+				|| info.interfaceAlternative.value() != alternative)
+			return;
+
+		if (type == descriptor_type::endpointCompanion) {
+			// The companion descriptor follows the descriptor of its endpoint.
+			if (!inEndpoint)
+				return;
+			auto desc = (EndpointCompanionDescriptor *)p;
+			eps.back().maxBurst = desc->maxBurst;
+			if (eps.back().type == EndpointType::bulk)
+				eps.back().maxStreams = desc->attributes & 0x1F;
+			return;
+		}
+
+		if (type != descriptor_type::endpoint)
 			return;
 		auto desc = (EndpointDescriptor *)p;
 
-		// TODO: Pay attention to interface/alternative.
 		auto packet_size = desc->maxPacketSize & 0x7FF;
 		auto ep_type = info.endpointType.value();
 
 		int pipe = info.endpointNumber.value();
-		if (info.endpointIn.value()) {
-			_eps.push_back({pipe, PipeType::in, packet_size, ep_type});
-		} else {
-			_eps.push_back({pipe, PipeType::out, packet_size, ep_type});
-		}
+		eps.push_back({pipe, info.endpointIn.value() ? PipeType::in : PipeType::out,
+				packet_size, ep_type, 0, 0});
+		inEndpoint = true;
 	});
 
-	for (auto &ep : _eps) {
+	return eps;
+}
+
+async::result<Configuration> Controller::Device::useConfiguration(int number) {
+	auto descriptor = co_await configurationDescriptor();
+
+	// Endpoints of other alternate settings are set up by useInterface().
+	for (auto &ep : collectEndpoints(descriptor, -1, 0)) {
 		printf("xhci: setting up %s endpoint %d (max packet size: %d)\n", 
-			ep.dir == PipeType::in ? "in" : "out", ep.pipe, ep.packet_size);
-		co_await setupEndpoint(ep.pipe, ep.dir, ep.packet_size, ep.type);
+			ep.dir == PipeType::in ? "in" : "out", ep.pipe, ep.packetSize);
+		co_await setupEndpoint(ep.pipe, ep.dir, ep.packetSize, ep.type,
+				ep.maxBurst, ep.maxStreams);
 	}
 
 	RawTrb setup_stage = {{
@@ -1021,9 +1184,68 @@ async::result<void> Controller::Device::transfer(ControlTransfer info) {
 			completionCodeNames[ev.event.completionCode]);
 }
 
-void Controller::Device::submit(int endpoint) {
+async::result<void> Controller::Device::useInterface(int number, int alternative) {
+	auto descriptor = co_await configurationDescriptor();
+
+	for (auto &ep : collectEndpoints(descriptor, number, alternative)) {
+		printf("xhci: setting up %s endpoint %d of alternate setting %d\n", 
+			ep.dir == PipeType::in ? "in" : "out", ep.pipe, alternative);
+		co_await setupEndpoint(ep.pipe, ep.dir, ep.packetSize, ep.type,
+				ep.maxBurst, ep.maxStreams);
+	}
+
+	RawTrb setup_stage = {{
+			static_cast<uint32_t>((alternative << 16) | (11 << 8) | 0x01), // SET_INTERFACE, host to device
+			static_cast<uint32_t>(number), 8,
+			(1 << 6) | (static_cast<uint32_t>(TrbType::setupStage) << 10)}};
+
+	RawTrb status_stage = {{
+			0, 0, 0, 
+			(1 << 16) | (1 << 5) | (static_cast<uint32_t>(TrbType::statusStage) << 10)}};
+
+	TransferRing::TransferEvent ev;
+
+	pushRawTransfer(0, setup_stage);
+	pushRawTransfer(0, status_stage, &ev);
+	submit(1);
+
+	co_await ev.promise.async_get();
+
+	if (ev.event.completionCode != 1)
+		printf("xhci: failed to set alternate setting, completion code: '%s'\n",
+			completionCodeNames[ev.event.completionCode]);
+}
+
+void Controller::Device::submit(int endpoint, uint16_t stream) {
 	assert(_slotId != -1);
-	_controller->ringDoorbell(_slotId, endpoint, /* stream */ 0);
+	_controller->ringDoorbell(_slotId, endpoint, stream);
+}
+
+Controller::TransferRing *Controller::Device::transferRing(int endpointId, uint32_t stream) {
+	if (!stream)
+		return _transferRings[endpointId - 1].get();
+
+	auto &rings = _streamRings[endpointId - 1];
+	assert(stream < rings.size() && rings[stream]);
+	return rings[stream].get();
+}
+
+Controller::TransferRing *Controller::Device::findTransferRing(int endpointId,
+		uintptr_t trbPointer) {
+	auto &rings = _streamRings[endpointId - 1];
+	if (rings.empty())
+		return _transferRings[endpointId - 1].get();
+
+	for (auto &ring : rings) {
+		if (ring && ring->containsTrb(trbPointer))
+			return ring.get();
+	}
+	return nullptr;
+}
+
+size_t Controller::Device::numStreams(int endpointId) {
+	auto &rings = _streamRings[endpointId - 1];
+	return rings.empty() ? 0 : rings.size() - 1;
 }
 
 async::result<void> Controller::Device::allocSlot(int slotType, int packetSize) {
@@ -1149,7 +1371,8 @@ static inline uint32_t getHcdEndpointType(PipeType dir, EndpointType type) {
 	return 0;
 }
 
-async::result<void> Controller::Device::setupEndpoint(int endpoint, PipeType dir, size_t maxPacketSize, EndpointType type, bool drop) {
+async::result<void> Controller::Device::setupEndpoint(int endpoint, PipeType dir,
+		size_t maxPacketSize, EndpointType type, int maxBurst, int maxStreams) {
 	printf("xhci: doing endpoint stuff to %d\n", endpoint);
 	auto inputCtx = arch::dma_object<InputContext>{&_controller->_memoryPool};
 	memset(inputCtx.data(), 0, sizeof(InputContext));
@@ -1159,25 +1382,67 @@ async::result<void> Controller::Device::setupEndpoint(int endpoint, PipeType dir
 	printf("xhci: epId is %d\n", endpointId);
 
 	inputCtx->icc.addContextFlags = (1 << 0) | (1 << (endpointId));
+	// Endpoints that are already configured (e.g. by another alternate setting) are replaced.
+	if (_transferRings[endpointId - 1] || !_streamRings[endpointId - 1].empty())
+		inputCtx->icc.dropContextFlags = 1 << endpointId;
 	inputCtx->slotContext = _devCtx->slotContext;
 
 	inputCtx->slotContext.val[0] |= (31 << 27);
 
-	_transferRings[endpointId - 1] = std::make_unique<TransferRing>(_controller);
-
-	// max burst size = 0
-	// tr dequeue = tr ring ptr
-	// dcs = 1
+	// The controller may access the old rings and stream contexts until
+	// the Configure Endpoint command completes; keep them alive until then.
+	auto oldTransferRing = std::move(_transferRings[endpointId - 1]);
+	auto oldStreamRings = std::move(_streamRings[endpointId - 1]);
+	auto oldStreamContexts = std::move(_streamContexts[endpointId - 1]);
+	_streamRings[endpointId - 1].clear();
+	_streamContexts[endpointId - 1] = arch::dma_array<StreamContext>{};
+
+	// The primary stream array needs at least 4 entries (stream 0 is reserved).
+	size_t streamArraySize = 0;
+	if (maxStreams)
+		streamArraySize = std::min({size_t(1) << maxStreams, _controller->_maxPrimaryStreams,
+				maxStreamArraySize});
+	if (streamArraySize < 4)
+		streamArraySize = 0;
+
+	// tr dequeue = tr ring ptr (or stream array ptr)
+	// dcs = 1 (ignored for streams)
 	// interval = 0
-	// max p streams = 0
 	// mult = 0
 	// error count = 3
 	// average trb length = packet size * 2
-	auto tr_ptr = _transferRings[endpointId - 1]->getPtr();
+	uintptr_t tr_ptr;
+	if (streamArraySize) {
+		auto &rings = _streamRings[endpointId - 1];
+		auto &contexts = _streamContexts[endpointId - 1];
+		rings.resize(streamArraySize);
+		contexts = arch::dma_array<StreamContext>{&_controller->_memoryPool, streamArraySize};
+		memset(contexts.data(), 0, streamArraySize * sizeof(StreamContext));
+
+		for (size_t i = 1; i < streamArraySize; i++) {
+			rings[i] = std::make_unique<TransferRing>(_controller);
+			auto ring_ptr = rings[i]->getPtr();
+			// sct = 1 (primary transfer ring), dcs = 1
+			contexts[i].val[0] = (ring_ptr & 0xFFFFFFF0) | (1 << 1) | (1 << 0);
+			contexts[i].val[1] = ring_ptr >> 32;
+		}
+
+		HEL_CHECK(helPointerPhysical(contexts.data(), &tr_ptr));
+		printf("xhci: using %lu streams\n", streamArraySize - 1);
+
+		// max p streams = log2(array size) - 1, lsa = 1
+		inputCtx->endpointContext[endpointId - 1].val[0] =
+			((__builtin_ctzl(streamArraySize) - 1) << 10) | (1 << 15);
+		inputCtx->endpointContext[endpointId - 1].val[2] = (tr_ptr & 0xFFFFFFF0);
+	} else {
+		_transferRings[endpointId - 1] = std::make_unique<TransferRing>(_controller);
+		tr_ptr = _transferRings[endpointId - 1]->getPtr();
+		inputCtx->endpointContext[endpointId - 1].val[2] = (1 << 0) | (tr_ptr & 0xFFFFFFF0);
+	}
 	printf("xhci: tr ptr = %016lx\n", tr_ptr);
 	assert(!(tr_ptr & 0xF));
-	inputCtx->endpointContext[endpointId - 1].val[1] = (3 << 1) | (getHcdEndpointType(dir, type) << 3) | (maxPacketSize << 16);
-	inputCtx->endpointContext[endpointId - 1].val[2] = (1 << 0) | (tr_ptr & 0xFFFFFFF0);
+	inputCtx->endpointContext[endpointId - 1].val[1] = (3 << 1) | (getHcdEndpointType(dir, type) << 3)
+		| (maxBurst << 8) | (maxPacketSize << 16);
 	inputCtx->endpointContext[endpointId - 1].val[3] = (tr_ptr >> 32);
 	inputCtx->endpointContext[endpointId - 1].val[4] = maxPacketSize * 2;
 
@@ -1214,7 +1479,13 @@ Controller::ConfigurationState::ConfigurationState(Controller *controller,
 }
 
 async::result<Interface> Controller::ConfigurationState::useInterface(int number, int alternative) {
-	assert(!alternative);
+	// useConfiguration() already set up alternate setting 0.
+	auto it = _alternatives.find(number);
+	int current = (it != _alternatives.end()) ? it->second : 0;
+	if (alternative != current) {
+		co_await _device->useInterface(number, alternative);
+		_alternatives[number] = alternative;
+	}
 	co_return Interface{std::make_shared<Controller::InterfaceState>(_controller, _device, number)};
 }
 
@@ -1282,6 +1553,8 @@ async::result<size_t> Controller::EndpointState::transfer(InterruptTransfer info
 
 async::result<size_t> Controller::EndpointState::transfer(BulkTransfer info) {
 	int endpointId = _endpoint * 2 + (_type == PipeType::in ? 1 : 0);
+	assert(info.streamId <= _device->numStreams(endpointId));
+	auto ring = _device->transferRing(endpointId, info.streamId);
 
 	Controller::TransferRing::TransferEvent ev;
 
@@ -1297,28 +1570,36 @@ async::result<size_t> Controller::EndpointState::transfer(BulkTransfer info) {
 		RawTrb transfer = {{
 			static_cast<uint32_t>(pptr & 0xFFFFFFFF),
 			static_cast<uint32_t>(pptr >> 32),
-			static_cast<uint32_t>(chunk),
+			static_cast<uint32_t>(chunk) | (_controller->_bulkInterrupter << 22),
 			(!is_last << 4) | (1 << 2) | (is_last << 5)
 				| (static_cast<uint32_t>(TrbType::normal) << 10)}};
 
-		_device->pushRawTransfer(endpointId - 1, transfer, is_last ? &ev : nullptr);
+		ring->pushRawTransfer(transfer, is_last ? &ev : nullptr);
 
 		progress += chunk;
 	}
 
-	_device->submit(endpointId);
+	_device->submit(endpointId, info.streamId);
 
 	co_await ev.promise.async_get();
 
-	if (ev.event.completionCode != 1) {
+	// Short packets are expected for transfers of unknown length.
+	bool success = ev.event.completionCode == 1
+		|| (info.allowShortPackets && ev.event.completionCode == 13);
+	if (!success) {
 		printf("xhci: completion code is %s instead of success\n", completionCodeNames[ev.event.completionCode]);
 	}
 
-	assert(ev.event.completionCode == 1); // success
+	assert(success);
 
 	co_return info.buffer.size() - ev.event.transferLen;
 }
 
+size_t Controller::EndpointState::numStreams() {
+	int endpointId = _endpoint * 2 + (_type == PipeType::in ? 1 : 0);
+	return _device->numStreams(endpointId);
+}
+
 // ------------------------------------------------------------------------
 // Freestanding PCI discovery functions.
 // ------------------------------------------------------------------------
@@ -47,6 +47,7 @@ namespace hcsparams2 {
 
 namespace hccparams1 {
 	arch::field<uint32_t, uint16_t> extCapPtr(16, 16);
+	arch::field<uint32_t, uint8_t> maxPsaSize(12, 4);
 	arch::field<uint32_t, bool> contextSize(2, 1);
 }
 
@@ -185,5 +186,10 @@ struct alignas(64) DeviceContext {
 };
 static_assert (sizeof(DeviceContext) == 32 * 32, "invalid DeviceContext size");
 
+struct alignas(16) StreamContext {
+	uint32_t val[4];
+};
+static_assert (sizeof(StreamContext) == 16, "invalid StreamContext size");
+
 
 #endif // XHCI_SPEC_HPP
@@ -1,4 +1,5 @@
 
+#include <map>
 #include <queue>
 
 #include <arch/mem_space.hpp>
@@ -103,14 +104,14 @@ private:
 
 		static_assert(sizeof(ErstEntry) == 64, "invalid ErstEntry size");
 
-		EventRing(Controller *controller);
+		EventRing(Controller *controller, int interrupter);
 		uintptr_t getErstPtr();
 		uintptr_t getEventRingPtr();
 		size_t getErstSize();
 
+		// Processes all pending events and then updates ERDP once.
 		void processRing();
 
-		std::deque<Event> _dequeuedEvents;
 		async::doorbell _doorbell;
 	private:
 		arch::dma_object<EventRingEntries> _eventRing;
@@ -120,6 +121,7 @@ private:
 
 		size_t _dequeuePtr;
 		Controller *_controller;
+		int _interrupter;
 
 		int _ccs;
 	};
@@ -144,9 +146,13 @@ private:
 		void updateDequeue(int current);
 		void updateLink();
 
+		// Returns true if the TRB at the given physical address belongs to this ring.
+		bool containsTrb(uintptr_t ptr);
+
 		std::array<TransferEvent *, transferRingSize> _transferEvents;
 	private:
 		arch::dma_object<TransferRingEntries> _transferRing;
+		uintptr_t _ptr;
 		size_t _dequeuePtr;
 		size_t _enqueuePtr;
 
@@ -159,6 +165,7 @@ private:
 		Interrupter(int id, Controller *controller);
 		void setEnable(bool enable);
 		void setEventRing(EventRing *ring, bool clear_ehb = false);
+		void setModeration(uint16_t interval);
 		bool isPending();
 		void clearPending();
 	private:
@@ -215,23 +222,41 @@ private:
 		async::result<Configuration> useConfiguration(int number) override;
 		async::result<void> transfer(ControlTransfer info) override;
 
-		void submit(int endpoint);
+		void submit(int endpoint, uint16_t stream = 0);
 		void pushRawTransfer(int endpoint, RawTrb cmd, TransferRing::TransferEvent *ev = nullptr);
 		async::result<void> allocSlot(int slotType, int packetSize);
 
 		async::result<void> readDescriptor(arch::dma_buffer_view dest, uint16_t desc);
 
+		// Sets up the endpoints of an alternate setting and selects it.
+		async::result<void> useInterface(int number, int alternative);
+
+		// Returns the ring of the given endpoint (or of one of its streams).
+		TransferRing *transferRing(int endpointId, uint32_t stream);
+
+		// Returns the ring that contains the TRB at the given physical address.
+		TransferRing *findTransferRing(int endpointId, uintptr_t trbPointer);
+
+		size_t numStreams(int endpointId);
+
 		std::array<std::unique_ptr<TransferRing>, 31> _transferRings;
 
 		int _slotId;
 
-		async::result<void> setupEndpoint(int endpoint, PipeType dir, size_t maxPacketSize, EndpointType type, bool drop = false);
+		// maxStreams is log2 of the number of streams that the device supports.
+		async::result<void> setupEndpoint(int endpoint, PipeType dir, size_t maxPacketSize,
+				EndpointType type, int maxBurst = 0, int maxStreams = 0);
 
 	private:
 		int _portId;
 		Controller *_controller;
 
 		arch::dma_object<DeviceContext> _devCtx;
+
+		// Endpoints with streams use one ring per stream (indexed by stream ID)
+		// instead of the ring in _transferRings.
+		std::array<std::vector<std::unique_ptr<TransferRing>>, 31> _streamRings;
+		std::array<arch::dma_array<StreamContext>, 31> _streamContexts;
 	};
 
 	struct SupportedProtocol {
@@ -270,6 +295,8 @@ private:
 		Controller *_controller;
 		std::shared_ptr<Device> _device;
 		int _number;
+		// Current alternate setting of each interface that was switched away from 0.
+		std::map<int, int> _alternatives;
 	};
 
 	struct InterfaceState final : InterfaceData {
@@ -289,6 +316,7 @@ private:
 		async::result<void> transfer(ControlTransfer info) override;
 		async::result<size_t> transfer(InterruptTransfer info) override;
 		async::result<size_t> transfer(BulkTransfer info) override;
+		size_t numStreams() override;
 
 	private:
 		Controller *_controller;
@@ -310,6 +338,20 @@ private:
 
 	void ringDoorbell(uint8_t doorbell, uint8_t target, uint16_t stream_id);
 
+	// Writes the doorbells that were deferred while processing events.
+	void flushDoorbells();
+
+	struct PendingDoorbell {
+		uint8_t doorbell;
+		uint8_t target;
+		uint16_t streamId;
+	};
+
+	// While set, ringDoorbell() only records the doorbell. This coalesces
+	// submissions that are triggered by the same batch of events.
+	bool _deferDoorbells = false;
+	std::vector<PendingDoorbell> _pendingDoorbells;
+
 	std::vector<std::pair<uint8_t, uint16_t>> getExtendedCapabilityOffsets();
 
 	arch::os::contiguous_pool _memoryPool;
@@ -323,10 +365,18 @@ private:
 	std::array<std::shared_ptr<Device>, 256> _devices;
 
 	CommandRing _cmdRing;
+	// Receives command completions, port status changes and the events of
+	// control and interrupt endpoints (i.e., HID devices).
 	EventRing _eventRing;
+	// Receives the events of bulk endpoints (i.e., mass storage devices) such that
+	// they do not compete with other devices. Null if there is only one interrupter.
+	std::unique_ptr<EventRing> _bulkEventRing;
+	int _bulkInterrupter = 0;
 
 	int _numPorts;
 	int _maxDeviceSlots;
+	// Maximal size of a primary stream array (zero if streams are not supported).
+	size_t _maxPrimaryStreams;
 };
 
 
@@ -16,7 +16,7 @@
 
 enum {
 	// largest system call number plus 1
-	kHelNumCalls = 102,
+	kHelNumCalls = 104,
 
 	kHelCallLog = 1,
 	kHelCallPanic = 10,
@@ -39,6 +39,7 @@ enum {
 	kHelCallCreateSliceView = 88,
 	kHelCallForkMemory = 40,
 	kHelCallCreateSpace = 27,
+	kHelCallForkSpace = 102,
 	kHelCallCreateIndirectMemory = 45,
 	kHelCallAlterMemoryIndirection = 52,
 	kHelCallMapMemory = 44,
@@ -67,6 +68,7 @@ enum {
 	kHelCallStoreRegisters = 76,
 	kHelCallWriteFsBase = 41,
 	kHelCallGetClock = 42,
+	kHelCallGetClockPage = 103,
 	kHelCallSubmitAwaitClock = 80,
 	kHelCallCreateVirtualizedCpu = 37,
 	kHelCallRunVirtualizedCpu = 38,
@@ -251,7 +253,24 @@ enum HelMapFlags {
 	kHelMapProtRead = 256,
 	kHelMapProtWrite = 512,
 	kHelMapProtExecute = 1024,
-	kHelMapDontRequireBacking = 128
+	kHelMapDontRequireBacking = 128,
+	kHelMapDontFork = 2048
+};
+
+enum HelClockPageFlags {
+	// The TSC is invariant and HelClockPage::tscTicksPerMilli is valid.
+	kHelClockPageTsc = 1
+};
+
+//! Layout of the memory object returned by ::helGetClockPage.
+struct HelClockPage {
+	//! Odd while the kernel updates the page.
+	uint64_t seqlock;
+	//! Flags from ::HelClockPageFlags.
+	uint32_t flags;
+	uint32_t padding;
+	//! The clock (see ::helGetClock) is TSC * 1'000'000 / tscTicksPerMilli.
+	uint64_t tscTicksPerMilli;
 };
 
 enum HelThreadFlags {
@@ -686,6 +705,17 @@ HEL_C_LINKAGE HelError helForkMemory(HelHandle handle, HelHandle *forkedHandle);
 //!     Handle to the new address space.
 HEL_C_LINKAGE HelError helCreateSpace(HelHandle *handle);
 
+//! Forks address spaces, i.e., copies all of their mappings into a new address space.
+//!
+//!    Mappings of memory objects created by ::helCopyOnWrite are forked
+//! (see ::helForkMemory); all other mappings are shared with the original space.
+//! Mappings that were created with @p kHelMapDontFork are not copied.
+//! @param[in] handle
+//!     Handle to the address space to be forked.
+//! @param[out] forkedHandle
+//!     Handle to the new (i.e., forked) address space.
+HEL_C_LINKAGE HelError helForkSpace(HelHandle handle, HelHandle *forkedHandle);
+
 //! Maps memory objects into an address space.
 //! @param[in] memoryHandle
 //!     Handle to the memory object.
@@ -906,6 +936,17 @@ HEL_C_LINKAGE HelError helWriteFsBase(void *pointer);
 //!     Current value of the system-wide clock in nanoseconds since boot.
 HEL_C_LINKAGE HelError helGetClock(uint64_t *counter);
 
+//! Obtain a memory object that exports the parameters of the system-wide clock.
+//!
+//!    The memory object is a single page that contains a ::HelClockPage.
+//! It allows user space to compute the value of ::helGetClock without a syscall.
+//! If @p kHelClockPageTsc is not set, ::helGetClock must be used instead.
+//! The memory object is read-only: it cannot be mapped with @p kHelMapProtWrite,
+//! written through ::helSubmitWriteMemory or wrapped by copy-on-write or indirect memory.
+//! @param[out] handle
+//!     Handle to the memory object.
+HEL_C_LINKAGE HelError helGetClockPage(HelHandle *handle);
+
 //! Wait until time passes.
 //!
 //! This is an asynchronous operation.
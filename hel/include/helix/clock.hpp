@@ -0,0 +1,50 @@
+#ifndef HELIX_CLOCK_HPP
+#define HELIX_CLOCK_HPP
+
+#include <helix/ipc.hpp>
+
+namespace helix {
+
+namespace detail {
+	inline HelClockPage *mapClockPage() {
+		HelHandle handle;
+		HEL_CHECK(helGetClockPage(&handle));
+		void *window;
+		HEL_CHECK(helMapMemory(handle, kHelNullHandle, nullptr,
+				0, 0x1000, kHelMapProtRead, &window));
+		HEL_CHECK(helCloseDescriptor(kHelThisUniverse, handle));
+		return static_cast<HelClockPage *>(window);
+	}
+} // namespace detail
+
+// Returns the current value of the system-wide clock (see helGetClock()).
+// If the kernel allows it, this reads the TSC instead of performing a syscall.
+inline uint64_t currentClock() {
+#ifdef __x86_64__
+	static HelClockPage *page = detail::mapClockPage();
+
+	while(true) {
+		auto seqlock = __atomic_load_n(&page->seqlock, __ATOMIC_ACQUIRE);
+		if(seqlock & 1)
+			continue;
+		if(!(__atomic_load_n(&page->flags, __ATOMIC_RELAXED) & kHelClockPageTsc))
+			break;
+		auto ticksPerMilli = __atomic_load_n(&page->tscTicksPerMilli, __ATOMIC_RELAXED);
+		auto tsc = __builtin_ia32_rdtsc();
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if(__atomic_load_n(&page->seqlock, __ATOMIC_RELAXED) != seqlock)
+			continue;
+		// This needs to match the kernel's computation exactly.
+		return tsc * 1'000'000 / ticksPerMilli;
+	}
+#endif
+
+	uint64_t clock;
+	HEL_CHECK(helGetClock(&clock));
+	return clock;
+}
+
+} // namespace helix
+
+#endif // HELIX_CLOCK_HPP
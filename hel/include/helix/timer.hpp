@@ -1,6 +1,7 @@
 #ifndef HELIX_TIMEOUT_HPP
 #define HELIX_TIMEOUT_HPP
 
+#include <helix/clock.hpp>
 #include <helix/ipc.hpp>
 #include <async/cancellation.hpp>
 
@@ -24,8 +25,7 @@ struct TimeoutCallback {
 
 private:
 	async::detached _runTimer(uint64_t duration) {
-		uint64_t tick;
-		HEL_CHECK(helGetClock(&tick));
+		auto tick = helix::currentClock();
 
 		helix::AwaitClock await;
 		auto &&submit = helix::submitAwaitClock(&await, tick + duration,
@@ -219,7 +219,7 @@ void doRunDetached(void (*function) (void *, void *), void *argument) {
 			: "x30", "x28", "x1", "x0", "memory");
 }
 
-void bootSecondary(unsigned int apic_id) { assert(!"Not implemented"); }
+void bootSecondaries(const unsigned int *, size_t) { assert(!"Not implemented"); }
 
 Error getEntropyFromCpu(void *buffer, size_t size) { return Error::noHardwareSupport; }
 
@@ -351,7 +351,7 @@ void doRunDetached(void (*function) (void *, void *), void *argument);
 
 void initializeThisProcessor();
 
-void bootSecondary(unsigned int apic_id);
+void bootSecondaries(const unsigned int *apicIds, size_t numAps);
 
 template<typename F>
 void forkExecutor(F functor, Executor *executor) {
@@ -13,7 +13,9 @@ namespace thor {
 
 enum {
 	kPageSize = 0x1000,
-	kPageShift = 12
+	kPageShift = 12,
+	kLargePageSize = 0x20'0000,
+	kLargePageShift = 21
 };
 
 constexpr Word kPfAccess = 1;
@@ -349,6 +351,14 @@ public:
 	bool isMapped(VirtualAddr pointer);
 	bool updatePageAccess(VirtualAddr pointer);
 
+	// Block mappings are not used on ARM; callers fall back to 4 KiB pages.
+	bool mapSingle2m(VirtualAddr, PhysicalAddr, bool, uint32_t, CachingMode) {
+		return false;
+	}
+	PageStatus unmapSingle2m(VirtualAddr) {
+		return 0;
+	}
+
 private:
 	frg::ticket_spinlock _mutex;
 };
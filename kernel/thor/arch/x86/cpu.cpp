@@ -4,6 +4,7 @@
 #include <thor-internal/kasan.hpp>
 #include <thor-internal/main.hpp>
 #include <thor-internal/physical.hpp>
+#include <thor-internal/profile.hpp>
 
 namespace thor {
 
@@ -434,6 +435,9 @@ bool handleUserAccessFault(uintptr_t address, bool write, FaultImageAccessor acc
 
 namespace {
 	frg::manual_box<frg::vector<CpuData *, KernelAlloc>> allCpuContexts;
+
+	// Protects allCpuContexts and earlyFibers while APs are initialized.
+	frg::ticket_spinlock cpuInitMutex;
 }
 
 size_t getStateSize() {
@@ -506,9 +510,14 @@ void initializeThisProcessor() {
 	// move it to a global variable and initialize it in initializeTheSystem() etc.!
 	auto cpu_data = getCpuData();
 
-	// TODO: If we want to make bootSecondary() parallel, we have to lock here.
-	cpu_data->cpuIndex = allCpuContexts->size();
-	allCpuContexts->push(cpu_data);
+	// APs are initialized in parallel.
+	{
+		auto irqLock = frg::guard(&irqMutex());
+		auto lock = frg::guard(&cpuInitMutex);
+
+		cpu_data->cpuIndex = allCpuContexts->size();
+		allCpuContexts->push(cpu_data);
+	}
 
 	// Allocate per-CPU areas.
 	cpu_data->irqStack = UniqueKernelStack::make();
@@ -725,7 +734,12 @@ void initializeThisProcessor() {
 	});
 	cpu_data->generalWorkQueue = wqFiber->associatedWorkQueue()->selfPtr.lock();
 	assert(cpu_data->generalWorkQueue);
-	earlyFibers->push(wqFiber);
+	{
+		auto irqLock = frg::guard(&irqMutex());
+		auto lock = frg::guard(&cpuInitMutex);
+
+		earlyFibers->push(wqFiber);
+	}
 
 	initLocalApicPerCpu();
 }
@@ -734,22 +748,37 @@ void initializeThisProcessor() {
 extern "C" uint8_t _binary_kernel_thor_arch_x86_trampoline_bin_start[];
 extern "C" uint8_t _binary_kernel_thor_arch_x86_trampoline_bin_end[];
 
+// Per-AP information. APs pick an entry in the order in which they enter long mode.
+struct ApBootInfo {
+	uintptr_t stack;
+	AssemblyCpuData *cpuContext;
+	unsigned int stage;
+	unsigned int padding;
+};
+
+static_assert(sizeof(ApBootInfo) == 24, "Bad sizeof(ApBootInfo)");
+
+// Shared by all APs that are booted at the same time. Keep this in sync with trampoline.S.
 struct StatusBlock {
 	StatusBlock *self; // Pointer to this struct in the higher half.
-	unsigned int targetStage;
+	unsigned int numAwake; // Incremented by each AP once it executes the trampoline.
 	unsigned int initiatorStage;
 	unsigned int pml4;
-	uintptr_t stack;
-	void (*main)(StatusBlock *);
-	AssemblyCpuData *cpuContext;
+	unsigned int nextIndex; // Index of the next free entry in apInfos.
+	ApBootInfo *apInfos;
+	void (*main)(StatusBlock *, ApBootInfo *);
+	uint64_t reserved;
 };
 
 static_assert(sizeof(StatusBlock) == 48, "Bad sizeof(StatusBlock)");
 
-void secondaryMain(StatusBlock *statusBlock) {
-	setupCpuContext(statusBlock->cpuContext);
+void secondaryMain(StatusBlock *, ApBootInfo *info) {
+	setupCpuContext(info->cpuContext);
+	// MADT local APIC entries only support 8-bit IDs; these match the initial APIC ID.
+	getCpuData()->localApicId = common::x86::cpuid(0x1)[1] >> 24;
 	initializeThisProcessor();
-	__atomic_store_n(&statusBlock->targetStage, 2, __ATOMIC_RELEASE);
+	initializeLocalProfile();
+	__atomic_store_n(&info->stage, 2, __ATOMIC_RELEASE);
 
 	infoLogger() << "Hello world from CPU #" << getLocalApicId() << frg::endlog;
 	localScheduler()->update();
@@ -758,77 +787,100 @@ void secondaryMain(StatusBlock *statusBlock) {
 	localScheduler()->invoke();
 }
 
-void bootSecondary(unsigned int apic_id) {
-	if(disableSmp)
+void bootSecondaries(const unsigned int *apicIds, size_t numAps) {
+	if(disableSmp || !numAps)
 		return;
 
+	auto bootStart = systemClockSource()->currentNanos();
+
 	// TODO: Allocate a page in low physical memory instead of hard-coding it.
 	uintptr_t pma = 0x10000;
 
 	// Copy the trampoline code into low physical memory.
+	// All APs share the same trampoline; they are told apart by their ApBootInfo.
 	auto image_size = (uintptr_t)_binary_kernel_thor_arch_x86_trampoline_bin_end
 			- (uintptr_t)_binary_kernel_thor_arch_x86_trampoline_bin_start;
-	assert(image_size <= kPageSize);
+	assert(image_size <= kPageSize - sizeof(StatusBlock));
 	PageAccessor accessor{pma};
 	memcpy(accessor.get(), _binary_kernel_thor_arch_x86_trampoline_bin_start, image_size);
 
-	// Allocate a stack for the initialization code.
-	constexpr size_t stack_size = 0x10000;
-	void *stack_ptr = kernelAlloc->allocate(stack_size);
+	auto apInfos = static_cast<ApBootInfo *>(kernelAlloc->allocate(numAps * sizeof(ApBootInfo)));
+	for(size_t i = 0; i < numAps; i++) {
+		// Allocate a stack for the initialization code.
+		constexpr size_t stack_size = 0x10000;
+		void *stack_ptr = kernelAlloc->allocate(stack_size);
 
-	auto context = frg::construct<CpuData>(*kernelAlloc);
-	context->localApicId = apic_id;
+		auto context = frg::construct<CpuData>(*kernelAlloc);
 
-	// Participate in global TLB invalidation *before* paging is used by the target CPU.
-	{
-		auto irqLock = frg::guard(&irqMutex());
+		// Participate in global TLB invalidation *before* paging is used by the target CPU.
+		{
+			auto irqLock = frg::guard(&irqMutex());
+
+			context->globalBinding.bind();
+		}
 
-		context->globalBinding.bind();
+		apInfos[i].stack = (uintptr_t)stack_ptr + stack_size;
+		apInfos[i].cpuContext = context;
+		apInfos[i].stage = 0;
 	}
 
-	// Setup a status block to communicate information to the AP.
+	// Setup a status block to communicate information to the APs.
 	auto statusBlock = reinterpret_cast<StatusBlock *>(reinterpret_cast<char *>(accessor.get())
 			+ (kPageSize - sizeof(StatusBlock)));
 	infoLogger() << "status block accessed via: " << statusBlock << frg::endlog;
 
 	statusBlock->self = statusBlock;
-	statusBlock->targetStage = 0;
+	statusBlock->numAwake = 0;
 	statusBlock->initiatorStage = 0;
 	statusBlock->pml4 = KernelPageSpace::global().rootTable();
-	statusBlock->stack = (uintptr_t)stack_ptr + stack_size;
+	statusBlock->nextIndex = 0;
+	statusBlock->apInfos = apInfos;
 	statusBlock->main = &secondaryMain;
-	statusBlock->cpuContext = context;
 
-	// Send the IPI sequence that starts up the AP.
+	// Send the IPI sequence that starts up the APs.
 	// On modern processors INIT lets the processor enter the wait-for-SIPI state.
 	// The BIOS is not involved in this process at all.
-	infoLogger() << "thor: Booting AP " << apic_id << "." << frg::endlog;
-	raiseInitAssertIpi(apic_id);
+	// Each step is performed for all APs at once, such that we only wait once per step.
+	infoLogger() << "thor: Booting " << numAps << " APs." << frg::endlog;
+	for(size_t i = 0; i < numAps; i++)
+		raiseInitAssertIpi(apicIds[i]);
 	KernelFiber::asyncBlockCurrent(generalTimerEngine()->sleepFor(10'000'000)); // Wait for 10ms.
 
 	// SIPI causes the processor to resume execution and resets CS:IP.
 	// Intel suggets to send two SIPIs (probably for redundancy reasons).
-	raiseStartupIpi(apic_id, pma);
+	for(size_t i = 0; i < numAps; i++)
+		raiseStartupIpi(apicIds[i], pma);
 	KernelFiber::asyncBlockCurrent(generalTimerEngine()->sleepFor(200'000)); // Wait for 200us.
-	raiseStartupIpi(apic_id, pma);
+	for(size_t i = 0; i < numAps; i++)
+		raiseStartupIpi(apicIds[i], pma);
 	KernelFiber::asyncBlockCurrent(generalTimerEngine()->sleepFor(200'000)); // Wait for 200us.
 
-	// Wait until the AP wakes up.
-	while(__atomic_load_n(&statusBlock->targetStage, __ATOMIC_ACQUIRE) < 1) {
+	// Wait until all APs wake up.
+	while(__atomic_load_n(&statusBlock->numAwake, __ATOMIC_ACQUIRE) < numAps) {
 		pause();
 	}
-	infoLogger() << "thor: AP did wake up." << frg::endlog;
+	auto awakeTime = systemClockSource()->currentNanos();
+	infoLogger() << "thor: All APs did wake up after "
+			<< (awakeTime - bootStart) / 1000 << " us." << frg::endlog;
 
-	// We only let the AP proceed after all IPIs have been sent.
-	// This ensures that the AP does not execute boot code twice (e.g. in case
+	// We only let the APs proceed after all IPIs have been sent.
+	// This ensures that no AP executes boot code twice (e.g. in case
 	// it already wakes up after a single SIPI).
 	__atomic_store_n(&statusBlock->initiatorStage, 1, __ATOMIC_RELEASE);
 
-	// Wait until the AP exits the boot code.
-	while(__atomic_load_n(&statusBlock->targetStage, __ATOMIC_ACQUIRE) < 2) {
-		pause();
+	// Wait until all APs exit the boot code. Per-CPU initialization runs in parallel.
+	for(size_t i = 0; i < numAps; i++) {
+		while(__atomic_load_n(&apInfos[i].stage, __ATOMIC_ACQUIRE) < 2) {
+			pause();
+		}
 	}
-	infoLogger() << "thor: AP finished booting." << frg::endlog;
+	auto onlineTime = systemClockSource()->currentNanos();
+	infoLogger() << "thor: All APs finished booting after "
+			<< (onlineTime - bootStart) / 1000 << " us (per-CPU initialization took "
+			<< (onlineTime - awakeTime) / 1000 << " us)." << frg::endlog;
+
+	// APs do not access the status block (or apInfos) after reaching stage 2.
+	kernelAlloc->free(apInfos);
 }
 
 Error getEntropyFromCpu(void *buffer, size_t size) {
@@ -474,6 +474,8 @@ extern "C" void onPlatformPing(IrqImageAccessor image) {
 	assert(!irqMutex().nesting());
 	disableUserAccess();
 
+	LocalApicContext::handlePing();
+
 	acknowledgeIpi();
 
 	handlePreemption(image);
@@ -502,16 +504,29 @@ extern "C" void onPlatformNmi(NmiImageAccessor image) {
 
 	auto cpuData = getCpuData();
 
+	auto recordSample = [&] {
+		ProfileRecord record{};
+		record.ip = *image.ip();
+		record.cpu = cpuData->cpuIndex;
+		// Decide by the privilege level such that all user code segments
+		// (including compatibility mode) count as user space.
+		if(!(*image.cs() & 3))
+			record.flags |= profile_flags::kernel;
+		if(auto thread = cpuData->activeExecutor.get(); thread) {
+			record.thread = reinterpret_cast<uintptr_t>(thread);
+			record.universe = reinterpret_cast<uintptr_t>(thread->getUniverse().get());
+		}
+		cpuData->localProfileRing->enqueue(&record, sizeof(ProfileRecord));
+	};
+
 	bool explained = false;
 	auto pmcMechanism = cpuData->profileMechanism.load(std::memory_order_acquire);
 	if(pmcMechanism == ProfileMechanism::intelPmc && checkIntelPmcOverflow()) {
-		uintptr_t ip = *image.ip();
-		cpuData->localProfileRing->enqueue(&ip, sizeof(uintptr_t));
+		recordSample();
 		setIntelPmc();
 		explained = true;
 	}else if(pmcMechanism == ProfileMechanism::amdPmc && checkAmdPmcOverflow()) {
-		uintptr_t ip = *image.ip();
-		cpuData->localProfileRing->enqueue(&ip, sizeof(uintptr_t));
+		recordSample();
 		setAmdPmc();
 		explained = true;
 	}
@@ -74,9 +74,12 @@ enum {
 	kPagePcd = 0x10,
 	kPageDirty = 0x40,
 	kPagePat = 0x80,
+	kPageLarge = 0x80, // Only valid in PDEs and PDPTEs.
 	kPageGlobal = 0x100,
+	kPageLargePat = 0x1000, // PAT bit of 2 MiB pages.
 	kPageXd = 0x8000000000000000,
-	kPageAddress = 0x000FFFFFFFFFF000
+	kPageAddress = 0x000FFFFFFFFFF000,
+	kPageLargeAddress = 0x000FFFFFFFE00000
 };
 
 namespace thor {
@@ -672,6 +675,36 @@ PhysicalAddr KernelPageSpace::unmapSingle4k(VirtualAddr pointer) {
 // ClientPageSpace
 // --------------------------------------------------------
 
+namespace {
+
+// Replaces a 2 MiB PDE by a PT that maps the same physical memory using 4 KiB pages.
+// The translation does not change, hence no TLB shootdown is required here.
+void splitLargePage(arch::scalar_variable<uint64_t> *pde) {
+	auto entry = pde->load();
+	assert(entry & kPagePresent);
+	assert(entry & kPageLarge);
+
+	auto tbl_address = physicalAllocator->allocate(kPageSize);
+	assert(tbl_address != PhysicalAddr(-1) && "OOM");
+	PageAccessor accessor{tbl_address};
+	auto tbl = reinterpret_cast<arch::scalar_variable<uint64_t> *>(accessor.get());
+
+	// Move the PAT bit to its PTE position; all other attribute bits stay the same.
+	uint64_t attributes = entry & ~(kPageLargeAddress | kPageLarge | kPageLargePat);
+	if(entry & kPageLargePat)
+		attributes |= kPagePat;
+	for(int i = 0; i < 512; i++)
+		tbl[i].store(((entry & kPageLargeAddress) + i * kPageSize) | attributes);
+
+	uint64_t new_entry = tbl_address | kPagePresent | kPageWrite;
+	if(entry & kPageUser)
+		new_entry |= kPageUser;
+	pde->store(new_entry);
+}
+
+} // anonymous namespace
+
+
 ClientPageSpace::ClientPageSpace()
 : PageSpace{physicalAllocator->allocate(kPageSize)} {
 	assert(rootTable() != PhysicalAddr(-1) && "OOM");
@@ -699,7 +732,8 @@ ClientPageSpace::~ClientPageSpace() {
 		PageAccessor accessor{ps};
 		auto tbl = reinterpret_cast<uint64_t *>(accessor.get());
 		for(int i = 0; i < 512; i++) {
-			if(tbl[i] & kPagePresent)
+			// Large pages do not own their physical memory; there is no PT to free.
+			if((tbl[i] & kPagePresent) && !(tbl[i] & kPageLarge))
 				physicalAllocator->free(tbl[i] & kPageAddress, kPageSize);
 		}
 	};
@@ -792,6 +826,8 @@ void ClientPageSpace::mapSingle4k(VirtualAddr pointer, PhysicalAddr physical,
 
 	// Make sure there is a PT.
 	tbl2 = reinterpret_cast<arch::scalar_variable<uint64_t> *>(accessor2.get());
+	if((tbl2[index2].load() & kPagePresent) && (tbl2[index2].load() & kPageLarge))
+		splitLargePage(&tbl2[index2]);
 	if(tbl2[index2].load() & kPagePresent) {
 		accessor1 = PageAccessor{tbl2[index2].load() & 0x000FFFFFFFFFF000};
 	}else{
@@ -828,6 +864,123 @@ void ClientPageSpace::mapSingle4k(VirtualAddr pointer, PhysicalAddr physical,
 	tbl1[index1].store(new_entry);
 }
 
+bool ClientPageSpace::mapSingle2m(VirtualAddr pointer, PhysicalAddr physical,
+		bool user_page, uint32_t flags, CachingMode caching_mode) {
+	assert(!(pointer & (kLargePageSize - 1)));
+	assert(!(physical & (kLargePageSize - 1)));
+
+	auto irq_lock = frg::guard(&irqMutex());
+	auto lock = frg::guard(&_mutex);
+
+	PageAccessor accessor4;
+	PageAccessor accessor3;
+	PageAccessor accessor2;
+
+	auto index4 = (int)((pointer >> 39) & 0x1FF);
+	auto index3 = (int)((pointer >> 30) & 0x1FF);
+	auto index2 = (int)((pointer >> 21) & 0x1FF);
+
+	// The PML4 does always exist.
+	accessor4 = PageAccessor{rootTable()};
+
+	// Make sure there is a PDPT.
+	auto tbl4 = reinterpret_cast<arch::scalar_variable<uint64_t> *>(accessor4.get());
+	if(tbl4[index4].load() & kPagePresent) {
+		accessor3 = PageAccessor{tbl4[index4].load() & 0x000FFFFFFFFFF000};
+	}else{
+		auto tbl_address = physicalAllocator->allocate(kPageSize);
+		assert(tbl_address != PhysicalAddr(-1) && "OOM");
+		accessor3 = PageAccessor{tbl_address};
+		memset(accessor3.get(), 0, kPageSize);
+
+		uint64_t new_entry = tbl_address | kPagePresent | kPageWrite;
+		if(user_page)
+			new_entry |= kPageUser;
+		tbl4[index4].store(new_entry);
+	}
+
+	// Make sure there is a PD.
+	auto tbl3 = reinterpret_cast<arch::scalar_variable<uint64_t> *>(accessor3.get());
+	if(tbl3[index3].load() & kPagePresent) {
+		accessor2 = PageAccessor{tbl3[index3].load() & 0x000FFFFFFFFFF000};
+	}else{
+		auto tbl_address = physicalAllocator->allocate(kPageSize);
+		assert(tbl_address != PhysicalAddr(-1) && "OOM");
+		accessor2 = PageAccessor{tbl_address};
+		memset(accessor2.get(), 0, kPageSize);
+
+		uint64_t new_entry = tbl_address | kPagePresent | kPageWrite;
+		if(user_page)
+			new_entry |= kPageUser;
+		tbl3[index3].store(new_entry);
+	}
+
+	// We do not replace existing PTs by large pages, as that would require us
+	// to invalidate paging structure caches. Let the caller fall back to 4 KiB pages.
+	auto tbl2 = reinterpret_cast<arch::scalar_variable<uint64_t> *>(accessor2.get());
+	if(tbl2[index2].load() & kPagePresent)
+		return false;
+
+	uint64_t new_entry = physical | kPagePresent | kPageLarge;
+	if(user_page)
+		new_entry |= kPageUser;
+	if(flags & page_access::write)
+		new_entry |= kPageWrite;
+	if(!(flags & page_access::execute))
+		new_entry |= kPageXd;
+	if(caching_mode == CachingMode::writeThrough) {
+		new_entry |= kPagePwt;
+	}else if(caching_mode == CachingMode::writeCombine) {
+		new_entry |= kPageLargePat | kPagePwt;
+	}else{
+		assert(caching_mode == CachingMode::null || caching_mode == CachingMode::writeBack);
+	}
+	tbl2[index2].store(new_entry);
+	return true;
+}
+
+PageStatus ClientPageSpace::unmapSingle2m(VirtualAddr pointer) {
+	assert(!(pointer & (kLargePageSize - 1)));
+
+	auto irq_lock = frg::guard(&irqMutex());
+	auto lock = frg::guard(&_mutex);
+
+	PageAccessor accessor4;
+	PageAccessor accessor3;
+	PageAccessor accessor2;
+
+	auto index4 = (int)((pointer >> 39) & 0x1FF);
+	auto index3 = (int)((pointer >> 30) & 0x1FF);
+	auto index2 = (int)((pointer >> 21) & 0x1FF);
+
+	// The PML4 is always present.
+	accessor4 = PageAccessor{rootTable()};
+	auto tbl4 = reinterpret_cast<arch::scalar_variable<uint64_t> *>(accessor4.get());
+
+	// Find the PDPT.
+	if(!(tbl4[index4].load() & kPagePresent))
+		return 0;
+	accessor3 = PageAccessor{tbl4[index4].load() & 0x000FFFFFFFFFF000};
+	auto tbl3 = reinterpret_cast<arch::scalar_variable<uint64_t> *>(accessor3.get());
+
+	// Find the PD.
+	if(!(tbl3[index3].load() & kPagePresent))
+		return 0;
+	accessor2 = PageAccessor{tbl3[index3].load() & 0x000FFFFFFFFFF000};
+	auto tbl2 = reinterpret_cast<arch::scalar_variable<uint64_t> *>(accessor2.get());
+
+	// Only large pages are unmapped here; PTs are left alone.
+	auto entry = tbl2[index2].load();
+	if(!(entry & kPagePresent) || !(entry & kPageLarge))
+		return 0;
+
+	auto bits = tbl2[index2].atomic_exchange(0);
+	PageStatus status = page_status::present;
+	if(bits & kPageDirty)
+		status |= page_status::dirty;
+	return status;
+}
+
 PageStatus ClientPageSpace::unmapSingle4k(VirtualAddr pointer) {
 	assert(!(pointer & (kPageSize - 1)));
 
@@ -862,10 +1015,12 @@ PageStatus ClientPageSpace::unmapSingle4k(VirtualAddr pointer) {
 	accessor2 = PageAccessor{tbl3[index3].load() & 0x000FFFFFFFFFF000};
 	auto tbl2 = reinterpret_cast<arch::scalar_variable<uint64_t> *>(accessor2.get());
 
-	// Find the PT.
+	// Find the PT. Partial unmaps of large pages require us to split them first.
 	if(!(tbl2[index2].load() & kPagePresent))
 		return 0;
 	assert(tbl2[index2].load() & kPagePresent);
+	if(tbl2[index2].load() & kPageLarge)
+		splitLargePage(&tbl2[index2]);
 	accessor1 = PageAccessor{tbl2[index2].load() & 0x000FFFFFFFFFF000};
 	auto tbl1 = reinterpret_cast<arch::scalar_variable<uint64_t> *>(accessor1.get());
 
@@ -918,6 +1073,14 @@ PageStatus ClientPageSpace::cleanSingle4k(VirtualAddr pointer) {
 	if(!(tbl2[index2].load() & kPagePresent))
 		return 0;
 	assert(tbl2[index2].load() & kPagePresent);
+	if(tbl2[index2].load() & kPageLarge) {
+		// Large pages are only used for memory that does not track dirty pages.
+		// Report the state of the whole large page but do not split it.
+		PageStatus status = page_status::present;
+		if(tbl2[index2].load() & kPageDirty)
+			status |= page_status::dirty;
+		return status;
+	}
 	accessor1 = PageAccessor{tbl2[index2].load() & 0x000FFFFFFFFFF000};
 	auto tbl1 = reinterpret_cast<arch::scalar_variable<uint64_t> *>(accessor1.get());
 
@@ -972,6 +1135,8 @@ bool ClientPageSpace::isMapped(VirtualAddr pointer) {
 	// Find the PT.
 	if(!(tbl2[index2].load() & kPagePresent))
 		return false;
+	if(tbl2[index2].load() & kPageLarge)
+		return true;
 	accessor1 = PageAccessor{tbl2[index2].load() & 0x000FFFFFFFFFF000};
 	tbl1 = reinterpret_cast<arch::scalar_variable<uint64_t> *>(accessor1.get());
 
@@ -96,30 +96,27 @@ namespace {
 	// TODO: APIC variables should be CPU-specific.
 	uint32_t apicTicksPerMilli;
 
-	GlobalApicContext *globalApicContextInstance;
-
 	LocalApicContext *localApicContext() {
 		return &getCpuData()->apicContext;
 	}
 }
 
-GlobalApicContext *globalApicContext() {
-	return globalApicContextInstance;
-}
-
-void GlobalApicContext::GlobalAlarmSlot::arm(uint64_t nanos) {
+void LocalApicContext::LocalAlarmSlot::arm(uint64_t nanos) {
 	assert(apicIsCalibrated);
 
-	{
-		auto irq_lock = frg::guard(&irqMutex());
-		auto lock = frg::guard(&globalApicContext()->_mutex);
-		globalApicContext()->_globalDeadline = nanos;
+	_deadline.store(nanos, std::memory_order_relaxed);
+	if(getCpuData()->cpuIndex == _cpuIndex) {
+		LocalApicContext::_updateLocalTimer();
+	}else{
+		// The engine of another CPU was used (e.g., by a thread that migrated
+		// after looking up generalTimerEngine()). Let that CPU reprogram its timer.
+		_remoteArm.store(true, std::memory_order_release);
+		sendPingIpi(_cpuIndex);
 	}
-	LocalApicContext::_updateLocalTimer();
 }
 
 LocalApicContext::LocalApicContext()
-: _preemptionDeadline{0}, _globalDeadline{0} { }
+: _preemptionDeadline{0} { }
 
 void LocalApicContext::setPreemption(uint64_t nanos) {
 	assert(apicIsCalibrated);
@@ -140,21 +137,29 @@ void LocalApicContext::handleTimerIrq() {
 	if(self->_preemptionDeadline && now > self->_preemptionDeadline)
 		self->_preemptionDeadline = 0;
 
-	if(self->_globalDeadline && now > self->_globalDeadline) {
-		self->_globalDeadline = 0;
-		globalApicContext()->_globalAlarmInstance.fireAlarm();
-
-		// Update the global deadline to avoid calling fireAlarm() on the next IRQ.
-		{
-			auto irq_lock = frg::guard(&irqMutex());
-			auto lock = frg::guard(&globalApicContext()->_mutex);
-			localApicContext()->_globalDeadline = globalApicContext()->_globalDeadline;
-		}
+	auto alarmDeadline = self->_alarm._deadline.load(std::memory_order_relaxed);
+	if(alarmDeadline && now > alarmDeadline) {
+		// If this races with a remote arm(), the engine re-arms us from firedAlarm().
+		self->_alarm._deadline.store(0, std::memory_order_relaxed);
+		self->_alarm.fireAlarm();
 	}
 
 	localApicContext()->_updateLocalTimer();
 }
 
+void LocalApicContext::handlePing() {
+	auto self = localApicContext();
+	if(self->_alarm._remoteArm.exchange(false, std::memory_order_acquire))
+		_updateLocalTimer();
+}
+
+void LocalApicContext::_setupTimerEngine() {
+	auto self = localApicContext();
+	self->_alarm._cpuIndex = getCpuData()->cpuIndex;
+	getCpuData()->timerEngine = frg::construct<PrecisionTimerEngine>(*kernelAlloc,
+			systemClockSource(), &self->_alarm);
+}
+
 void LocalApicContext::_updateLocalTimer() {
 	uint64_t deadline = 0;
 	auto consider = [&] (uint64_t dc) {
@@ -164,15 +169,8 @@ void LocalApicContext::_updateLocalTimer() {
 			deadline = dc;
 	};
 
-	// Copy the global deadline so we can access it without locking.
-	{
-		auto irq_lock = frg::guard(&irqMutex());
-		auto lock = frg::guard(&globalApicContext()->_mutex);
-		localApicContext()->_globalDeadline = globalApicContext()->_globalDeadline;
-	}
-
 	consider(localApicContext()->_preemptionDeadline);
-	consider(localApicContext()->_globalDeadline);
+	consider(localApicContext()->_alarm._deadline.load(std::memory_order_relaxed));
 
 	if(getCpuData()->haveTscDeadline) {
 		if(!deadline) {
@@ -299,6 +297,10 @@ void initLocalApicPerCpu() {
 
 	// Setup the PMI.
 	picBase.store(lApicLvtPerfCount, apicLvtMode(4));
+
+	// On the BSP, this happens in calibrateApicTimer() instead.
+	if(apicIsCalibrated)
+		LocalApicContext::_setupTimerEngine();
 }
 
 uint32_t getLocalApicId() {
@@ -323,7 +325,6 @@ TimeStampCounter *globalTscInstance;
 extern ClockSource *hpetClockSource;
 extern AlarmTracker *hpetAlarmTracker;
 extern ClockSource *globalClockSource;
-extern PrecisionTimerEngine *globalTimerEngine;
 
 void calibrateApicTimer() {
 	const uint64_t millis = 100;
@@ -348,16 +349,27 @@ void calibrateApicTimer() {
 	tscTicksPerMilli = tsc_elapsed / millis;
 	infoLogger() << "thor: TSC ticks/ms: " << tscTicksPerMilli << frg::endlog;
 
+	// Only an invariant TSC can be used to compute the clock in user space;
+	// otherwise, user space falls back to helGetClock().
+	bool invariantTsc = common::x86::cpuid(0x8000'0000)[0] >= 0x8000'0007
+			&& (common::x86::cpuid(0x8000'0007)[3] & (uint32_t(1) << 8));
+	if(invariantTsc) {
+		publishTscClock(tscTicksPerMilli);
+	}else{
+		infoLogger() << "thor: TSC is not invariant, user space will use helGetClock()"
+				<< frg::endlog;
+	}
+
 	apicIsCalibrated = true;
 
 	globalTscInstance = frg::construct<TimeStampCounter>(*kernelAlloc);
-	globalApicContextInstance = frg::construct<GlobalApicContext>(*kernelAlloc);
 
 	globalClockSource = globalTscInstance;
 //	globalClockSource = hpetClockSource;
-	globalTimerEngine = frg::construct<PrecisionTimerEngine>(*kernelAlloc,
-			globalClockSource, globalApicContext()->globalAlarm());
-//			globalClockSource, hpetAlarmTracker);
+
+	// Each CPU gets its own timer engine backed by its local APIC timer.
+	// APs set up their engines in initLocalApicPerCpu().
+	LocalApicContext::_setupTimerEngine();
 }
 
 void acknowledgeIpi() {
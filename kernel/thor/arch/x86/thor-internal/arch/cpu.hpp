@@ -618,7 +618,8 @@ void doRunDetached(void (*function) (void *, void *), void *argument);
 void setupBootCpuContext();
 void initializeThisProcessor();
 
-void bootSecondary(unsigned int apic_id);
+// Boots all given APs in parallel.
+void bootSecondaries(const unsigned int *apicIds, size_t numAps);
 
 template<typename F>
 void forkExecutor(F functor, Executor *executor) {
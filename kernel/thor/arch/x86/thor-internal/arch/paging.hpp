@@ -13,7 +13,9 @@ namespace thor {
 
 enum {
 	kPageSize = 0x1000,
-	kPageShift = 12
+	kPageShift = 12,
+	kLargePageSize = 0x20'0000,
+	kLargePageShift = 21
 };
 
 constexpr Word kPfAccess = 1;
@@ -347,6 +349,12 @@ public:
 	bool isMapped(VirtualAddr pointer);
 	bool updatePageAccess(VirtualAddr pointer);
 
+	// Maps a 2 MiB page. Returns false if the range is already (partially) mapped.
+	bool mapSingle2m(VirtualAddr pointer, PhysicalAddr physical, bool user_access,
+			uint32_t flags, CachingMode caching_mode);
+	// Unmaps a 2 MiB page. Returns zero if there is no 2 MiB page at the given address.
+	PageStatus unmapSingle2m(VirtualAddr pointer);
+
 private:
 	frg::ticket_spinlock _mutex;
 };
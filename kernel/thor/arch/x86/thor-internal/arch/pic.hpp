@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+
 #include <arch/mem_space.hpp>
 #include <x86/machine.hpp>
 #include <thor-internal/initgraph.hpp>
@@ -54,30 +56,21 @@ private:
 	static constexpr uint32_t x2apic_msr_base = 0x800;
 };
 
-struct GlobalApicContext {
-	friend struct LocalApicContext;
+struct LocalApicContext {
+	// Alarm that backs the timer engine of this CPU.
+	struct LocalAlarmSlot : AlarmTracker {
+		friend struct LocalApicContext;
 
-	struct GlobalAlarmSlot : AlarmTracker {
 		using AlarmTracker::fireAlarm;
 
 		void arm(uint64_t nanos) override;
-	};
-
-	AlarmTracker *globalAlarm() {
-		return &_globalAlarmInstance;
-	}
-
-private:
-	GlobalAlarmSlot _globalAlarmInstance;
-
-private:
-	frg::ticket_spinlock _mutex;
 
-	uint64_t _globalDeadline;
-};
-
-struct LocalApicContext {
-	friend struct GlobalApicContext;
+	private:
+		int _cpuIndex = -1;
+		std::atomic<uint64_t> _deadline{0};
+		// Set if another CPU armed this alarm; it is picked up by the ping IPI.
+		std::atomic<bool> _remoteArm{false};
+	};
 
 	LocalApicContext();
 
@@ -85,16 +78,21 @@ struct LocalApicContext {
 
 	static void handleTimerIrq();
 
+	static void handlePing();
+
 private:
 	static void _updateLocalTimer();
 
+	static void _setupTimerEngine();
+
+	friend void calibrateApicTimer();
+	friend void initLocalApicPerCpu();
+
 private:
 	uint64_t _preemptionDeadline;
-	uint64_t _globalDeadline;
+	LocalAlarmSlot _alarm;
 };
 
-GlobalApicContext *globalApicContext();
-
 initgraph::Stage *getApicDiscoveryStage();
 
 void initLocalApicPerCpu();
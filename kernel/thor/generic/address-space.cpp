@@ -1,18 +1,33 @@
 
+#include <atomic>
 #include <type_traits>
 #include <thor-internal/coroutine.hpp>
 #include <thor-internal/physical.hpp>
 #include <thor-internal/fiber.hpp>
+#include <thor-internal/main.hpp>
 #include <frg/container_of.hpp>
+#include <frg/string.hpp>
 #include <thor-internal/types.hpp>
 
 namespace thor {
 
 extern size_t kernelMemoryUsage;
+extern frg::manual_box<frg::string<KernelAlloc>> kernelCommandLine;
 
 namespace {
 	constexpr bool logCleanup = false;
 	constexpr bool logUsage = false;
+	constexpr bool logFaultAround = false;
+
+	// Size of the naturally aligned window around a faulting page in which
+	// already present pages are mapped as well. Can be changed by passing
+	// fault-around=<pages> on the kernel command line; 0 or 1 disables fault-around.
+	size_t faultAroundWindow = 0x10000;
+
+	// Number of faults that were resolved and number of pages mapped by fault-around.
+	// The latter is the number of faults that were saved (assuming that the pages are accessed).
+	std::atomic<uint64_t> numResolvedFaults{0};
+	std::atomic<uint64_t> numFaultAroundPages{0};
 
 	void logRss(VirtualSpace *space) {
 		if(!logUsage)
@@ -31,6 +46,20 @@ namespace {
 				<< (physicalAllocator->numUsedPages() * 4) << " KiB, kernel usage: "
 				<< (kernelMemoryUsage / 1024) << " KiB" << frg::endlog;
 	}
+
+	// Checks whether the large page at the given offset into the mapping
+	// can be mapped as a whole (modulo the alignment of the physical memory).
+	bool isLargePageCandidate(Mapping *mapping, uintptr_t offset) {
+		if(offset & (kLargePageSize - 1))
+			return false;
+		if(offset + kLargePageSize > mapping->length)
+			return false;
+		if((mapping->address + offset) & (kLargePageSize - 1))
+			return false;
+		if((mapping->viewOffset + offset) & (kLargePageSize - 1))
+			return false;
+		return mapping->view->providesLargePage(mapping->viewOffset + offset);
+	}
 }
 
 MemorySlice::MemorySlice(smarter::shared_ptr<MemoryView> view,
@@ -116,6 +145,8 @@ void Mapping::protect(MappingFlags protectFlags) {
 	std::underlying_type_t<MappingFlags> newFlags = flags;
 	newFlags &= ~(MappingFlags::protRead | MappingFlags::protWrite | MappingFlags::protExecute);
 	newFlags |= protectFlags;
+	if(view->isReadOnly())
+		newFlags &= ~MappingFlags::protWrite;
 	flags = static_cast<MappingFlags>(newFlags);
 }
 
@@ -190,6 +221,41 @@ void Mapping::touchVirtualPage(uintptr_t offset,
 		if(self->flags & MappingFlags::dontRequireBacking)
 			fetchFlags |= FetchNode::disallowBacking;
 
+		// Try to map the surrounding large page first.
+		auto largeOffset = offset & ~uintptr_t(kLargePageSize - 1);
+		if(isLargePageCandidate(self, largeOffset)) {
+			if(auto e = co_await self->view->asyncLockRange(
+					self->viewOffset + largeOffset, kLargePageSize,
+					wq); e != Error::success)
+				assert(!"asyncLockRange() failed");
+
+			auto [error, range, rangeFlags] = co_await self->view->fetchRange(
+					self->viewOffset + largeOffset, wq);
+
+			bool mapped = false;
+			if(!(range.get<0>() & (kLargePageSize - 1)) && range.get<1>() >= kLargePageSize) {
+				auto status = self->owner->_ops->unmapSingle2m(self->address + largeOffset);
+				if(self->owner->_ops->mapSingle2m(self->address + largeOffset,
+						range.get<0>(), self->compilePageFlags(), range.get<2>())) {
+					if(!(status & page_status::present)) {
+						self->owner->_residuentSize += kLargePageSize;
+						logRss(self->owner.get());
+					}
+					mapped = true;
+				}
+			}
+
+			self->view->unlockRange(self->viewOffset + largeOffset, kLargePageSize);
+
+			if(mapped) {
+				auto disp = offset - largeOffset;
+				node->result = TouchVirtualResult{PhysicalRange{range.get<0>() + disp,
+						kLargePageSize - disp, range.get<2>()}, false};
+				node->resume();
+				co_return;
+			}
+		}
+
 		if(auto e = co_await self->view->asyncLockRange(
 				(self->viewOffset + offset) & ~(kPageSize - 1), kPageSize,
 				wq); e != Error::success)
@@ -270,12 +336,17 @@ coroutine<void> Mapping::runEvictionLoop() {
 
 CowChain::CowChain(smarter::shared_ptr<CowChain> chain)
 : _superChain{std::move(chain)}, _pages{*kernelAlloc} {
+	if(_superChain)
+		_superChain->_numUsers.fetch_add(1, std::memory_order_relaxed);
 }
 
 CowChain::~CowChain() {
 	if(logCleanup)
 		infoLogger() << "thor: Releasing CowChain" << frg::endlog;
 
+	if(_superChain)
+		_superChain->_numUsers.fetch_sub(1, std::memory_order_relaxed);
+
 	for(auto it = _pages.begin(); it != _pages.end(); ++it) {
 		auto physical = it->load(std::memory_order_relaxed);
 		assert(physical != PhysicalAddr(-1));
@@ -316,13 +387,24 @@ void VirtualSpace::retire() {
 		assert(mapping->state == MappingState::active);
 		mapping->state = MappingState::zombie;
 
-		for(size_t progress = 0; progress < mapping->length; progress += kPageSize) {
+		size_t progress = 0;
+		while(progress < mapping->length) {
 			VirtualAddr vaddr = mapping->address + progress;
+			if(isLargePageCandidate(mapping, progress)) {
+				auto status = _ops->unmapSingle2m(vaddr);
+				if(status & page_status::present) {
+					_residuentSize -= kLargePageSize;
+					progress += kLargePageSize;
+					continue;
+				}
+			}
+
 			auto status = _ops->unmapSingle4k(vaddr);
+			progress += kPageSize;
 			if(!(status & page_status::present))
 				continue;
 			if(status & page_status::dirty)
-				mapping->view->markDirty(mapping->viewOffset + progress, kPageSize);
+				mapping->view->markDirty(mapping->viewOffset + progress - kPageSize, kPageSize);
 			_residuentSize -= kPageSize;
 		}
 
@@ -368,6 +450,10 @@ bool VirtualSpace::map(smarter::borrowed_ptr<MemorySlice> slice,
 		node->nodeResult_.emplace(Error::bufferTooSmall);
 		return true;
 	}
+	if((flags & kMapProtWrite) && slice->getView()->isReadOnly()) {
+		node->nodeResult_.emplace(Error::illegalArgs);
+		return true;
+	}
 
 	VirtualAddr actualAddress;
 	{
@@ -413,6 +499,8 @@ bool VirtualSpace::map(smarter::borrowed_ptr<MemorySlice> slice,
 
 		if(flags & kMapDontRequireBacking)
 			mappingFlags |= MappingFlags::dontRequireBacking;
+		if(flags & kMapDontFork)
+			mappingFlags |= MappingFlags::dontFork;
 
 		auto mapping = smarter::allocate_shared<Mapping>(Allocator{},
 				length, static_cast<MappingFlags>(mappingFlags),
@@ -446,17 +534,30 @@ bool VirtualSpace::map(smarter::borrowed_ptr<MemorySlice> slice,
 			auto irqLock = frg::guard(&irqMutex());
 			auto lock = frg::guard(&mapping->evictMutex);
 
-			for(size_t progress = 0; progress < mapping->length; progress += kPageSize) {
+			size_t progress = 0;
+			while(progress < mapping->length) {
 				auto physicalRange = mapping->view->peekRange(mapping->viewOffset + progress);
 
 				VirtualAddr vaddr = mapping->address + progress;
 				assert(!_ops->isMapped(vaddr));
+				if(physicalRange.get<0>() != PhysicalAddr(-1)
+						&& !(physicalRange.get<0>() & (kLargePageSize - 1))
+						&& isLargePageCandidate(mapping.get(), progress)
+						&& _ops->mapSingle2m(vaddr, physicalRange.get<0>(),
+								pageFlags, physicalRange.get<1>())) {
+					_residuentSize += kLargePageSize;
+					logRss(this);
+					progress += kLargePageSize;
+					continue;
+				}
+
 				if(physicalRange.get<0>() != PhysicalAddr(-1)) {
 					_ops->mapSingle4k(vaddr, physicalRange.get<0>(),
 							pageFlags, physicalRange.get<1>());
 					_residuentSize += kPageSize;
 					logRss(this);
 				}
+				progress += kPageSize;
 			}
 		}
 
@@ -519,15 +620,31 @@ bool VirtualSpace::protect(VirtualAddr address, size_t length,
 		auto irqLock = frg::guard(&irqMutex());
 		auto lock = frg::guard(&mapping->evictMutex);
 
-		for(size_t progress = 0; progress < mapping->length; progress += kPageSize) {
+		size_t progress = 0;
+		while(progress < mapping->length) {
 			auto physicalRange = mapping->view->peekRange(mapping->viewOffset + progress);
 
 			VirtualAddr vaddr = mapping->address + progress;
+			if(isLargePageCandidate(mapping.get(), progress)) {
+				auto status = _ops->unmapSingle2m(vaddr);
+				if(status & page_status::present) {
+					// Large pages are never evicted, hence the memory must still be present.
+					assert(physicalRange.get<0>() != PhysicalAddr(-1));
+					auto success = _ops->mapSingle2m(vaddr, physicalRange.get<0>(),
+							pageFlags, physicalRange.get<1>());
+					assert(success);
+					(void)success;
+					progress += kLargePageSize;
+					continue;
+				}
+			}
+
+			progress += kPageSize;
 			auto status = _ops->unmapSingle4k(vaddr);
 			if(!(status & page_status::present))
 				continue;
 			if(status & page_status::dirty)
-				mapping->view->markDirty(mapping->viewOffset + progress, kPageSize);
+				mapping->view->markDirty(mapping->viewOffset + progress - kPageSize, kPageSize);
 			if(physicalRange.get<0>() != PhysicalAddr(-1)) {
 				_ops->mapSingle4k(vaddr, physicalRange.get<0>(),
 						pageFlags, physicalRange.get<1>());
@@ -563,13 +680,24 @@ bool VirtualSpace::unmap(VirtualAddr address, size_t length, AddressUnmapNode *n
 	}
 
 	// Mark pages as dirty and unmap without holding a lock.
-	for(size_t progress = 0; progress < mapping->length; progress += kPageSize) {
+	size_t progress = 0;
+	while(progress < mapping->length) {
 		VirtualAddr vaddr = mapping->address + progress;
+		if(isLargePageCandidate(mapping.get(), progress)) {
+			auto status = _ops->unmapSingle2m(vaddr);
+			if(status & page_status::present) {
+				_residuentSize -= kLargePageSize;
+				progress += kLargePageSize;
+				continue;
+			}
+		}
+
 		auto status = _ops->unmapSingle4k(vaddr);
+		progress += kPageSize;
 		if(!(status & page_status::present))
 			continue;
 		if(status & page_status::dirty)
-			mapping->view->markDirty(mapping->viewOffset + progress, kPageSize);
+			mapping->view->markDirty(mapping->viewOffset + progress - kPageSize, kPageSize);
 		_residuentSize -= kPageSize;
 	}
 
@@ -712,6 +840,73 @@ void VirtualSpace::synchronize(VirtualAddr address, size_t size, SynchronizeNode
 	}(this, alignedAddress, alignedSize, node));
 }
 
+coroutine<Error> VirtualSpace::fork(VirtualSpace *forkedSpace) {
+	frg::vector<smarter::shared_ptr<Mapping>, KernelAlloc> mappings{*kernelAlloc};
+	{
+		auto irqLock = frg::guard(&irqMutex());
+		auto spaceLock = frg::guard(&_mutex);
+
+		auto mapping = _mappings.first();
+		while(mapping) {
+			if(mapping->state == MappingState::active
+					&& !(mapping->flags & MappingFlags::dontFork))
+				mappings.push(mapping->selfPtr.lock());
+			mapping = MappingTree::successor(mapping);
+		}
+	}
+
+	// Views that are mapped multiple times must only be forked once.
+	frg::vector<frg::tuple<MemoryView *, smarter::shared_ptr<MemoryView>>, KernelAlloc>
+			forkedViews{*kernelAlloc};
+
+	for(size_t i = 0; i < mappings.size(); i++) {
+		auto mapping = mappings[i].get();
+
+		smarter::shared_ptr<MemorySlice> slice;
+		for(size_t j = 0; j < forkedViews.size(); j++) {
+			if(forkedViews[j].get<0>() != mapping->view.get())
+				continue;
+			slice = smarter::allocate_shared<MemorySlice>(*kernelAlloc,
+					forkedViews[j].get<1>(), mapping->slice->offset(),
+					mapping->slice->length());
+			break;
+		}
+
+		if(!slice) {
+			auto [error, forkedView] = co_await mapping->view->fork();
+			if(error == Error::success) {
+				forkedViews.push({mapping->view.get(), forkedView});
+				slice = smarter::allocate_shared<MemorySlice>(*kernelAlloc,
+						std::move(forkedView), mapping->slice->offset(),
+						mapping->slice->length());
+			}else if(error == Error::illegalObject) {
+				slice = mapping->slice;
+			}else{
+				co_return error;
+			}
+		}
+
+		uint32_t flags = kMapFixed;
+		auto permissions = mapping->flags & MappingFlags::permissionMask;
+		if(permissions & MappingFlags::protRead)
+			flags |= kMapProtRead;
+		if(permissions & MappingFlags::protWrite)
+			flags |= kMapProtWrite;
+		if(permissions & MappingFlags::protExecute)
+			flags |= kMapProtExecute;
+		if(mapping->flags & MappingFlags::dontRequireBacking)
+			flags |= kMapDontRequireBacking;
+
+		// map() also copies the PTEs of all pages that are present in the view.
+		auto result = co_await forkedSpace->map(slice, mapping->address,
+				mapping->viewOffset - mapping->slice->offset(), mapping->length, flags);
+		if(!result)
+			co_return result.error();
+	}
+
+	co_return Error::success;
+}
+
 frg::optional<bool>
 VirtualSpace::handleFault(VirtualAddr address, uint32_t faultFlags,
 		smarter::shared_ptr<WorkQueue> wq, FaultNode *node) {
@@ -739,7 +934,7 @@ VirtualSpace::handleFault(VirtualAddr address, uint32_t faultFlags,
 			uintptr_t address,
 			smarter::shared_ptr<WorkQueue> wq, FaultNode *node) -> coroutine<void> {
 		auto faultPage = (address - mapping->address) & ~(kPageSize - 1);
-		auto outcome = co_await mapping->touchVirtualPage(faultPage, std::move(wq));
+		auto outcome = co_await mapping->touchVirtualPage(faultPage, wq);
 		if(!outcome) {
 			node->complete(false);
 			co_return;
@@ -750,12 +945,119 @@ VirtualSpace::handleFault(VirtualAddr address, uint32_t faultFlags,
 		if(outcome.value().spurious)
 				infoLogger() << "\e[33m" "thor: Spurious page fault"
 						"\e[39m" << frg::endlog;
+
+		auto numMapped = co_await mapping->owner->_faultAround(mapping.get(), faultPage,
+				std::move(wq));
+
+		auto faults = numResolvedFaults.fetch_add(1, std::memory_order_relaxed) + 1;
+		auto saved = numFaultAroundPages.fetch_add(numMapped, std::memory_order_relaxed)
+				+ numMapped;
+		if(logFaultAround && !(faults % 4096))
+			infoLogger() << "thor: " << faults << " page faults resolved, "
+					<< saved << " faults saved by fault-around" << frg::endlog;
+
 		node->complete(true);
 	}(std::move(mapping), address, std::move(wq), node));
 
 	return {};
 }
 
+coroutine<size_t> VirtualSpace::_faultAround(Mapping *mapping, uintptr_t faultOffset,
+		smarter::shared_ptr<WorkQueue> wq) {
+	auto window = faultAroundWindow;
+	if(window <= kPageSize)
+		co_return 0;
+
+	auto windowBegin = faultOffset & ~(window - 1);
+	auto windowEnd = frg::min(windowBegin + window, mapping->length);
+
+	size_t numMapped = 0;
+	for(auto progress = windowBegin; progress < windowEnd; progress += kPageSize) {
+		if(progress == faultOffset)
+			continue;
+
+		// Like touchVirtualPage(), lock the page in the view such that it cannot be
+		// evicted (or replaced) between peekRange() and the PTE update.
+		if(auto e = co_await mapping->view->asyncLockRange(
+				mapping->viewOffset + progress, kPageSize,
+				wq); e != Error::success)
+			assert(!"asyncLockRange() failed");
+
+		bool stop = false;
+		{
+			auto irqLock = frg::guard(&irqMutex());
+			auto spaceLock = frg::guard(&_mutex);
+
+			// Do not race with unmap(); it changes the state while holding _mutex.
+			if(mapping->state != MappingState::active) {
+				stop = true;
+			}else{
+				// Synchronize with the eviction loop.
+				auto evictLock = frg::guard(&mapping->evictMutex);
+
+				// The page might have been faulted in while we waited for the lock.
+				VirtualAddr vaddr = mapping->address + progress;
+				auto physicalRange = mapping->view->peekRange(mapping->viewOffset + progress);
+
+				// Only map pages that do not require any I/O or allocation.
+				if(!_ops->isMapped(vaddr) && physicalRange.get<0>() != PhysicalAddr(-1)) {
+					_ops->mapSingle4k(vaddr, physicalRange.get<0>(),
+							mapping->compilePageFlags(), physicalRange.get<1>());
+					_residuentSize += kPageSize;
+					numMapped++;
+				}
+			}
+		}
+
+		mapping->view->unlockRange(mapping->viewOffset + progress, kPageSize);
+		if(stop)
+			break;
+	}
+	if(numMapped)
+		logRss(this);
+
+	co_return numMapped;
+}
+
+static initgraph::Task parseFaultAroundTask{&basicInitEngine, "generic.parse-fault-around",
+	[] {
+		frg::string_view cmdline{kernelCommandLine->data(), kernelCommandLine->size()};
+		frg::string_view prefix{"fault-around="};
+
+		size_t i = 0;
+		while(i < cmdline.size()) {
+			while(i < cmdline.size() && cmdline[i] == ' ')
+				i++;
+			auto j = i;
+			while(j < cmdline.size() && cmdline[j] != ' ')
+				j++;
+
+			auto token = cmdline.sub_string(i, j - i);
+			i = j;
+			if(token.size() <= prefix.size()
+					|| token.sub_string(0, prefix.size()) != prefix)
+				continue;
+
+			size_t pages = 0;
+			for(size_t k = prefix.size(); k < token.size(); k++) {
+				if(token[k] < '0' || token[k] > '9') {
+					infoLogger() << "thor: Ignoring malformed fault-around= option" << frg::endlog;
+					return;
+				}
+				pages = pages * 10 + (token[k] - '0');
+			}
+
+			// The window must be a power of two; round down.
+			size_t window = kPageSize;
+			while(window * 2 <= pages * kPageSize && window * 2 <= kLargePageSize)
+				window *= 2;
+			faultAroundWindow = window;
+			infoLogger() << "thor: Fault-around window is " << (window / 1024)
+					<< " KiB" << frg::endlog;
+		}
+	}
+};
+
 smarter::shared_ptr<Mapping> VirtualSpace::_findMapping(VirtualAddr address) {
 	auto current = _mappings.get_root();
 	while(current) {
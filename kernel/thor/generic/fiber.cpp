@@ -63,12 +63,17 @@ void KernelFiber::unblockOther(FiberBlocker *blocker) {
 
 void KernelFiber::run(UniqueKernelStack stack,
 		void (*function)(void *), void *argument) {
+	runOn(localScheduler(), std::move(stack), function, argument);
+}
+
+void KernelFiber::runOn(Scheduler *scheduler, UniqueKernelStack stack,
+		void (*function)(void *), void *argument) {
 	AbiParameters params;
 	params.ip = (uintptr_t)function;
 	params.argument = (uintptr_t)argument;
 
 	auto fiber = frg::construct<KernelFiber>(*kernelAlloc, std::move(stack), params);
-	Scheduler::associate(fiber, localScheduler());
+	Scheduler::associate(fiber, scheduler);
 	Scheduler::resume(fiber);
 }
 
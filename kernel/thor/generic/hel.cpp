@@ -339,6 +339,11 @@ HelError helAllocateMemory(size_t size, uint32_t flags,
 				size, kPageSize);
 	}else if(flags & kHelAllocOnDemand) {
 		memory = smarter::allocate_shared<AllocatedMemory>(*kernelAlloc, size, effective.addressBits);
+	}else if(!(size & (kLargePageSize - 1))) {
+		// Back the memory by large chunks such that it can be mapped using large pages.
+		// Chunks fall back to 4 KiB pages if no large block is available.
+		memory = smarter::allocate_shared<AllocatedMemory>(*kernelAlloc, size, effective.addressBits,
+				kLargePageSize, kLargePageSize, true);
 	}else{
 		// TODO: 
 		memory = smarter::allocate_shared<AllocatedMemory>(*kernelAlloc, size, effective.addressBits);
@@ -423,6 +428,9 @@ HelError helCopyOnWrite(HelHandle memoryHandle,
 		view = wrapper->get<MemoryViewDescriptor>().memory;
 	}
 
+	if(view->isReadOnly())
+		return kHelErrIllegalArgs;
+
 	auto slice = smarter::allocate_shared<CopyOnWriteMemory>(*kernelAlloc, std::move(view),
 			offset, size);
 	{
@@ -498,6 +506,9 @@ HelError helAlterMemoryIndirection(HelHandle indirectHandle, size_t slot,
 		memoryView = memoryWrapper->get<MemoryViewDescriptor>().memory;
 	}
 
+	if(memoryView->isReadOnly())
+		return kHelErrIllegalArgs;
+
 	if(auto e = indirectView->setIndirection(slot, std::move(memoryView), offset, size);
 			e != Error::success) {
 		if(e == Error::illegalObject) {
@@ -594,6 +605,46 @@ HelError helCreateSpace(HelHandle *handle) {
 	return kHelErrNone;
 }
 
+HelError helForkSpace(HelHandle handle, HelHandle *forkedHandle) {
+	auto this_thread = getCurrentThread();
+	auto this_universe = this_thread->getUniverse();
+
+	smarter::shared_ptr<AddressSpace, BindableHandle> space;
+	{
+		auto irq_lock = frg::guard(&irqMutex());
+		Universe::Guard universe_guard(this_universe->lock);
+
+		auto spaceWrapper = this_universe->getDescriptor(universe_guard, handle);
+		if(!spaceWrapper)
+			return kHelErrNoDescriptor;
+		if(!spaceWrapper->is<AddressSpaceDescriptor>())
+			return kHelErrBadDescriptor;
+		space = spaceWrapper->get<AddressSpaceDescriptor>().space;
+	}
+
+	auto forkedSpace = AddressSpace::create();
+	auto error = Thread::asyncBlockCurrent(space->fork(forkedSpace.get()));
+
+	// Forking views and mapping them can fail for reasons that user space controls
+	// (e.g. read-only views) or on memory exhaustion.
+	if(error == Error::bufferTooSmall)
+		return kHelErrBufferTooSmall;
+	if(error == Error::noMemory)
+		return kHelErrNoMemory;
+	if(error != Error::success)
+		return kHelErrIllegalArgs;
+
+	{
+		auto irq_lock = frg::guard(&irqMutex());
+		Universe::Guard universe_guard(this_universe->lock);
+
+		*forkedHandle = this_universe->attachDescriptor(universe_guard,
+				AddressSpaceDescriptor(std::move(forkedSpace)));
+	}
+
+	return kHelErrNone;
+}
+
 HelError helCreateVirtualizedSpace(HelHandle *handle) {
 #ifdef __x86_64__
 	if(!getCpuData()->haveVirtualization) {
@@ -709,6 +760,8 @@ HelError helMapMemory(HelHandle memory_handle, HelHandle space_handle,
 
 	if(flags & kHelMapDontRequireBacking)
 		map_flags |= AddressSpace::kMapDontRequireBacking;
+	if(flags & kHelMapDontFork)
+		map_flags |= AddressSpace::kMapDontFork;
 
 	smarter::shared_ptr<MemorySlice> slice;
 	smarter::shared_ptr<AddressSpace, BindableHandle> space;
@@ -761,6 +814,8 @@ HelError helMapMemory(HelHandle memory_handle, HelHandle space_handle,
 	}
 
 	if(!mapResult) {
+		if(mapResult.error() == Error::illegalArgs)
+			return kHelErrIllegalArgs;
 		assert(mapResult.error() == Error::bufferTooSmall);
 		return kHelErrBufferTooSmall;
 	}
@@ -1192,6 +1247,8 @@ HelError helSubmitWriteMemory(HelHandle handle, uintptr_t address,
 
 	if(descriptor.is<MemoryViewDescriptor>()) {
 		auto view = descriptor.get<MemoryViewDescriptor>().memory;
+		if(view->isReadOnly())
+			return kHelErrIllegalArgs;
 		async::detach_with_allocator(*kernelAlloc, writeMemoryView(thisThread.lock(),
 				std::move(view), address, length, buffer, std::move(queue), context));
 	}else if(descriptor.is<AddressSpaceDescriptor>()) {
@@ -1908,6 +1965,21 @@ HelError helGetClock(uint64_t *counter) {
 	return kHelErrNone;
 }
 
+HelError helGetClockPage(HelHandle *handle) {
+	auto this_thread = getCurrentThread();
+	auto this_universe = this_thread->getUniverse();
+
+	{
+		auto irq_lock = frg::guard(&irqMutex());
+		Universe::Guard universe_guard(this_universe->lock);
+
+		*handle = this_universe->attachDescriptor(universe_guard,
+				MemoryViewDescriptor(clockPageMemory()));
+	}
+
+	return kHelErrNone;
+}
+
 HelError helSubmitAwaitClock(uint64_t counter, HelHandle queue_handle, uintptr_t context,
 		uint64_t *async_id) {
 	struct Closure final : CancelNode, PrecisionTimerNode, IpcNode {
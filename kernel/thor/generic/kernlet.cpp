@@ -34,10 +34,12 @@ KernletObject::KernletObject(void *entry,
 		const frg::vector<KernletParameterType, KernelAlloc> &bind_types)
 : _entry(entry), _bindDefns{*kernelAlloc}, _instanceSize{0} {
 	for(auto type : bind_types) {
+		// kernletcc assigns an 8-byte slot to each binding (see compileFafnir()).
+		// Offsets are zero-extended to 64 bits (see the BoundKernlet constructor).
 		if(type == KernletParameterType::offset) {
-			_instanceSize = (_instanceSize + 3) & ~size_t(3);
+			_instanceSize = (_instanceSize + 7) & ~size_t(7);
 			_bindDefns.push_back({type, _instanceSize});
-			_instanceSize += 4;
+			_instanceSize += 8;
 		}else if(type == KernletParameterType::memoryView) {
 			_instanceSize = (_instanceSize + 7) & ~size_t(7);
 			_bindDefns.push_back({type, _instanceSize});
@@ -71,6 +73,7 @@ const KernletParameterDefn &KernletObject::defnOfBindParameter(size_t index) {
 BoundKernlet::BoundKernlet(smarter::shared_ptr<KernletObject> object)
 : _object{std::move(object)} {
 	_instance = reinterpret_cast<char *>(kernelAlloc->allocate(_object->instanceSize()));
+	memset(_instance, 0, _object->instanceSize());
 }
 
 void BoundKernlet::setupOffsetBinding(size_t index, uint32_t offset) {
@@ -216,6 +219,16 @@ smarter::shared_ptr<KernletObject> processElfDso(const char *buffer,
 	// Perform relocations.
 	auto resolveExternal = [] (frg::string_view name) -> void * {
 #ifdef __x86_64__
+		uint8_t (*abi_pio_read8)(ptrdiff_t) =
+			[] (ptrdiff_t offset) -> uint8_t {
+				if(logIo)
+					infoLogger() << "__pio_read8 on offset: " << offset << frg::endlog;
+				auto value = arch::io_ops<uint8_t>::load(offset);
+				if(logIo)
+					infoLogger() << "    Read " << (unsigned int)value << frg::endlog;
+				return value;
+			};
+
 		uint16_t (*abi_pio_read16)(ptrdiff_t) =
 			[] (ptrdiff_t offset) -> uint16_t {
 				if(logIo)
@@ -280,7 +293,9 @@ smarter::shared_ptr<KernletObject> processElfDso(const char *buffer,
 			};
 
 #ifdef __x86_64__
-		if(name == "__pio_read16")
+		if(name == "__pio_read8")
+			return reinterpret_cast<void *>(abi_pio_read8);
+		else if(name == "__pio_read16")
 			return reinterpret_cast<void *>(abi_pio_read16);
 		else if(name == "__pio_write16")
 			return reinterpret_cast<void *>(abi_pio_write16);
@@ -0,0 +1,134 @@
+#include <string.h>
+#include <thor-internal/lz4.hpp>
+
+namespace thor {
+
+namespace {
+
+uint32_t readLe32(const char *p) {
+	auto b = reinterpret_cast<const uint8_t *>(p);
+	return uint32_t{b[0]} | (uint32_t{b[1]} << 8)
+			| (uint32_t{b[2]} << 16) | (uint32_t{b[3]} << 24);
+}
+
+} // anonymous namespace
+
+bool isLz4Frame(const char *p, size_t size) {
+	return size >= 4 && readLe32(p) == lz4FrameMagic;
+}
+
+frg::optional<Lz4FrameInfo> parseLz4Frame(const char *p, size_t size) {
+	if(size < 7 || !isLz4Frame(p, size))
+		return frg::null_opt;
+
+	auto flg = static_cast<uint8_t>(p[4]);
+	auto bd = static_cast<uint8_t>(p[5]);
+	if((flg >> 6) != 1) // Version must be 01.
+		return frg::null_opt;
+	if(flg & 1) // Dictionary IDs are not supported.
+		return frg::null_opt;
+
+	auto sizeCode = (bd >> 4) & 7;
+	if(sizeCode < 4)
+		return frg::null_opt;
+
+	Lz4FrameInfo info;
+	info.blockMaxSize = size_t{1} << (8 + 2 * sizeCode);
+	info.independentBlocks = flg & (1 << 5);
+	info.blockChecksums = flg & (1 << 4);
+	// Magic, FLG, BD, optional content size and the header checksum byte.
+	info.headerSize = 4 + 2 + ((flg & (1 << 3)) ? 8 : 0) + 1;
+	if(info.headerSize > size)
+		return frg::null_opt;
+	return info;
+}
+
+frg::optional<Lz4Block> nextLz4Block(const Lz4FrameInfo &info,
+		const char *&p, const char *limit) {
+	if(limit - p < 4)
+		return frg::null_opt;
+	auto word = readLe32(p);
+	if(!word)
+		return frg::null_opt;
+
+	Lz4Block block;
+	block.data = p + 4;
+	block.size = word & 0x7FFF'FFFF;
+	block.compressed = !(word & 0x8000'0000);
+
+	size_t trailer = info.blockChecksums ? 4 : 0;
+	if(static_cast<size_t>(limit - block.data) < block.size + trailer)
+		return frg::null_opt;
+	if(block.size > info.blockMaxSize)
+		return frg::null_opt;
+	p = block.data + block.size + trailer;
+	return block;
+}
+
+frg::optional<size_t> lz4DecompressBlock(const char *in, size_t inSize,
+		char *dest, size_t destSize, size_t prefixSize) {
+	auto ip = reinterpret_cast<const uint8_t *>(in);
+	auto iend = ip + inSize;
+	auto op = dest;
+	auto oend = dest + destSize;
+
+	// Reads the extension bytes of a literal or match length.
+	auto readLength = [&] (size_t &length) -> bool {
+		uint8_t b;
+		do {
+			if(ip == iend)
+				return false;
+			b = *ip++;
+			length += b;
+		} while(b == 255);
+		return true;
+	};
+
+	while(true) {
+		if(ip == iend)
+			return frg::null_opt;
+		auto token = *ip++;
+
+		size_t literals = token >> 4;
+		if(literals == 15 && !readLength(literals))
+			return frg::null_opt;
+		if(static_cast<size_t>(iend - ip) < literals
+				|| static_cast<size_t>(oend - op) < literals)
+			return frg::null_opt;
+		memcpy(op, ip, literals);
+		ip += literals;
+		op += literals;
+
+		// The last sequence consists of literals only.
+		if(ip == iend)
+			break;
+
+		if(iend - ip < 2)
+			return frg::null_opt;
+		size_t offset = ip[0] | (size_t{ip[1]} << 8);
+		ip += 2;
+		if(!offset || offset > static_cast<size_t>(op - dest) + prefixSize)
+			return frg::null_opt;
+
+		size_t length = token & 15;
+		if(length == 15 && !readLength(length))
+			return frg::null_opt;
+		length += 4;
+		if(static_cast<size_t>(oend - op) < length)
+			return frg::null_opt;
+
+		// Matches may overlap the output; copy byte-wise in that case.
+		auto match = op - offset;
+		if(offset >= length) {
+			memcpy(op, match, length);
+			op += length;
+		}else{
+			for(size_t i = 0; i < length; i++)
+				*op++ = *match++;
+		}
+	}
+
+	return op - dest;
+}
+
+} // namespace thor
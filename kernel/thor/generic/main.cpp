@@ -1,4 +1,6 @@
 #include <algorithm>
+#include <atomic>
+#include <async/oneshot-event.hpp>
 #include <eir/interface.hpp>
 #include <frg/string.hpp>
 #include <elf.h>
@@ -10,6 +12,7 @@
 #include <thor-internal/irq.hpp>
 #include <thor-internal/kerncfg.hpp>
 #include <thor-internal/kernlet.hpp>
+#include <thor-internal/lz4.hpp>
 #include <thor-internal/main.hpp>
 #include <thor-internal/module.hpp>
 #include <thor-internal/pci/pci.hpp>
@@ -17,6 +20,7 @@
 #include <thor-internal/profile.hpp>
 #include <thor-internal/random.hpp>
 #include <thor-internal/servers.hpp>
+#include <thor-internal/timer.hpp>
 
 namespace thor {
 
@@ -110,6 +114,73 @@ initgraph::Stage *getTaskingAvailableStage() {
 	return &s;
 }
 
+// Decompresses an LZ4-compressed initrd into a buffer allocated from kernelAlloc.
+// If the frame uses independent blocks, the blocks are decompressed on all CPUs in parallel.
+static size_t decompressInitrd(const char *data, size_t size, char *&image) {
+	auto info = parseLz4Frame(data, size);
+	if(!info)
+		panicLogger() << "thor: initrd uses an unsupported LZ4 frame format" << frg::endlog;
+
+	frg::vector<Lz4Block, KernelAlloc> blocks{*kernelAlloc};
+	auto p = data + info->headerSize;
+	while(auto block = nextLz4Block(*info, p, data + size))
+		blocks.push(*block);
+	if(blocks.empty())
+		panicLogger() << "thor: initrd LZ4 frame contains no blocks" << frg::endlog;
+
+	// Every block but the last one decompresses to exactly blockMaxSize bytes.
+	// Hence, the output position of each block is known in advance.
+	image = static_cast<char *>(kernelAlloc->allocate(blocks.size() * info->blockMaxSize));
+	frg::vector<size_t, KernelAlloc> outputSizes{*kernelAlloc};
+	outputSizes.resize(blocks.size());
+
+	auto decompressBlock = [&] (size_t i) {
+		auto &block = blocks[i];
+		auto dest = image + i * info->blockMaxSize;
+		if(!block.compressed) {
+			memcpy(dest, block.data, block.size);
+			outputSizes[i] = block.size;
+			return;
+		}
+		auto prefixSize = info->independentBlocks ? 0 : i * info->blockMaxSize;
+		auto n = lz4DecompressBlock(block.data, block.size,
+				dest, info->blockMaxSize, prefixSize);
+		if(!n)
+			panicLogger() << "thor: initrd LZ4 block " << i << " is corrupted" << frg::endlog;
+		outputSizes[i] = *n;
+	};
+
+	int numWorkers = info->independentBlocks ? getCpuCount() : 1;
+	if(numWorkers > 1) {
+		std::atomic<size_t> nextBlock{0};
+		std::atomic<int> activeWorkers{numWorkers};
+		async::oneshot_event doneEvent;
+
+		auto work = [&] {
+			size_t i;
+			while((i = nextBlock.fetch_add(1, std::memory_order_relaxed)) < blocks.size())
+				decompressBlock(i);
+			if(activeWorkers.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				doneEvent.raise();
+		};
+		for(int cpu = 0; cpu < numWorkers; cpu++)
+			KernelFiber::runOn(&getCpuData(cpu)->scheduler, work);
+		KernelFiber::asyncBlockCurrent(doneEvent.wait());
+	}else{
+		for(size_t i = 0; i < blocks.size(); i++)
+			decompressBlock(i);
+	}
+
+	for(size_t i = 0; i + 1 < blocks.size(); i++)
+		if(outputSizes[i] != info->blockMaxSize)
+			panicLogger() << "thor: initrd LZ4 block " << i << " is truncated" << frg::endlog;
+
+	if(logInitialization)
+		infoLogger() << "thor: Decompressed " << blocks.size() << " initrd blocks using "
+				<< numWorkers << " CPUs" << frg::endlog;
+	return (blocks.size() - 1) * info->blockMaxSize + outputSizes.back();
+}
+
 extern "C" void thorMain() {
 	kernelCommandLine.initialize(*kernelAlloc,
 			reinterpret_cast<const char *>(thorBootInfoPtr->commandLine));
@@ -150,12 +221,26 @@ extern "C" void thorMain() {
 
 		mfsRoot = frg::construct<MfsDirectory>(*kernelAlloc);
 		{
+			auto startNanos = systemClockSource()->currentNanos();
+
 			assert(modules[0].physicalBase % kPageSize == 0);
-			assert(modules[0].length <= 0x1000000);
-			auto base = static_cast<const char *>(KernelVirtualMemory::global().allocate(0x1000000));
+			auto moduleSize = (modules[0].length + (kPageSize - 1)) & ~size_t{kPageSize - 1};
+			// The mapping is writable since we clear the bytes past EOF of files
+			// that are mapped in place (see below).
+			auto moduleBase = static_cast<char *>(KernelVirtualMemory::global().allocate(moduleSize));
 			for(size_t pg = 0; pg < modules[0].length; pg += kPageSize)
-				KernelPageSpace::global().mapSingle4k(reinterpret_cast<VirtualAddr>(base) + pg,
-						modules[0].physicalBase + pg, 0, CachingMode::null);
+				KernelPageSpace::global().mapSingle4k(reinterpret_cast<VirtualAddr>(moduleBase) + pg,
+						modules[0].physicalBase + pg, page_access::write, CachingMode::null);
+
+			// Compressed images are decompressed into kernel heap memory; files
+			// are always copied out of that buffer and it is freed afterwards.
+			char *base = moduleBase;
+			size_t length = modules[0].length;
+			bool compressed = false;
+			if(isLz4Frame(moduleBase, modules[0].length)) {
+				length = decompressInitrd(moduleBase, modules[0].length, base);
+				compressed = true;
+			}
 
 			struct Header {
 				char magic[6];
@@ -198,9 +283,28 @@ extern "C" void thorMain() {
 				return v;
 			};
 
+			// Files whose data starts on a page boundary are exposed directly
+			// as HardwareMemory over the module's pages. The remainder of their last page
+			// belongs to the following CPIO entries; we zero it once p has moved past it.
+			size_t mappedBytes = 0;
+			size_t copiedBytes = 0;
+			char *tailBegin = nullptr;
+			char *tailEnd = nullptr;
+
+			auto flushTail = [&] {
+				if(!tailBegin)
+					return;
+				memset(tailBegin, 0, tailEnd - tailBegin);
+				tailBegin = nullptr;
+				tailEnd = nullptr;
+			};
+
 			auto p = base;
-			auto limit = base + modules[0].length;
+			auto limit = base + length;
 			while(true) {
+				if(tailBegin && p >= tailEnd)
+					flushTail();
+
 				Header header;
 				assert(p + sizeof(Header) <= limit);
 				memcpy(&header, p, sizeof(Header));
@@ -245,10 +349,27 @@ extern "C" void thorMain() {
 	//				if(logInitialization)
 						infoLogger() << "thor: initrd file " << path << frg::endlog;
 
-					auto memory = smarter::allocate_shared<AllocatedMemory>(*kernelAlloc,
-							(file_size + (kPageSize - 1)) & ~size_t{kPageSize - 1});
-					KernelFiber::asyncBlockCurrent(copyToView(memory.get(), 0, data, file_size,
-							thisFiber()->associatedWorkQueue()->take()));
+					auto physical = modules[0].physicalBase + (data - base);
+					auto pagedSize = (file_size + (kPageSize - 1)) & ~size_t{kPageSize - 1};
+					smarter::shared_ptr<MemoryView> memory;
+					if(!compressed && !(physical & (kPageSize - 1)) && data + pagedSize <= limit) {
+						// All entries before data have been consumed already.
+						flushTail();
+						if(file_size != pagedSize) {
+							tailBegin = data + file_size;
+							tailEnd = data + pagedSize;
+						}
+						memory = smarter::allocate_shared<HardwareMemory>(*kernelAlloc,
+								physical, pagedSize, CachingMode::null);
+						mappedBytes += file_size;
+					}else{
+						auto copy = smarter::allocate_shared<AllocatedMemory>(*kernelAlloc,
+								pagedSize);
+						KernelFiber::asyncBlockCurrent(copyToView(copy.get(), 0, data, file_size,
+								thisFiber()->associatedWorkQueue()->take()));
+						memory = std::move(copy);
+						copiedBytes += file_size;
+					}
 
 					auto name = frg::string<KernelAlloc>{*kernelAlloc,
 							path.sub_string(it - path.data(), end - it)};
@@ -258,6 +379,18 @@ extern "C" void thorMain() {
 
 				p = data + ((file_size + 3) & ~uint32_t{3});
 			}
+			flushTail();
+
+			if(compressed)
+				kernelAlloc->free(base);
+
+			infoLogger() << "thor: initrd files: " << (mappedBytes >> 10)
+					<< " KiB mapped in place, " << (copiedBytes >> 10)
+					<< " KiB copied" << frg::endlog;
+			infoLogger() << "thor: Loaded " << (compressed ? "LZ4-compressed" : "uncompressed")
+					<< " initrd (" << (modules[0].length >> 10) << " KiB) in "
+					<< (systemClockSource()->currentNanos() - startNanos) / 1000
+					<< " us" << frg::endlog;
 		}
 
 		if(logInitialization)
@@ -270,10 +403,16 @@ extern "C" void thorMain() {
 		infoLogger() << "thor: Launching user space." << frg::endlog;
 		KernelFiber::asyncBlockCurrent(runMbus());
 		initializeKernletCtl();
-		KernelFiber::asyncBlockCurrent(runServer("sbin/kernletcc"));
-		KernelFiber::asyncBlockCurrent(runServer("sbin/clocktracker"));
-		KernelFiber::asyncBlockCurrent(runServer("sbin/posix-subsystem"));
-		KernelFiber::asyncBlockCurrent(runServer("sbin/virtio-console"));
+
+		// All of these servers find each other through mbus; dependencies only need to
+		// be declared if a server cannot make progress before another one is running.
+		static const BootServer bootServers[] = {
+			{"sbin/kernletcc", {}},
+			{"sbin/clocktracker", {}},
+			{"sbin/posix-subsystem", {"sbin/clocktracker"}},
+			{"sbin/virtio-console", {}},
+		};
+		launchBootServers(bootServers, sizeof(bootServers) / sizeof(BootServer));
 	});
 
 	infoLogger() << "thor: Entering initilization fiber." << frg::endlog;
@@ -667,6 +806,11 @@ void handleSyscall(SyscallImageAccessor image) {
 		*image.error() = helCreateSpace(&handle);
 		*image.out0() = handle;
 	} break;
+	case kHelCallForkSpace: {
+		HelHandle forkedHandle;
+		*image.error() = helForkSpace((HelHandle)arg0, &forkedHandle);
+		*image.out0() = forkedHandle;
+	} break;
 	case kHelCallMapMemory: {
 		void *actual_pointer;
 		*image.error() = helMapMemory((HelHandle)arg0, (HelHandle)arg1,
@@ -784,6 +928,11 @@ void handleSyscall(SyscallImageAccessor image) {
 		*image.error() = helGetClock(&counter);
 		*image.out0() = counter;
 	} break;
+	case kHelCallGetClockPage: {
+		HelHandle handle;
+		*image.error() = helGetClockPage(&handle);
+		*image.out0() = handle;
+	} break;
 	case kHelCallSubmitAwaitClock: {
 		uint64_t async_id;
 		*image.error() = helSubmitAwaitClock((uint64_t)arg0,
@@ -255,6 +255,11 @@ void HardwareMemory::markDirty(uintptr_t, size_t) {
 	// We never evict memory, there is no need to track dirty pages.
 }
 
+bool HardwareMemory::providesLargePage(uintptr_t) {
+	// Hardware memory is contiguous; callers still need to check the physical alignment.
+	return true;
+}
+
 size_t HardwareMemory::getLength() {
 	return _length;
 }
@@ -264,9 +269,10 @@ size_t HardwareMemory::getLength() {
 // --------------------------------------------------------
 
 AllocatedMemory::AllocatedMemory(size_t desiredLngth,
-		int addressBits, size_t desiredChunkSize, size_t chunkAlign)
-: _physicalChunks{*kernelAlloc},
-		_addressBits{addressBits}, _chunkAlign{chunkAlign} {
+		int addressBits, size_t desiredChunkSize, size_t chunkAlign, bool fallbackToPages)
+: _physicalChunks{*kernelAlloc}, _chunkPages{*kernelAlloc},
+		_addressBits{addressBits}, _chunkAlign{chunkAlign},
+		_fallbackToPages{fallbackToPages} {
 	static_assert(sizeof(unsigned long) == sizeof(uint64_t), "Fix use of __builtin_clzl");
 	_chunkSize = size_t(1) << (64 - __builtin_clzl(desiredChunkSize - 1));
 	if(_chunkSize != desiredChunkSize)
@@ -283,6 +289,7 @@ AllocatedMemory::AllocatedMemory(size_t desiredLngth,
 	assert(_chunkAlign % kPageSize == 0);
 	assert(_chunkSize % _chunkAlign == 0);
 	_physicalChunks.resize(length / _chunkSize, PhysicalAddr(-1));
+	_chunkPages.resize(length / _chunkSize, nullptr);
 }
 
 AllocatedMemory::~AllocatedMemory() {
@@ -294,6 +301,14 @@ AllocatedMemory::~AllocatedMemory() {
 	for(size_t i = 0; i < _physicalChunks.size(); ++i) {
 		if(_physicalChunks[i] != PhysicalAddr(-1))
 			physicalAllocator->free(_physicalChunks[i], _chunkSize);
+		if(_chunkPages[i]) {
+			for(size_t j = 0; j < _chunkSize / kPageSize; ++j) {
+				if(_chunkPages[i][j] != PhysicalAddr(-1))
+					physicalAllocator->free(_chunkPages[i][j], kPageSize);
+			}
+			kernelAlloc->deallocate(_chunkPages[i],
+					(_chunkSize / kPageSize) * sizeof(PhysicalAddr));
+		}
 	}
 	if(logUsage)
 		infoLogger() << "thor:     ("
@@ -304,10 +319,11 @@ void AllocatedMemory::resize(size_t newSize, async::any_receiver<void> receiver)
 	auto irq_lock = frg::guard(&irqMutex());
 	auto lock = frg::guard(&_mutex);
 
-	assert(!(newSize % _chunkSize));
-	size_t num_chunks = newSize / _chunkSize;
+	// Like the constructor, round up to the chunk size (which can exceed kPageSize).
+	size_t num_chunks = (newSize + (_chunkSize - 1)) / _chunkSize;
 	assert(num_chunks >= _physicalChunks.size());
 	_physicalChunks.resize(num_chunks, PhysicalAddr(-1));
+	_chunkPages.resize(num_chunks, nullptr);
 	receiver.set_value();
 }
 
@@ -334,6 +350,13 @@ frg::tuple<PhysicalAddr, CachingMode> AllocatedMemory::peekRange(uintptr_t offse
 	auto disp = offset & (_chunkSize - 1);
 	assert(index < _physicalChunks.size());
 
+	if(_chunkPages[index]) {
+		auto page = _chunkPages[index][disp / kPageSize];
+		if(page == PhysicalAddr(-1))
+			return frg::tuple<PhysicalAddr, CachingMode>{PhysicalAddr(-1), CachingMode::null};
+		return frg::tuple<PhysicalAddr, CachingMode>{page, CachingMode::null};
+	}
+
 	if(_physicalChunks[index] == PhysicalAddr(-1))
 		return frg::tuple<PhysicalAddr, CachingMode>{PhysicalAddr(-1), CachingMode::null};
 	return frg::tuple<PhysicalAddr, CachingMode>{_physicalChunks[index] + disp,
@@ -349,16 +372,42 @@ bool AllocatedMemory::fetchRange(uintptr_t offset,
 	auto disp = offset & (_chunkSize - 1);
 	assert(index < _physicalChunks.size());
 
-	if(_physicalChunks[index] == PhysicalAddr(-1)) {
+	if(_physicalChunks[index] == PhysicalAddr(-1) && !_chunkPages[index]) {
 		auto physical = physicalAllocator->allocate(_chunkSize, _addressBits);
-		assert(physical != PhysicalAddr(-1) && "OOM");
-		assert(!(physical & (_chunkAlign - 1)));
+		if(physical != PhysicalAddr(-1)) {
+			assert(!(physical & (_chunkAlign - 1)));
+
+			for(size_t pg_progress = 0; pg_progress < _chunkSize; pg_progress += kPageSize) {
+				PageAccessor accessor{physical + pg_progress};
+				memset(accessor.get(), 0, kPageSize);
+			}
+			_physicalChunks[index] = physical;
+		}else{
+			// Physical memory can be too fragmented to allocate a large chunk.
+			assert(_fallbackToPages && "OOM");
+			auto numPages = _chunkSize / kPageSize;
+			auto pages = static_cast<PhysicalAddr *>(
+					kernelAlloc->allocate(numPages * sizeof(PhysicalAddr)));
+			for(size_t j = 0; j < numPages; ++j)
+				pages[j] = PhysicalAddr(-1);
+			_chunkPages[index] = pages;
+		}
+	}
 
-		for(size_t pg_progress = 0; pg_progress < _chunkSize; pg_progress += kPageSize) {
-			PageAccessor accessor{physical + pg_progress};
+	if(_chunkPages[index]) {
+		auto &page = _chunkPages[index][disp / kPageSize];
+		if(page == PhysicalAddr(-1)) {
+			auto physical = physicalAllocator->allocate(kPageSize, _addressBits);
+			assert(physical != PhysicalAddr(-1) && "OOM");
+			PageAccessor accessor{physical};
 			memset(accessor.get(), 0, kPageSize);
+			page = physical;
 		}
-		_physicalChunks[index] = physical;
+
+		auto pageDisp = disp & (kPageSize - 1);
+		completeFetch(node, Error::success,
+				page + pageDisp, kPageSize - pageDisp, CachingMode::null);
+		return true;
 	}
 
 	assert(_physicalChunks[index] != PhysicalAddr(-1));
@@ -371,6 +420,19 @@ void AllocatedMemory::markDirty(uintptr_t offset, size_t size) {
 	// Do nothing for now.
 }
 
+bool AllocatedMemory::providesLargePage(uintptr_t offset) {
+	if(_chunkSize < kLargePageSize)
+		return false;
+
+	auto irq_lock = frg::guard(&irqMutex());
+	auto lock = frg::guard(&_mutex);
+
+	// Chunks are naturally aligned since they come from the buddy allocator.
+	auto index = offset / _chunkSize;
+	assert(index < _physicalChunks.size());
+	return !_chunkPages[index];
+}
+
 size_t AllocatedMemory::getLength() {
 	auto irq_lock = frg::guard(&irqMutex());
 	auto lock = frg::guard(&_mutex);
@@ -1090,6 +1152,9 @@ CopyOnWriteMemory::CopyOnWriteMemory(smarter::shared_ptr<MemoryView> view,
 	assert(length);
 	assert(!(offset & (kPageSize - 1)));
 	assert(!(length & (kPageSize - 1)));
+
+	if(_copyChain)
+		_copyChain->_numUsers.fetch_add(1, std::memory_order_relaxed);
 }
 
 CopyOnWriteMemory::~CopyOnWriteMemory() {
@@ -1098,6 +1163,9 @@ CopyOnWriteMemory::~CopyOnWriteMemory() {
 		assert(it->physical != PhysicalAddr(-1));
 		physicalAllocator->free(it->physical, kPageSize);
 	}
+
+	if(_copyChain)
+		_copyChain->_numUsers.fetch_sub(1, std::memory_order_relaxed);
 }
 
 size_t CopyOnWriteMemory::getLength() {
@@ -1117,19 +1185,32 @@ void CopyOnWriteMemory::fork(async::any_receiver<frg::tuple<Error, smarter::shar
 		auto irqLock = frg::guard(&irqMutex());
 		auto lock = frg::guard(&_mutex);
 
+		_collapseChain();
+
 		// Create a new CowChain for both the original and the forked mapping.
 		// To correct handle locks pages, we move only non-locked pages from
 		// the original mapping to the new chain.
-		auto newChain = smarter::allocate_shared<CowChain>(*kernelAlloc, _copyChain);
+		// If we are the only user of our current chain, there is no need for a new
+		// chain: we can move our pages to the current chain directly.
+		smarter::shared_ptr<CowChain> newChain;
+		if(_copyChain && _copyChain->_numUsers.load(std::memory_order_relaxed) == 1) {
+			newChain = _copyChain;
+		}else{
+			newChain = smarter::allocate_shared<CowChain>(*kernelAlloc, _copyChain);
 
-		// Update the original mapping
-		_copyChain = newChain;
+			// Update the original mapping
+			if(_copyChain)
+				_copyChain->_numUsers.fetch_sub(1, std::memory_order_relaxed);
+			_copyChain = newChain;
+			_copyChain->_numUsers.fetch_add(1, std::memory_order_relaxed);
+		}
 
 		// Create a new mapping in the forked space.
 		forked = smarter::allocate_shared<CopyOnWriteMemory>(*kernelAlloc,
 				_view, _viewOffset, _length, newChain);
 
 		// Finally, inspect all copied pages owned by the original mapping.
+		auto chainLock = frg::guard(&newChain->_mutex);
 		for(size_t pg = 0; pg < _length; pg += kPageSize) {
 			auto osIt = _ownedPages.find(pg >> kPageShift);
 
@@ -1156,10 +1237,16 @@ void CopyOnWriteMemory::fork(async::any_receiver<frg::tuple<Error, smarter::shar
 				auto physical = osIt->physical;
 				assert(physical != PhysicalAddr(-1));
 
-				// Update the chains.
+				// Update the chains. If we reuse our chain, our copy shadows
+				// the page in the chain, hence the latter can be freed.
 				auto pageOffset = _viewOffset + pg;
-				auto newIt = newChain->_pages.insert(pageOffset >> kPageShift,
-						PhysicalAddr(-1));
+				auto newIt = newChain->_pages.find(pageOffset >> kPageShift);
+				if(newIt) {
+					physicalAllocator->free(newIt->load(std::memory_order_relaxed), kPageSize);
+				}else{
+					newIt = newChain->_pages.insert(pageOffset >> kPageShift,
+							PhysicalAddr(-1));
+				}
 				_ownedPages.erase(pg >> kPageShift);
 				newIt->store(physical, std::memory_order_relaxed);
 			}
@@ -1191,7 +1278,6 @@ bool CopyOnWriteMemory::asyncLockRange(uintptr_t offset, size_t size,
 		while(progress < size) {
 			auto offset = overallOffset + progress;
 
-			smarter::shared_ptr<CowChain> chain;
 			smarter::shared_ptr<MemoryView> view;
 			uintptr_t viewOffset;
 			CowPage *cowIt;
@@ -1214,7 +1300,6 @@ bool CopyOnWriteMemory::asyncLockRange(uintptr_t offset, size_t size,
 						waitForCopy = true;
 					}
 				}else{
-					chain = self->_copyChain;
 					view = self->_view;
 					viewOffset = self->_viewOffset;
 
@@ -1257,24 +1342,8 @@ bool CopyOnWriteMemory::asyncLockRange(uintptr_t offset, size_t size,
 
 			// Try to copy from a descendant CoW chain.
 			auto pageOffset = viewOffset + offset;
-			while(chain) {
-				auto irqLock = frg::guard(&irqMutex());
-				auto lock = frg::guard(&chain->_mutex);
-
-				if(auto it = chain->_pages.find(pageOffset >> kPageShift); it) {
-					// We can just copy synchronously here -- the descendant is not evicted.
-					auto srcPhysical = it->load(std::memory_order_relaxed);
-					assert(srcPhysical != PhysicalAddr(-1));
-					auto srcAccessor = PageAccessor{srcPhysical};
-					memcpy(accessor.get(), srcAccessor.get(), kPageSize);
-					break;
-				}
-
-				chain = chain->_superChain;
-			}
-
-			// Copy from the root view.
-			if(!chain) {
+			if(!self->_copyFromChain(pageOffset, accessor.get())) {
+				// Copy from the root view.
 				co_await copyFromView(view.get(), pageOffset & ~(kPageSize - 1),
 						accessor.get(), kPageSize, wq);
 			}
@@ -1331,7 +1400,6 @@ bool CopyOnWriteMemory::fetchRange(uintptr_t offset,
 		smarter::shared_ptr<WorkQueue> wq, FetchNode *node) {
 	async::detach_with_allocator(*kernelAlloc, [] (CopyOnWriteMemory *self, uintptr_t offset,
 			smarter::shared_ptr<WorkQueue> wq, FetchNode *node) -> coroutine<void> {
-		smarter::shared_ptr<CowChain> chain;
 		smarter::shared_ptr<MemoryView> view;
 		uintptr_t viewOffset;
 		CowPage *cowIt;
@@ -1354,7 +1422,6 @@ bool CopyOnWriteMemory::fetchRange(uintptr_t offset,
 					waitForCopy = true;
 				}
 			}else{
-				chain = self->_copyChain;
 				view = self->_view;
 				viewOffset = self->_viewOffset;
 
@@ -1391,24 +1458,8 @@ bool CopyOnWriteMemory::fetchRange(uintptr_t offset,
 
 		// Try to copy from a descendant CoW chain.
 		auto pageOffset = viewOffset + offset;
-		while(chain) {
-			auto irqLock = frg::guard(&irqMutex());
-			auto lock = frg::guard(&chain->_mutex);
-
-			if(auto it = chain->_pages.find(pageOffset >> kPageShift); it) {
-				// We can just copy synchronously here -- the descendant is not evicted.
-				auto srcPhysical = it->load(std::memory_order_relaxed);
-				assert(srcPhysical != PhysicalAddr(-1));
-				auto srcAccessor = PageAccessor{srcPhysical};
-				memcpy(accessor.get(), srcAccessor.get(), kPageSize);
-				break;
-			}
-
-			chain = chain->_superChain;
-		}
-
-		// Copy from the root view.
-		if(!chain) {
+		if(!self->_copyFromChain(pageOffset, accessor.get())) {
+			// Copy from the root view.
 			co_await copyFromView(view.get(), pageOffset & ~(kPageSize - 1),
 					accessor.get(), kPageSize, wq);
 		}
@@ -1432,6 +1483,97 @@ bool CopyOnWriteMemory::fetchRange(uintptr_t offset,
 	return false;
 }
 
+void CopyOnWriteMemory::_collapseChain() {
+	auto chain = _copyChain;
+	while(chain) {
+		smarter::shared_ptr<CowChain> next;
+		{
+			auto chainLock = frg::guard(&chain->_mutex);
+
+			auto superChain = chain->_superChain;
+			if(!superChain)
+				break;
+
+			if(superChain->_numUsers.load(std::memory_order_relaxed) != 1) {
+				next = std::move(superChain);
+			}else{
+				// Nobody else can reach the super chain's pages, hence we can move them
+				// down to our chain. Pages that are shadowed by our chain are unreachable.
+				auto superLock = frg::guard(&superChain->_mutex);
+
+				for(size_t pg = 0; pg < _length; pg += kPageSize) {
+					auto pageIndex = (_viewOffset + pg) >> kPageShift;
+					auto superIt = superChain->_pages.find(pageIndex);
+					if(!superIt)
+						continue;
+					auto physical = superIt->load(std::memory_order_relaxed);
+					assert(physical != PhysicalAddr(-1));
+
+					if(chain->_pages.find(pageIndex)) {
+						physicalAllocator->free(physical, kPageSize);
+					}else{
+						auto it = chain->_pages.insert(pageIndex, PhysicalAddr(-1));
+						it->store(physical, std::memory_order_relaxed);
+					}
+					superChain->_pages.erase(pageIndex);
+				}
+
+				// Concurrent walkers that already reached the super chain restart their walk.
+				superChain->_collapsed = true;
+				chain->_superChain = std::move(superChain->_superChain);
+				superChain->_numUsers.fetch_sub(1, std::memory_order_relaxed);
+				continue;
+			}
+		}
+		chain = std::move(next);
+	}
+}
+
+bool CopyOnWriteMemory::_copyFromChain(uintptr_t pageOffset, void *buffer) {
+	smarter::shared_ptr<CowChain> chain;
+	{
+		auto irqLock = frg::guard(&irqMutex());
+		auto lock = frg::guard(&_mutex);
+
+		chain = _copyChain;
+	}
+
+	while(chain) {
+		bool collapsed;
+		smarter::shared_ptr<CowChain> superChain;
+		{
+			auto irqLock = frg::guard(&irqMutex());
+			auto lock = frg::guard(&chain->_mutex);
+
+			collapsed = chain->_collapsed;
+			if(!collapsed) {
+				if(auto it = chain->_pages.find(pageOffset >> kPageShift); it) {
+					// We can just copy synchronously here -- the descendant is not evicted.
+					auto srcPhysical = it->load(std::memory_order_relaxed);
+					assert(srcPhysical != PhysicalAddr(-1));
+					auto srcAccessor = PageAccessor{srcPhysical};
+					memcpy(buffer, srcAccessor.get(), kPageSize);
+					return true;
+				}
+
+				superChain = chain->_superChain;
+			}
+		}
+
+		if(collapsed) {
+			// The pages of this chain were moved to one of its descendants.
+			auto irqLock = frg::guard(&irqMutex());
+			auto lock = frg::guard(&_mutex);
+
+			chain = _copyChain;
+		}else{
+			chain = std::move(superChain);
+		}
+	}
+
+	return false;
+}
+
 void CopyOnWriteMemory::markDirty(uintptr_t, size_t) {
 	// We do not need to track dirty pages.
 }
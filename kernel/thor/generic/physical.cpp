@@ -1,5 +1,7 @@
 #include <assert.h>
+#include <string.h>
 #include <thor-internal/arch/paging.hpp>
+#include <thor-internal/core.hpp>
 #include <thor-internal/debug.hpp>
 #include <thor-internal/kernel-locks.hpp>
 #include <thor-internal/physical.hpp>
@@ -35,7 +37,7 @@ PhysicalChunkAllocator::PhysicalChunkAllocator() {
 }
 
 void PhysicalChunkAllocator::bootstrapRegion(PhysicalAddr address,
-		int order, size_t numRoots, int8_t *buddyTree) {
+		int order, size_t numRoots, int8_t *buddyTree, int numaNode) {
 	if(_numRegions >= 8) {
 		infoLogger() << "thor: Ignoring memory region (can only handle 8 regions)"
 				<< frg::endlog;
@@ -45,24 +47,16 @@ void PhysicalChunkAllocator::bootstrapRegion(PhysicalAddr address,
 	int n = _numRegions++;
 	_allRegions[n].physicalBase = address;
 	_allRegions[n].regionSize = numRoots << (order + kPageShift);
+	_allRegions[n].numaNode = numaNode;
 	_allRegions[n].buddyAccessor = BuddyAccessor{address, kPageShift,
 			buddyTree, numRoots, order};
 
-	auto currentTotal = _totalPages.load(std::memory_order_relaxed);
-	auto currentFree = _freePages.load(std::memory_order_relaxed);
-	_totalPages.store(currentTotal + (numRoots << order), std::memory_order_relaxed);
-	_freePages.store(currentFree + (numRoots << order), std::memory_order_relaxed);
+	_totalPages.fetch_add(numRoots << order, std::memory_order_relaxed);
+	_freePages.fetch_add(numRoots << order, std::memory_order_relaxed);
 }
 
 PhysicalAddr PhysicalChunkAllocator::allocate(size_t size, int addressBits) {
 	auto irq_lock = frg::guard(&irqMutex());
-	auto lock = frg::guard(&_mutex);
-
-	auto currentFree = _freePages.load(std::memory_order_relaxed);
-	auto currentUsed = _usedPages.load(std::memory_order_relaxed);
-	assert(currentFree > size / kPageSize);
-	_freePages.store(currentFree - size / kPageSize, std::memory_order_relaxed);
-	_usedPages.store(currentUsed + size / kPageSize, std::memory_order_relaxed);
 
 	// TODO: This could be solved better.
 	int target = 0;
@@ -73,29 +67,82 @@ PhysicalAddr PhysicalChunkAllocator::allocate(size_t size, int addressBits) {
 	if(logPhysicalAllocs)
 		infoLogger() << "thor: Allocating physical memory of order "
 					<< (target + kPageShift) << frg::endlog;
-	for(int i = 0; i < _numRegions; i++) {
-		if(target > _allRegions[i].buddyAccessor.tableOrder())
-			continue;
 
-		auto physical = _allRegions[i].buddyAccessor.allocate(target, addressBits);
+	PhysicalAddr physical;
+	auto cache = &getCpuData()->pageCache;
+	if(!target && addressBits >= 64) {
+		// Fast path: serve single pages from the per-CPU cache.
+		if(!cache->numPages) {
+			auto lock = frg::guard(&_mutex);
+			_refillCache(cache);
+		}
+		if(!cache->numPages)
+			return static_cast<PhysicalAddr>(-1);
+		physical = cache->pages[--cache->numPages];
+	}else{
+		auto lock = frg::guard(&_mutex);
+		physical = _allocateFromRegions(target, addressBits, cache->numaNode);
 		if(physical == BuddyAccessor::illegalAddress)
-			continue;
-	//	infoLogger() << "Allocate " << (void *)physical << frg::endlog;
-		assert(!(physical % (size_t(kPageSize) << target)));
-		return physical;
+			return static_cast<PhysicalAddr>(-1);
 	}
+	assert(!(physical % (size_t(kPageSize) << target)));
 
-	return static_cast<PhysicalAddr>(-1);
+	auto previousFree = _freePages.fetch_sub(size / kPageSize, std::memory_order_relaxed);
+	assert(previousFree >= size / kPageSize);
+	(void)previousFree;
+	_usedPages.fetch_add(size / kPageSize, std::memory_order_relaxed);
+	return physical;
 }
 
 void PhysicalChunkAllocator::free(PhysicalAddr address, size_t size) {
 	auto irq_lock = frg::guard(&irqMutex());
-	auto lock = frg::guard(&_mutex);
 	
 	int target = 0;
 	while(size > (size_t(kPageSize) << target))
 		target++;
 
+	auto previousUsed = _usedPages.fetch_sub(size / kPageSize, std::memory_order_relaxed);
+	assert(previousUsed >= size / kPageSize);
+	(void)previousUsed;
+	_freePages.fetch_add(size / kPageSize, std::memory_order_relaxed);
+
+	if(!target) {
+		// Fast path: return single pages to the per-CPU cache.
+		auto cache = &getCpuData()->pageCache;
+		if(cache->numPages == PhysicalPageCache::capacity) {
+			auto lock = frg::guard(&_mutex);
+			_drainCache(cache, PhysicalPageCache::batchSize);
+		}
+		cache->pages[cache->numPages++] = address;
+		return;
+	}
+
+	auto lock = frg::guard(&_mutex);
+	_freeToRegions(address, target);
+}
+
+PhysicalAddr PhysicalChunkAllocator::_allocateFromRegions(int target, int addressBits,
+		int numaNode) {
+	// Prefer regions that are local to the requesting CPU; fall back to all other regions.
+	for(int pass = 0; pass < 2; pass++) {
+		for(int i = 0; i < _numRegions; i++) {
+			if((_allRegions[i].numaNode == numaNode) != !pass)
+				continue;
+			if(target > _allRegions[i].buddyAccessor.tableOrder())
+				continue;
+
+			auto physical = _allRegions[i].buddyAccessor.allocate(target, addressBits);
+			if(physical == BuddyAccessor::illegalAddress)
+				continue;
+			return physical;
+		}
+	}
+
+	return BuddyAccessor::illegalAddress;
+}
+
+void PhysicalChunkAllocator::_freeToRegions(PhysicalAddr address, int target) {
+	size_t size = size_t(kPageSize) << target;
 	for(int i = 0; i < _numRegions; i++) {
 		if(address < _allRegions[i].physicalBase)
 			continue;
@@ -103,15 +150,29 @@ void PhysicalChunkAllocator::free(PhysicalAddr address, size_t size) {
 			continue;
 
 		_allRegions[i].buddyAccessor.free(address, target);
-		auto currentFree = _freePages.load(std::memory_order_relaxed);
-		auto currentUsed = _usedPages.load(std::memory_order_relaxed);
-		assert(currentUsed > size / kPageSize);
-		_freePages.store(currentFree + size / kPageSize, std::memory_order_relaxed);
-		_usedPages.store(currentUsed - size / kPageSize, std::memory_order_relaxed);
 		return;
 	}
 
 	assert(!"Physical page is not part of any region");
 }
 
+void PhysicalChunkAllocator::_refillCache(PhysicalPageCache *cache) {
+	while(cache->numPages < PhysicalPageCache::batchSize) {
+		auto physical = _allocateFromRegions(0, 64, cache->numaNode);
+		if(physical == BuddyAccessor::illegalAddress)
+			break;
+		cache->pages[cache->numPages++] = physical;
+	}
+}
+
+void PhysicalChunkAllocator::_drainCache(PhysicalPageCache *cache, size_t count) {
+	assert(count <= cache->numPages);
+	// Drain the least recently freed pages; recently freed pages are more likely to be cache-hot.
+	for(size_t i = 0; i < count; i++)
+		_freeToRegions(cache->pages[i], 0);
+	memmove(cache->pages, cache->pages + count,
+			(cache->numPages - count) * sizeof(PhysicalAddr));
+	cache->numPages -= count;
+}
+
 } // namespace thor
@@ -11,6 +11,10 @@ namespace thor {
 bool wantKernelProfile = false;
 frg::manual_box<LogRingBuffer> globalProfileRing;
 
+namespace {
+	bool haveGlobalProfileRing = false;
+}
+
 void initializeProfile() {
 #ifdef __x86_64__
 	if(!wantKernelProfile)
@@ -25,9 +29,26 @@ void initializeProfile() {
 
 	void *profileMemory = kernelAlloc->allocate(1 << 20);
 	globalProfileRing.initialize(reinterpret_cast<uintptr_t>(profileMemory), 1 << 20);
+	haveGlobalProfileRing = true;
+
+	initializeLocalProfile();
+#endif
+}
+
+void initializeLocalProfile() {
+#ifdef __x86_64__
+	if(!wantKernelProfile || !haveGlobalProfileRing)
+		return;
+
+	if(!(getCpuData()->profileFlags & PlatformCpuData::profileIntelSupported)
+			&& !(getCpuData()->profileFlags & PlatformCpuData::profileAmdSupported)) {
+		infoLogger() << "\e[31m" "thor: CPU #" << getCpuData()->cpuIndex
+				<< " does not support kernel profiling" "\e[39m" << frg::endlog;
+		return;
+	}
 
 	// Dump the per-CPU profiling data to the global ring buffer.
-	// TODO: Start one such fiber per CPU.
+	// KernelFiber::run() associates the fiber with the current CPU.
 	KernelFiber::run([=] {
 		getCpuData()->localProfileRing = frg::construct<SingleContextRecordRing>(*kernelAlloc);
 
@@ -43,20 +64,27 @@ void initializeProfile() {
 			setAmdPmc();
 		}
 
+		// Records are drained in batches; each batch is copied to the global ring at once.
+		constexpr size_t batchRecords = 64;
+		ProfileRecord batch[batchRecords];
+
 		uint64_t deqPtr = 0;
 		while(true) {
-			char buffer[128];
-			auto [success, newPtr, size] = getCpuData()->localProfileRing->dequeueAt(
-					deqPtr, buffer, 128);
-			deqPtr = newPtr;
-			if(!success) {
-				KernelFiber::asyncBlockCurrent(generalTimerEngine()->sleepFor(1'000'000));
-				continue;
+			size_t n = 0;
+			while(n < batchRecords) {
+				auto [success, newPtr, size] = getCpuData()->localProfileRing->dequeueAt(
+						deqPtr, &batch[n], sizeof(ProfileRecord));
+				if(!success)
+					break;
+				deqPtr = newPtr;
+				assert(size == sizeof(ProfileRecord));
+				n++;
 			}
-			assert(size);
-			assert(size < 128);
-			for(size_t i = 0; i < size; ++i)
-				globalProfileRing->enqueue(buffer[i]);
+
+			if(n)
+				globalProfileRing->enqueueBulk(batch, n * sizeof(ProfileRecord));
+			if(n < batchRecords)
+				KernelFiber::asyncBlockCurrent(generalTimerEngine()->sleepFor(1'000'000));
 		}
 	});
 #endif
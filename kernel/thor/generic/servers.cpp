@@ -1,4 +1,6 @@
 #include <algorithm>
+#include <atomic>
+#include <async/oneshot-event.hpp>
 #include <frg/hash_map.hpp>
 #include <frg/string.hpp>
 #include <elf.h>
@@ -8,6 +10,7 @@
 #include <thor-internal/fiber.hpp>
 #include <thor-internal/module.hpp>
 #include <thor-internal/stream.hpp>
+#include <thor-internal/timer.hpp>
 #include "mbus.frigg_pb.hpp"
 #include "svrctl.frigg_pb.hpp"
 
@@ -31,6 +34,9 @@ static frg::manual_box<
 	>
 > allServers;
 
+// Protects allServers; servers can be launched concurrently from multiple CPUs.
+static frg::ticket_spinlock allServersMutex;
+
 // TODO: move this declaration to a header file
 void runService(frg::string<KernelAlloc> desc, LaneHandle control_lane,
 		smarter::shared_ptr<Thread, ActiveHandle> thread);
@@ -374,10 +380,15 @@ coroutine<void> runMbus() {
 		infoLogger() << "thor: Launching mbus" << frg::endlog;
 
 	frg::string<KernelAlloc> nameStr{*kernelAlloc, "/sbin/mbus"};
-	assert(!allServers->get(nameStr));
 
 	auto controlStream = createStream();
-	allServers->insert(nameStr, controlStream.get<1>());
+	{
+		auto irqLock = frg::guard(&irqMutex());
+		auto lock = frg::guard(&allServersMutex);
+
+		assert(!allServers->get(nameStr));
+		allServers->insert(nameStr, controlStream.get<1>());
+	}
 
 	auto module = resolveModule("/sbin/mbus");
 	assert(module && module->type == MfsType::regular);
@@ -391,20 +402,24 @@ coroutine<LaneHandle> runServer(frg::string_view name) {
 		infoLogger() << "thor: Launching server " << name << frg::endlog;
 
 	frg::string<KernelAlloc> nameStr{*kernelAlloc, name.data(), name.size()};
-	if(auto server = allServers->get(nameStr); server) {
-		if(debugLaunch)
-			infoLogger() << "thor: Server "
-					<< name << " is already running" << frg::endlog;
-		co_return *server;
-	}
-
 	auto module = resolveModule(name);
 	if(!module)
 		panicLogger() << "thor: Could not find module " << name << frg::endlog;
 	assert(module->type == MfsType::regular);
 
 	auto controlStream = createStream();
-	allServers->insert(nameStr, controlStream.get<1>());
+	{
+		auto irqLock = frg::guard(&irqMutex());
+		auto lock = frg::guard(&allServersMutex);
+
+		if(auto server = allServers->get(nameStr); server) {
+			if(debugLaunch)
+				infoLogger() << "thor: Server "
+						<< name << " is already running" << frg::endlog;
+			co_return *server;
+		}
+		allServers->insert(nameStr, controlStream.get<1>());
+	}
 
 	co_await executeModule(name, static_cast<MfsRegular *>(module),
 			controlStream.get<0>(),
@@ -413,6 +428,72 @@ coroutine<LaneHandle> runServer(frg::string_view name) {
 	co_return controlStream.get<1>();
 }
 
+void launchBootServers(const BootServer *servers, size_t numServers) {
+	struct LaunchState {
+		async::oneshot_event launched;
+		uint64_t startNanos = 0;
+		uint64_t endNanos = 0;
+		// Dependency that was launched last, i.e., the one on the critical path.
+		int criticalDependency = -1;
+	};
+
+	auto findServer = [&] (const char *name) -> int {
+		frg::string_view view{name};
+		for(size_t i = 0; i < numServers; i++)
+			if(frg::string_view{servers[i].name} == view)
+				return i;
+		panicLogger() << "thor: Unknown boot server dependency " << name << frg::endlog;
+		__builtin_unreachable();
+	};
+
+	frg::vector<LaunchState, KernelAlloc> states{*kernelAlloc};
+	states.resize(numServers);
+	std::atomic<size_t> numPending{numServers};
+	async::oneshot_event allLaunched;
+	auto bootNanos = systemClockSource()->currentNanos();
+
+	// Distribute the launches over all CPUs. runServer() associates the new server's
+	// thread with the scheduler of the CPU that launches it.
+	for(size_t i = 0; i < numServers; i++) {
+		auto launch = [&, i] {
+			auto &state = states[i];
+			for(auto dependency : servers[i].dependencies) {
+				if(!dependency)
+					continue;
+				auto d = findServer(dependency);
+				KernelFiber::asyncBlockCurrent(states[d].launched.wait());
+				if(state.criticalDependency < 0
+						|| states[d].endNanos > states[state.criticalDependency].endNanos)
+					state.criticalDependency = d;
+			}
+
+			state.startNanos = systemClockSource()->currentNanos();
+			KernelFiber::asyncBlockCurrent(runServer(servers[i].name));
+			state.endNanos = systemClockSource()->currentNanos();
+			state.launched.raise();
+
+			if(numPending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				allLaunched.raise();
+		};
+		KernelFiber::runOn(&getCpuData(i % getCpuCount())->scheduler, launch);
+	}
+	KernelFiber::asyncBlockCurrent(allLaunched.wait());
+
+	// Print a boot trace and walk back the critical path from the last launch.
+	size_t last = 0;
+	for(size_t i = 0; i < numServers; i++) {
+		infoLogger() << "thor: Boot server " << servers[i].name << " launched from "
+				<< (states[i].startNanos - bootNanos) / 1000 << " us to "
+				<< (states[i].endNanos - bootNanos) / 1000 << " us" << frg::endlog;
+		if(states[i].endNanos > states[last].endNanos)
+			last = i;
+	}
+	for(int i = last; i >= 0; i = states[i].criticalDependency)
+		infoLogger() << "thor: Critical path: " << servers[i].name
+				<< " (" << (states[i].endNanos - states[i].startNanos) / 1000 << " us)"
+				<< frg::endlog;
+}
+
 // ------------------------------------------------------------------------
 // svrctl interface to user space.
 // ------------------------------------------------------------------------
@@ -22,6 +22,14 @@ struct VirtualOperations {
 	virtual PageStatus cleanSingle4k(VirtualAddr pointer) = 0;
 	virtual bool isMapped(VirtualAddr pointer) = 0;
 
+	// Support for large pages is optional. By default, callers fall back to 4 KiB pages.
+	virtual bool mapSingle2m(VirtualAddr, PhysicalAddr, uint32_t, CachingMode) {
+		return false;
+	}
+	virtual PageStatus unmapSingle2m(VirtualAddr) {
+		return 0;
+	}
+
 	// ----------------------------------------------------------------------------------
 	// Sender boilerplate for retire()
 	// ----------------------------------------------------------------------------------
@@ -153,7 +161,8 @@ enum MappingFlags : uint32_t {
 	protWrite = 0x20,
 	protExecute = 0x40,
 
-	dontRequireBacking = 0x100
+	dontRequireBacking = 0x100,
+	dontFork = 0x200
 };
 
 struct TouchVirtualResult {
@@ -516,6 +525,7 @@ public:
 		kMapProtExecute = 0x20,
 		kMapPopulate = 0x200,
 		kMapDontRequireBacking = 0x400,
+		kMapDontFork = 0x800,
 	};
 
 	enum FaultFlags : uint32_t {
@@ -550,6 +560,11 @@ public:
 		return _residuentSize;
 	}
 
+	// Maps all mappings of this space (except for those with kMapDontFork)
+	// into forkedSpace at the same addresses. Views that support fork() (i.e.,
+	// copy-on-write views) are forked, all other views are shared.
+	coroutine<Error> fork(VirtualSpace *forkedSpace);
+
 	// ----------------------------------------------------------------------------------
 	// Sender boilerplate for map()
 	// ----------------------------------------------------------------------------------
@@ -851,6 +866,11 @@ private:
 
 	smarter::shared_ptr<Mapping> _findMapping(VirtualAddr address);
 
+	// Maps pages around a faulting page that are already present in the mapping's view.
+	// Returns the number of pages that were mapped.
+	coroutine<size_t> _faultAround(Mapping *mapping, uintptr_t faultOffset,
+			smarter::shared_ptr<WorkQueue> wq);
+
 	// Splits some memory range from a hole mapping.
 	void _splitHole(Hole *hole, VirtualAddr offset, VirtualAddr length);
 
@@ -899,6 +919,15 @@ struct AddressSpace : VirtualSpace, smarter::crtp_counter<AddressSpace, Bindable
 			return space_->pageSpace_.isMapped(pointer);
 		}
 
+		bool mapSingle2m(VirtualAddr pointer, PhysicalAddr physical,
+				uint32_t flags, CachingMode cachingMode) override {
+			return space_->pageSpace_.mapSingle2m(pointer, physical, true, flags, cachingMode);
+		}
+
+		PageStatus unmapSingle2m(VirtualAddr pointer) override {
+			return space_->pageSpace_.unmapSingle2m(pointer);
+		}
+
 	private:
 		AddressSpace *space_;
 	};
@@ -5,6 +5,7 @@
 #include <frg/variant.hpp>
 #include <thor-internal/arch/cpu.hpp>
 #include <thor-internal/error.hpp>
+#include <thor-internal/physical.hpp>
 #include <thor-internal/ring-buffer.hpp>
 #include <thor-internal/schedule.hpp>
 
@@ -26,6 +27,7 @@ struct IoSpace;
 
 struct WorkQueue;
 struct KernelFiber;
+struct PrecisionTimerEngine;
 
 // TODO: For now, this class is empty but it will be required for QST.
 struct ExecutorContext {
@@ -57,10 +59,14 @@ struct CpuData : public PlatformCpuData {
 
 	int cpuIndex;
 
+	PhysicalPageCache pageCache;
+
 	ExecutorContext *executorContext;
 	KernelFiber *activeFiber;
 	smarter::shared_ptr<WorkQueue> generalWorkQueue;
 	std::atomic<uint64_t> heartbeat;
+	// Set up by the architecture code once the local alarm is usable.
+	PrecisionTimerEngine *timerEngine = nullptr;
 
 	unsigned int irqEntropySeq = 0;
 	std::atomic<ProfileMechanism> profileMechanism{};
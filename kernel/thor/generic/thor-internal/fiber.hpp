@@ -97,6 +97,19 @@ public:
 		run(std::move(stack), frame, target);
 	}
 
+	// Like run() but schedules the fiber on the given (possibly remote) scheduler.
+	template<typename F>
+	static void runOn(Scheduler *scheduler, F functor) {
+		auto frame = [] (void *argument) {
+			auto object = reinterpret_cast<F *>(argument);
+			(*object)();
+			exitCurrent();
+		};
+		auto stack = UniqueKernelStack::make();
+		auto target = stack.embed<F>(functor);
+		runOn(scheduler, std::move(stack), frame, target);
+	}
+
 	template<typename F>
 	static KernelFiber *post(F functor) {
 		auto frame = [] (void *argument) {
@@ -110,6 +123,8 @@ public:
 	}
 
 	static void run(UniqueKernelStack stack, void (*function)(void *), void *argument);
+	static void runOn(Scheduler *scheduler, UniqueKernelStack stack,
+			void (*function)(void *), void *argument);
 	static KernelFiber *post(UniqueKernelStack stack, void (*function)(void *), void *argument);
 
 	explicit KernelFiber(UniqueKernelStack stack, AbiParameters abi);
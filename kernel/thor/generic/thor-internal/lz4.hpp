@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <frg/optional.hpp>
+
+namespace thor {
+
+inline constexpr uint32_t lz4FrameMagic = 0x184D2204;
+
+struct Lz4FrameInfo {
+	// Size of the decompressed data of every block but the last one.
+	size_t blockMaxSize;
+	bool independentBlocks;
+	bool blockChecksums;
+	// Offset of the first block header within the frame.
+	size_t headerSize;
+};
+
+struct Lz4Block {
+	const char *data;
+	size_t size;
+	bool compressed;
+};
+
+bool isLz4Frame(const char *p, size_t size);
+
+// Parses the frame descriptor. Returns an empty optional if the frame is malformed
+// or uses features that we do not support (e.g., dictionaries).
+frg::optional<Lz4FrameInfo> parseLz4Frame(const char *p, size_t size);
+
+// Returns the block at p and advances p past it (including its checksum).
+// Returns an empty optional on the end mark or if the block exceeds limit.
+frg::optional<Lz4Block> nextLz4Block(const Lz4FrameInfo &info,
+		const char *&p, const char *limit);
+
+// Decompresses a single LZ4 block into dest. Matches may reference up to
+// prefixSize bytes before dest (for frames with dependent blocks).
+// Returns the number of bytes written or an empty optional on malformed input.
+frg::optional<size_t> lz4DecompressBlock(const char *in, size_t inSize,
+		char *dest, size_t destSize, size_t prefixSize = 0);
+
+} // namespace thor
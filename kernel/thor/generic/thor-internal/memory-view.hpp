@@ -341,6 +341,23 @@ public:
 	// Marks a range of pages as dirty.
 	virtual void markDirty(uintptr_t offset, size_t size) = 0;
 
+	// Returns true if the kLargePageSize-aligned block at offset is backed
+	// by physically contiguous memory once it is fetched.
+	// Such views neither track dirty pages nor evict memory.
+	virtual bool providesLargePage(uintptr_t offset) {
+		return false;
+	}
+
+	// Read-only views can neither be mapped writable nor be modified
+	// (or wrapped into other views) by user space.
+	void setReadOnly() {
+		readOnly_ = true;
+	}
+
+	bool isReadOnly() {
+		return readOnly_;
+	}
+
 	virtual void submitManage(ManageNode *handle);
 
 	// TODO: InitiateLoad does more or less the same as fetchRange(). Remove it.
@@ -694,6 +711,7 @@ public:
 
 private:
 	EvictionQueue *associatedEvictionQueue_;
+	bool readOnly_ = false;
 };
 
 struct SliceRange {
@@ -935,6 +953,7 @@ struct HardwareMemory final : MemoryView {
 	frg::tuple<PhysicalAddr, CachingMode> peekRange(uintptr_t offset) override;
 	bool fetchRange(uintptr_t offset, smarter::shared_ptr<WorkQueue> wq, FetchNode *node) override;
 	void markDirty(uintptr_t offset, size_t size) override;
+	bool providesLargePage(uintptr_t offset) override;
 
 private:
 	PhysicalAddr _base;
@@ -943,8 +962,11 @@ private:
 };
 
 struct AllocatedMemory final : MemoryView {
+	// If fallbackToPages is true, chunks for which no physically contiguous memory
+	// is available are backed by individual pages instead.
 	AllocatedMemory(size_t length, int addressBits = 64,
-			size_t chunkSize = kPageSize, size_t chunkAlign = kPageSize);
+			size_t chunkSize = kPageSize, size_t chunkAlign = kPageSize,
+			bool fallbackToPages = false);
 	AllocatedMemory(const AllocatedMemory &) = delete;
 	~AllocatedMemory();
 
@@ -958,13 +980,17 @@ struct AllocatedMemory final : MemoryView {
 	frg::tuple<PhysicalAddr, CachingMode> peekRange(uintptr_t offset) override;
 	bool fetchRange(uintptr_t offset, smarter::shared_ptr<WorkQueue> wq, FetchNode *node) override;
 	void markDirty(uintptr_t offset, size_t size) override;
+	bool providesLargePage(uintptr_t offset) override;
 
 private:
 	frg::ticket_spinlock _mutex;
 
 	frg::vector<PhysicalAddr, KernelAlloc> _physicalChunks;
+	// For chunks that are backed by individual pages: array of per-page addresses.
+	frg::vector<PhysicalAddr *, KernelAlloc> _chunkPages;
 	int _addressBits;
 	size_t _chunkSize, _chunkAlign;
+	bool _fallbackToPages;
 };
 
 struct ManagedSpace : CacheBundle {
@@ -1134,6 +1160,13 @@ struct CowChain {
 
 	smarter::shared_ptr<CowChain> _superChain;
 	frg::rcu_radixtree<std::atomic<PhysicalAddr>, KernelAlloc> _pages;
+
+	// Number of CowChains and CopyOnWriteMemory objects that refer to this chain.
+	std::atomic<unsigned int> _numUsers{0};
+
+	// Set once the pages of this chain were merged into its (only) descendant.
+	// Protected by _mutex.
+	bool _collapsed = false;
 };
 
 struct CopyOnWriteMemory final : MemoryView /*, MemoryObserver */ {
@@ -1159,6 +1192,13 @@ public:
 	void markDirty(uintptr_t offset, size_t size) override;
 
 private:
+	// Merges chains that are only referenced by their descendant into that descendant.
+	// Must be called with _mutex held.
+	void _collapseChain();
+
+	// Copies a page from the CoW chain. Returns false if the page is not part of the chain.
+	bool _copyFromChain(uintptr_t pageOffset, void *buffer);
+
 	enum class CowState {
 		null,
 		inProgress,
@@ -25,13 +25,28 @@ public:
 	void *access(PhysicalAddr physical);
 };
 
+// Per-CPU cache of free 4 KiB pages.
+// Single page allocations are served from this cache without taking the global lock;
+// the cache is refilled from (and drained to) the buddy allocator in batches.
+// Must only be accessed by the owning CPU with IRQs disabled.
+struct PhysicalPageCache {
+	static constexpr size_t capacity = 64;
+	static constexpr size_t batchSize = 32;
+
+	// NUMA node that this CPU belongs to. Refills prefer regions of this node.
+	int numaNode = 0;
+
+	size_t numPages = 0;
+	PhysicalAddr pages[capacity];
+};
+
 class PhysicalChunkAllocator {
 	typedef frg::ticket_spinlock Mutex;
 public:
 	PhysicalChunkAllocator();
 	
 	void bootstrapRegion(PhysicalAddr address,
-			int order, size_t numRoots, int8_t *buddyTree);
+			int order, size_t numRoots, int8_t *buddyTree, int numaNode = 0);
 
 	PhysicalAddr allocate(size_t size, int addressBits = 64);
 	void free(PhysicalAddr address, size_t size);
@@ -47,11 +62,19 @@ public:
 	}
 
 private:
+	// Both of the following functions expect _mutex to be held.
+	PhysicalAddr _allocateFromRegions(int target, int addressBits, int numaNode);
+	void _freeToRegions(PhysicalAddr address, int target);
+
+	void _refillCache(PhysicalPageCache *cache);
+	void _drainCache(PhysicalPageCache *cache, size_t count);
+
 	Mutex _mutex;
 
 	struct Region {
 		PhysicalAddr physicalBase;
 		PhysicalAddr regionSize;
+		int numaNode;
 		BuddyAccessor buddyAccessor;
 	};
 
@@ -1,12 +1,34 @@
 #pragma once
 
+#include <stdint.h>
 #include <thor-internal/ring-buffer.hpp>
 
 namespace thor {
 
 extern bool wantKernelProfile;
 
+// Format of the records in the global profile ring.
+// Keep this in sync with tools/analyze-profile.py.
+struct ProfileRecord {
+	uint64_t ip;
+	// Opaque identifiers of the active thread and its universe (zero if unknown).
+	uint64_t thread;
+	uint64_t universe;
+	uint32_t cpu;
+	uint32_t flags;
+};
+
+static_assert(sizeof(ProfileRecord) == 32, "Bad sizeof(ProfileRecord)");
+
+namespace profile_flags {
+	static constexpr uint32_t kernel = 1;
+}
+
+// Sets up the global profile ring and starts profiling on the current CPU.
 void initializeProfile();
+// Starts profiling on the current CPU. Called on all CPUs after initializeProfile().
+void initializeLocalProfile();
+
 LogRingBuffer *getGlobalProfileRing();
 
 } // namespace thor
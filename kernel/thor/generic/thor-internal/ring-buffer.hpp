@@ -23,6 +23,29 @@ struct LogRingBuffer {
 		enqueue_++;
 	}
 
+	// Enqueues multiple bytes at once. The bytes are not interleaved with other enqueues.
+	void enqueueBulk(const void *data, size_t size) {
+		auto irqLock = frg::guard(&thor::irqMutex());
+		auto lock = frg::guard(&mutex_);
+		auto p = reinterpret_cast<const char *>(data);
+		size_t i = 0;
+		while (i < size) {
+			size_t writeSize = frg::min(
+				size_ - ((enqueue_ + i) & (size_ - 1)),
+				size - i
+			);
+
+			memcpy(
+				stor_ + ((enqueue_ + i) & (size_ - 1)),
+				p + i,
+				writeSize
+			);
+
+			i += writeSize;
+		}
+		enqueue_ += size;
+	}
+
 	frg::tuple<uint64_t, size_t>
 	dequeueInto(void *buffer, size_t dequeue, size_t size) {
 		auto irqLock = frg::guard(&thor::irqMutex());
@@ -9,4 +9,15 @@ void initializeMbusStream();
 coroutine<void> runMbus();
 coroutine<LaneHandle> runServer(frg::string_view name);
 
+// A server that is launched during boot, together with the servers that
+// need to be running before it can be launched.
+struct BootServer {
+	const char *name;
+	const char *dependencies[2];
+};
+
+// Launches all servers concurrently, subject to their dependencies. Blocks the
+// current fiber until all servers are running and logs a trace of the launch.
+void launchBootServers(const BootServer *servers, size_t numServers);
+
 } // namespace thor
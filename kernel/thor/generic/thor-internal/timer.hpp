@@ -8,11 +8,13 @@
 #include <frg/intrusive.hpp>
 #include <frg/pairing_heap.hpp>
 #include <frg/spinlock.hpp>
+#include <smarter.hpp>
 #include <thor-internal/cancel.hpp>
 #include <thor-internal/work-queue.hpp>
 
 namespace thor {
 
+struct MemoryView;
 struct PrecisionTimerEngine;
 
 struct ClockSource {
@@ -21,6 +23,13 @@ struct ClockSource {
 
 ClockSource *systemClockSource();
 
+// Returns the page that exports the clock parameters to user space (see helGetClockPage()).
+smarter::shared_ptr<MemoryView> clockPageMemory();
+
+// Called by the architecture code if systemClockSource() is an invariant TSC,
+// i.e., if user space can compute the clock as TSC * 1'000'000 / tscTicksPerMilli.
+void publishTscClock(uint64_t tscTicksPerMilli);
+
 struct AlarmSink {
 	virtual void firedAlarm() = 0;
 };
@@ -87,6 +96,7 @@ struct PrecisionTimerNode {
 	}
 
 	frg::pairing_heap_hook<PrecisionTimerNode> hook;
+	frg::default_list_hook<PrecisionTimerNode> wheelHook;
 
 private:
 	uint64_t _deadline;
@@ -98,6 +108,8 @@ private:
 
 	TimerState _state = TimerState::none;
 	bool _wasCancelled = false;
+	// Index of the wheel bucket (level * wheelSlots + slot) or -1 if the timer is in the heap.
+	int _wheelBucket = -1;
 	async::cancellation_observer<CancelFunctor> _cancelCb;
 };
 
@@ -107,12 +119,28 @@ struct CompareTimer {
 	}
 };
 
+// Each CPU has its own timer engine (see generalTimerEngine()).
+// Timers that expire soon are kept in a pairing heap. Timers that expire further
+// in the future are kept in a hierarchical timer wheel; this makes inserting and
+// cancelling them O(1), which matters since most long timeouts are cancelled.
+// Wheel buckets are emptied into the heap (or into a lower wheel level) when
+// the start of the bucket's time range is reached, hence timers still fire precisely.
 struct PrecisionTimerEngine : private AlarmSink {
 	friend struct PrecisionTimerNode;
 
 private:
 	using Mutex = frg::ticket_spinlock;
 
+	static constexpr int wheelLevels = 4;
+	static constexpr int wheelSlots = 64;
+	static constexpr int wheelSlotShift = 6;
+	// Level 0 buckets span 2^20 ns (~1 ms); each further level is 64 times coarser.
+	static constexpr int wheelBaseShift = 20;
+
+	static constexpr int levelShift(int level) {
+		return wheelBaseShift + level * wheelSlotShift;
+	}
+
 public:
 	PrecisionTimerEngine(ClockSource *clock, AlarmTracker *alarm);
 	
@@ -187,11 +215,34 @@ private:
 private:
 	void _progress();
 
+	// Inserts the timer either into the heap or into the wheel.
+	void _enqueue(PrecisionTimerNode *timer);
+
+	// Moves all wheel buckets that start at or before current.
+	void _advanceWheel(uint64_t current);
+
+	// Returns the start of the earliest non-empty wheel bucket (or 0 if the wheel is empty).
+	uint64_t _nextWheelDeadline();
+
 	ClockSource *_clock;
 	AlarmTracker *_alarm;
 
 	Mutex _mutex;
 
+	using WheelList = frg::intrusive_list<
+		PrecisionTimerNode,
+		frg::locate_member<
+			PrecisionTimerNode,
+			frg::default_list_hook<PrecisionTimerNode>,
+			&PrecisionTimerNode::wheelHook
+		>
+	>;
+
+	// Time up to which the wheel was advanced.
+	uint64_t _wheelTime = 0;
+	uint64_t _wheelMasks[wheelLevels] = {};
+	WheelList _wheel[wheelLevels][wheelSlots];
+
 	frg::pairing_heap<
 		PrecisionTimerNode,
 		frg::locate_member<
@@ -209,6 +260,8 @@ inline void PrecisionTimerNode::CancelFunctor::operator() () {
 	node_->_engine->cancelTimer(node_);
 }
 
+// Returns the timer engine of the current CPU (or a global engine on architectures
+// that do not have per-CPU alarms). Engines can be used from any CPU.
 PrecisionTimerEngine *generalTimerEngine();
 
 bool haveTimer();
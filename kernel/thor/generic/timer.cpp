@@ -1,6 +1,11 @@
+#include <bit>
+
+#include <thor-internal/core.hpp>
 #include <thor-internal/debug.hpp>
 #include <thor-internal/kernel-locks.hpp>
+#include <thor-internal/memory-view.hpp>
 #include <thor-internal/timer.hpp>
+#include "../../hel/include/hel.h"
 
 namespace thor {
 
@@ -38,9 +43,10 @@ void PrecisionTimerEngine::installTimer(PrecisionTimerNode *timer) {
 		return;
 	}
 
-	_timerQueue.push(timer);
 	_activeTimers++;
 	timer->_state = TimerState::queued;
+	_advanceWheel(_clock->currentNanos());
+	_enqueue(timer);
 
 	_progress();
 }
@@ -50,7 +56,17 @@ void PrecisionTimerEngine::cancelTimer(PrecisionTimerNode *timer) {
 	auto lock = frg::guard(&_mutex);
 
 	if(timer->_state == TimerState::queued) {
-		_timerQueue.remove(timer);
+		if(timer->_wheelBucket >= 0) {
+			auto level = timer->_wheelBucket / wheelSlots;
+			auto slot = timer->_wheelBucket % wheelSlots;
+			auto &bucket = _wheel[level][slot];
+			bucket.erase(bucket.iterator_to(timer));
+			if(bucket.empty())
+				_wheelMasks[level] &= ~(uint64_t{1} << slot);
+			timer->_wheelBucket = -1;
+		}else{
+			_timerQueue.remove(timer);
+		}
 		_activeTimers--;
 		timer->_wasCancelled = true;
 	}else{
@@ -61,6 +77,81 @@ void PrecisionTimerEngine::cancelTimer(PrecisionTimerNode *timer) {
 	WorkQueue::post(timer->_elapsed);
 }
 
+void PrecisionTimerEngine::_enqueue(PrecisionTimerNode *timer) {
+	// Timers that expire within the next two level 0 buckets go to the heap directly.
+	auto deadline = timer->_deadline;
+	if((deadline >> wheelBaseShift) < (_wheelTime >> wheelBaseShift) + 2) {
+		_timerQueue.push(timer);
+		return;
+	}
+
+	// Find the finest level that covers the deadline.
+	int level = 0;
+	while(level < wheelLevels - 1
+			&& (deadline >> levelShift(level)) - (_wheelTime >> levelShift(level)) >= wheelSlots)
+		level++;
+
+	// Timers beyond the wheel's horizon are put into the last bucket; they will be
+	// re-enqueued once that bucket is reached.
+	auto tick = deadline >> levelShift(level);
+	auto base = _wheelTime >> levelShift(level);
+	if(tick - base >= wheelSlots)
+		tick = base + wheelSlots - 1;
+
+	auto slot = static_cast<int>(tick & (wheelSlots - 1));
+	_wheel[level][slot].push_back(timer);
+	_wheelMasks[level] |= uint64_t{1} << slot;
+	timer->_wheelBucket = level * wheelSlots + slot;
+}
+
+void PrecisionTimerEngine::_advanceWheel(uint64_t current) {
+	if(current < _wheelTime)
+		return;
+
+	// Buckets of all levels are unique within [_wheelTime, _wheelTime + 64 buckets).
+	// Move out everything that starts before current, then advance _wheelTime.
+	WheelList expired;
+	for(int level = 0; level < wheelLevels; level++) {
+		auto base = _wheelTime >> levelShift(level);
+		auto limit = current >> levelShift(level);
+		auto mask = _wheelMasks[level];
+		while(mask) {
+			auto slot = std::countr_zero(mask);
+			mask &= mask - 1;
+			auto tick = base + ((slot - base) & (wheelSlots - 1));
+			if(tick > limit)
+				continue;
+
+			auto &bucket = _wheel[level][slot];
+			while(!bucket.empty()) {
+				auto timer = bucket.pop_front();
+				timer->_wheelBucket = -1;
+				expired.push_back(timer);
+			}
+			_wheelMasks[level] &= ~(uint64_t{1} << slot);
+		}
+	}
+
+	_wheelTime = current;
+	while(!expired.empty())
+		_enqueue(expired.pop_front());
+}
+
+uint64_t PrecisionTimerEngine::_nextWheelDeadline() {
+	uint64_t deadline = 0;
+	for(int level = 0; level < wheelLevels; level++) {
+		if(!_wheelMasks[level])
+			continue;
+		auto base = _wheelTime >> levelShift(level);
+		auto offset = std::countr_zero(std::rotr(_wheelMasks[level],
+				static_cast<int>(base & (wheelSlots - 1))));
+		auto start = (base + offset) << levelShift(level);
+		if(!deadline || start < deadline)
+			deadline = start;
+	}
+	return deadline;
+}
+
 void PrecisionTimerEngine::firedAlarm() {
 	auto irq_lock = frg::guard(&irqMutex());
 	auto lock = frg::guard(&_mutex);
@@ -72,15 +163,15 @@ void PrecisionTimerEngine::firedAlarm() {
 // the comparator setup and the main counter.
 void PrecisionTimerEngine::_progress() {
 	auto current = _clock->currentNanos();
+	uint64_t next;
 	do {
 		// Process all timers that elapsed in the past.
 		if(logProgress)
 			infoLogger() << "thor: Processing timers until " << current << frg::endlog;
+		_advanceWheel(current);
 		while(true) {
-			if(_timerQueue.empty()) {
-				_alarm->arm(0);
-				return;
-			}
+			if(_timerQueue.empty())
+				break;
 
 			if(_timerQueue.top()->_deadline > current)
 				break;
@@ -101,17 +192,70 @@ void PrecisionTimerEngine::_progress() {
 		}
 
 		// Setup the comparator and iterate if there was a race.
-		assert(!_timerQueue.empty());
-		_alarm->arm(_timerQueue.top()->_deadline);
+		next = _nextWheelDeadline();
+		if(!_timerQueue.empty() && (!next || _timerQueue.top()->_deadline < next))
+			next = _timerQueue.top()->_deadline;
+		if(!next) {
+			_alarm->arm(0);
+			return;
+		}
+		_alarm->arm(next);
 		current = _clock->currentNanos();
-	} while(_timerQueue.top()->_deadline <= current);
+	} while(next <= current);
 }
 
 ClockSource *systemClockSource() {
 	return globalClockSource;
 }
 
+namespace {
+	frg::ticket_spinlock clockPageMutex;
+	PhysicalAddr clockPagePhysical = static_cast<PhysicalAddr>(-1);
+	smarter::shared_ptr<MemoryView> clockPageView;
+
+	// Must be called with clockPageMutex held.
+	void ensureClockPage() {
+		if(clockPagePhysical != static_cast<PhysicalAddr>(-1))
+			return;
+		clockPagePhysical = physicalAllocator->allocate(kPageSize);
+		assert(clockPagePhysical != static_cast<PhysicalAddr>(-1) && "OOM");
+		PageAccessor accessor{clockPagePhysical};
+		memset(accessor.get(), 0, kPageSize);
+		clockPageView = smarter::allocate_shared<HardwareMemory>(*kernelAlloc,
+				clockPagePhysical, kPageSize, CachingMode::null);
+		// Only the kernel may update the clock parameters.
+		clockPageView->setReadOnly();
+	}
+}
+
+smarter::shared_ptr<MemoryView> clockPageMemory() {
+	auto irq_lock = frg::guard(&irqMutex());
+	auto lock = frg::guard(&clockPageMutex);
+
+	ensureClockPage();
+	return clockPageView;
+}
+
+void publishTscClock(uint64_t tscTicksPerMilli) {
+	auto irq_lock = frg::guard(&irqMutex());
+	auto lock = frg::guard(&clockPageMutex);
+
+	ensureClockPage();
+	PageAccessor accessor{clockPagePhysical};
+	auto page = reinterpret_cast<HelClockPage *>(accessor.get());
+
+	// Writer side of the seqlock that user space reads.
+	auto seqlock = __atomic_load_n(&page->seqlock, __ATOMIC_RELAXED);
+	__atomic_store_n(&page->seqlock, seqlock + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&page->tscTicksPerMilli, tscTicksPerMilli, __ATOMIC_RELAXED);
+	__atomic_store_n(&page->flags, uint32_t{kHelClockPageTsc}, __ATOMIC_RELAXED);
+	__atomic_store_n(&page->seqlock, seqlock + 2, __ATOMIC_RELEASE);
+}
+
 PrecisionTimerEngine *generalTimerEngine() {
+	if(auto engine = getCpuData()->timerEngine; engine)
+		return engine;
 	return globalTimerEngine;
 }
 
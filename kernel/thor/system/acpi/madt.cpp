@@ -145,6 +145,7 @@ void bootOtherProcessors() {
 
 	infoLogger() << "thor: Booting APs." << frg::endlog;
 
+	frg::vector<unsigned int, KernelAlloc> apicIds{*kernelAlloc};
 	size_t offset = sizeof(acpi_header_t) + sizeof(MadtHeader);
 	while(offset < madt->length) {
 		auto generic = (MadtGenericEntry *)((uint8_t *)madt + offset);
@@ -153,10 +154,12 @@ void bootOtherProcessors() {
 			// TODO: Support BSPs with APIC ID != 0.
 			if((entry->flags & local_flags::enabled)
 					&& entry->localApicId) // We ignore the BSP here.
-				bootSecondary(entry->localApicId);
+				apicIds.push(entry->localApicId);
 		}
 		offset += generic->length;
 	}
+
+	bootSecondaries(apicIds.data(), apicIds.size());
 }
 
 // --------------------------------------------------------
@@ -33,11 +33,21 @@ int main() {
 		execl("/bin/runsvr", "/bin/runsvr", "runsvr", "/sbin/virtio-block", nullptr);
 	}else assert(virtio != -1);
 
+	auto block_ahci = fork();
+	if(!block_ahci) {
+		execl("/bin/runsvr", "/bin/runsvr", "runsvr", "/sbin/block-ahci", nullptr);
+	}else assert(block_ahci != -1);
+
 	auto block_ata = fork();
 	if(!block_ata) {
 		execl("/bin/runsvr", "/bin/runsvr", "runsvr", "/sbin/block-ata", nullptr);
 	}else assert(block_ata != -1);
 
+	auto block_nvme = fork();
+	if(!block_nvme) {
+		execl("/bin/runsvr", "/bin/runsvr", "runsvr", "/sbin/block-nvme", nullptr);
+	}else assert(block_nvme != -1);
+
 	auto block_usb = fork();
 	if(!block_usb) {
 		execl("/bin/runsvr", "/bin/runsvr", "runsvr", "/sbin/storage", nullptr);
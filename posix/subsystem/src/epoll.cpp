@@ -1,6 +1,7 @@
 
 #include <string.h>
 #include <iostream>
+#include <optional>
 
 #include <async/doorbell.hpp>
 #include <boost/intrusive/list.hpp>
@@ -43,6 +44,10 @@ private:
 
 		async::cancellation_event cancelPoll;
 		expected<PollResult> pollFuture;
+
+		// Status that was delivered together with the edge that made the item pending.
+		// This saves a checkStatus() call (i.e., an IPC round trip for external files).
+		std::optional<PollResult> pushedStatus;
 	};
 
 	static void _awaitPoll(Item *item) {
@@ -83,10 +88,12 @@ private:
 						<< "\e[0m becomes pending" << std::endl;
 
 			// Note that we stop watching once an item becomes pending.
-			// We do this as we have to poll() again anyway before we report the item.
+			// Edge-triggered items are reported from the pushed status;
+			// level-triggered items are re-checked by waitForEvents() before reporting.
 			item->state &= ~statePolling;
 			if(!(item->state & statePending)) {
 				item->state |= statePending;
+				item->pushedStatus = result;
 
 				self->_pendingQueue.push_back(*item);
 				self->_currentSeq++;
@@ -143,6 +150,7 @@ public:
 
 		item->eventMask = mask;
 		item->cookie = cookie;
+		item->pushedStatus.reset();
 		item->cancelPoll.cancel();
 
 		// Mark the item as pending.
@@ -206,10 +214,19 @@ public:
 					continue;
 				}
 
-				if(logEpoll)
-					std::cout << "posix.epoll \e[1;34m" << structName() << "\e[0m: Checking item "
-							<< "\e[1;34m" << item->file->structName() << "\e[0m" << std::endl;
-				auto result_or_error = co_await item->file->checkStatus(item->process);
+				// The pushed status is only a snapshot of the edge that made the item pending.
+				// Level-triggered items must report the current status, so they are re-checked.
+				std::variant<Error, PollResult> result_or_error;
+				auto pushed = std::move(item->pushedStatus);
+				item->pushedStatus.reset();
+				if(pushed && (item->eventMask & EPOLLET)) {
+					result_or_error = *pushed;
+				}else{
+					if(logEpoll)
+						std::cout << "posix.epoll \e[1;34m" << structName() << "\e[0m: Checking item "
+								<< "\e[1;34m" << item->file->structName() << "\e[0m" << std::endl;
+					result_or_error = co_await item->file->checkStatus(item->process);
+				}
 
 				// Discard closed items.
 				auto error = std::get_if<Error>(&result_or_error);
@@ -250,10 +267,26 @@ public:
 					continue;
 				}
 
-				// We have to increment the sequence again as concurrent waiters
-				// might have seen an empty _pendingQueue.
-				// TODO: Edge-triggered watches should not be requeued here.
-				repoll_queue.push_back(*item);
+				if(item->eventMask & EPOLLONESHOT) {
+					// The item is disabled until it is re-armed by modifyItem().
+					item->state &= ~statePending;
+				}else if(item->eventMask & EPOLLET) {
+					// Edge-triggered items are only reported again after the next edge.
+					item->state &= ~statePending;
+					if(!(item->state & statePolling)) {
+						item->state |= statePolling;
+						item->cancelPoll.reset();
+						item->pollFuture = item->file->poll(item->process, std::get<0>(result),
+								item->cancelPoll);
+						item->pollFuture.then([item] {
+							_awaitPoll(item);
+						});
+					}
+				}else{
+					// We have to increment the sequence again as concurrent waiters
+					// might have seen an empty _pendingQueue.
+					repoll_queue.push_back(*item);
+				}
 
 				assert(k < max_events);
 				memset(events + k, 0, sizeof(struct epoll_event));
@@ -155,6 +155,202 @@ void dumpRegisters(std::shared_ptr<Process> proc) {
 	}
 }
 
+// Splits a memory area that contains multiple null-terminated strings.
+std::vector<std::string> splitStringArea(const std::string &area) {
+	std::vector<std::string> strings;
+	size_t k = 0;
+	while(k < area.size()) {
+		auto d = area.find(char(0), k);
+		assert(d != std::string::npos);
+		strings.push_back(area.substr(k, d - k));
+		k = d + 1;
+	}
+	return strings;
+}
+
+// File actions that are passed to the spawn supercall. Each action is followed by
+// pathLength bytes (for open actions); actions are padded to multiples of 8 bytes.
+struct SpawnFileAction {
+	uint32_t type;
+	int32_t fd;
+	int32_t newFd;
+	int32_t flags;
+	uint32_t mode;
+	uint32_t pathLength;
+};
+
+enum : uint32_t {
+	spawnActionClose = 1,
+	spawnActionDup2 = 2,
+	spawnActionOpen = 3
+};
+
+// Opens the file at path (relative to relativeTo) and optionally creates it.
+// This implements OPENAT and the open actions of posix_spawn().
+async::result<frg::expected<Error, smarter::shared_ptr<File, FileHandle>>>
+openFileAt(std::shared_ptr<Process> self, ViewPath relativeTo, std::string path,
+		SemanticFlags semanticFlags, bool create, bool exclusive, bool truncate) {
+	PathResolver resolver;
+	resolver.setup(self->fsContext()->getRoot(),
+			std::move(relativeTo), std::move(path));
+
+	smarter::shared_ptr<File, FileHandle> file;
+	if(create) {
+		co_await resolver.resolve(resolvePrefix);
+		if(!resolver.currentLink())
+			co_return Error::noSuchFile;
+
+		auto directory = resolver.currentLink()->getTarget();
+		auto tailResult = co_await directory->getLink(resolver.nextComponent());
+		if(!tailResult)
+			co_return tailResult.error();
+		auto tail = tailResult.value();
+		if(tail) {
+			if(exclusive)
+				co_return Error::alreadyExists;
+			auto fileResult = co_await tail->getTarget()->open(
+					resolver.currentView(), std::move(tail), semanticFlags);
+			if(!fileResult)
+				co_return fileResult.error();
+			file = fileResult.value();
+		}else{
+			if(logRequests)
+				std::cout << "posix: Creating file " << resolver.nextComponent() << std::endl;
+
+			assert(directory->superblock());
+			auto node = co_await directory->superblock()->createRegular();
+			// Due to races, link() can fail here.
+			// TODO: Implement a version of link() that eithers links the new node
+			// or returns the current node without failing.
+			auto linkResult = co_await directory->link(resolver.nextComponent(), node);
+			if(!linkResult)
+				co_return linkResult.error();
+			auto fileResult = co_await node->open(resolver.currentView(),
+					linkResult.value(), semanticFlags);
+			if(!fileResult)
+				co_return fileResult.error();
+			file = fileResult.value();
+		}
+	}else{
+		co_await resolver.resolve();
+		if(!resolver.currentLink())
+			co_return Error::noSuchFile;
+
+		auto target = resolver.currentLink()->getTarget();
+		auto fileResult = co_await target->open(resolver.currentView(),
+				resolver.currentLink(), semanticFlags);
+		if(!fileResult)
+			co_return fileResult.error();
+		file = fileResult.value();
+	}
+
+	if(!file)
+		co_return Error::noSuchFile;
+	if(truncate)
+		co_await file->truncate(0);
+	co_return file;
+}
+
+managarm::posix::Errors openErrorToPosix(Error error) {
+	switch(error) {
+	case Error::noSuchFile:
+	case Error::notDirectory:
+		return managarm::posix::Errors::FILE_NOT_FOUND;
+	case Error::alreadyExists:
+		return managarm::posix::Errors::ALREADY_EXISTS;
+	case Error::accessDenied:
+	case Error::insufficientPermissions:
+		return managarm::posix::Errors::ACCESS_DENIED;
+	case Error::illegalOperationTarget:
+		return managarm::posix::Errors::NOT_SUPPORTED;
+	default:
+		return managarm::posix::Errors::ILLEGAL_ARGUMENTS;
+	}
+}
+
+int openErrorToErrno(Error error) {
+	switch(error) {
+	case Error::noSuchFile:
+		return ENOENT;
+	case Error::notDirectory:
+		return ENOTDIR;
+	case Error::alreadyExists:
+		return EEXIST;
+	case Error::accessDenied:
+	case Error::insufficientPermissions:
+		return EACCES;
+	case Error::illegalOperationTarget:
+		return ENXIO;
+	case Error::illegalArguments:
+		return EINVAL;
+	default:
+		return EIO;
+	}
+}
+
+// Applies posix_spawn() file actions to the file table of the new process.
+// Returns zero on success and an errno value otherwise.
+async::result<int> applySpawnFileActions(std::shared_ptr<Process> self,
+		FileContext *fileContext, const std::string &area) {
+	auto validFd = [] (int fd) {
+		return fd >= 0 && fd < FileContext::maxFds;
+	};
+
+	size_t k = 0;
+	while(k < area.size()) {
+		SpawnFileAction action;
+		if(area.size() - k < sizeof(SpawnFileAction))
+			co_return EINVAL;
+		memcpy(&action, area.data() + k, sizeof(SpawnFileAction));
+		k += sizeof(SpawnFileAction);
+
+		if(!validFd(action.fd))
+			co_return EBADF;
+
+		if(action.type == spawnActionClose) {
+			if(!fileContext->getFile(action.fd))
+				co_return EBADF;
+			fileContext->closeFile(action.fd);
+		}else if(action.type == spawnActionDup2) {
+			if(!validFd(action.newFd))
+				co_return EBADF;
+			auto file = fileContext->getFile(action.fd);
+			if(!file)
+				co_return EBADF;
+			if(action.fd != action.newFd)
+				fileContext->attachFile(action.newFd, std::move(file));
+		}else if(action.type == spawnActionOpen) {
+			if(action.pathLength > area.size() - k)
+				co_return EINVAL;
+			std::string path{area.data() + k, action.pathLength};
+			k += action.pathLength;
+
+			SemanticFlags semanticFlags = 0;
+			if(action.flags & O_NONBLOCK)
+				semanticFlags |= semanticNonBlock;
+			if((action.flags & O_ACCMODE) == O_RDONLY)
+				semanticFlags |= semanticRead;
+			else if((action.flags & O_ACCMODE) == O_WRONLY)
+				semanticFlags |= semanticWrite;
+			else if((action.flags & O_ACCMODE) == O_RDWR)
+				semanticFlags |= semanticRead | semanticWrite;
+
+			auto fileResult = co_await openFileAt(self,
+					self->fsContext()->getWorkingDirectory(), std::move(path),
+					semanticFlags, action.flags & O_CREAT, action.flags & O_EXCL,
+					action.flags & O_TRUNC);
+			if(!fileResult)
+				co_return openErrorToErrno(fileResult.error());
+			fileContext->attachFile(action.fd, fileResult.value(), action.flags & O_CLOEXEC);
+		}else{
+			co_return EINVAL;
+		}
+
+		k = (k + 7) & ~size_t(7);
+	}
+	co_return 0;
+}
+
 async::result<void> observeThread(std::shared_ptr<Process> self,
 		std::shared_ptr<Generation> generation) {
 	auto thread = self->threadDescriptor();
@@ -205,6 +401,17 @@ async::result<void> observeThread(std::shared_ptr<Process> self,
 			gprs[kHelRegOut0] = 0;
 			HEL_CHECK(helStoreRegisters(thread.getHandle(), kHelRegsGeneral, &gprs));
 			HEL_CHECK(helResume(thread.getHandle()));
+		}else if(observe.observation() == kHelObserveSuperCall + 13) {
+			if(logRequests)
+				std::cout << "posix: GET_IDENTITY_PAGE supercall" << std::endl;
+			uintptr_t gprs[kHelNumGprs];
+			HEL_CHECK(helLoadRegisters(thread.getHandle(), kHelRegsGeneral, &gprs));
+
+			gprs[kHelRegError] = kHelErrNone;
+			gprs[kHelRegOut0] = reinterpret_cast<uintptr_t>(self->clientIdentityPage());
+			gprs[kHelRegOut1] = reinterpret_cast<uintptr_t>(self->clientClkTrackerPage());
+			HEL_CHECK(helStoreRegisters(thread.getHandle(), kHelRegsGeneral, &gprs));
+			HEL_CHECK(helResume(thread.getHandle()));
 		}else if(observe.observation() == kHelObserveSuperCall + 1) {
 			struct ManagarmProcessData {
 				HelHandle posixLane;
@@ -274,6 +481,64 @@ async::result<void> observeThread(std::shared_ptr<Process> self,
 
 			HEL_CHECK(helResume(thread.getHandle()));
 			HEL_CHECK(helResume(new_thread));
+		}else if(observe.observation() == kHelObserveSuperCall + 12) {
+			if(logRequests)
+				std::cout << "posix: spawn supercall" << std::endl;
+			uintptr_t gprs[kHelNumGprs];
+			HEL_CHECK(helLoadRegisters(thread.getHandle(), kHelRegsGeneral, &gprs));
+
+			std::string path;
+			path.resize(gprs[kHelRegArg1]);
+			auto loadPath = co_await helix_ng::readMemory(self->vmContext()->getSpace(),
+					gprs[kHelRegArg0], gprs[kHelRegArg1], path.data());
+			HEL_CHECK(loadPath.error());
+
+			std::string args_area;
+			args_area.resize(gprs[kHelRegArg3]);
+			auto loadArgs = co_await helix_ng::readMemory(self->vmContext()->getSpace(),
+					gprs[kHelRegArg2], gprs[kHelRegArg3], args_area.data());
+			HEL_CHECK(loadArgs.error());
+
+			std::string env_area;
+			env_area.resize(gprs[kHelRegArg5]);
+			auto loadEnv = co_await helix_ng::readMemory(self->vmContext()->getSpace(),
+					gprs[kHelRegArg4], gprs[kHelRegArg5], env_area.data());
+			HEL_CHECK(loadEnv.error());
+
+			std::string actions_area;
+			actions_area.resize(gprs[kHelRegArg7]);
+			auto loadActions = co_await helix_ng::readMemory(self->vmContext()->getSpace(),
+					gprs[kHelRegArg6], gprs[kHelRegArg7], actions_area.data());
+			HEL_CHECK(loadActions.error());
+
+			if(logRequests || logPaths)
+				std::cout << "posix: spawn path: " << path << std::endl;
+
+			// Unlike fork(), this never copies the parent's address space.
+			// Only the file table is copied (and modified by the file actions).
+			int errorCode = 0;
+			int pid = 0;
+			auto fileContext = FileContext::clone(self->fileContext());
+			errorCode = co_await applySpawnFileActions(self, fileContext.get(), actions_area);
+			if(!errorCode) {
+				auto child = co_await Process::spawn(self, std::move(fileContext),
+						std::move(path), splitStringArea(args_area),
+						splitStringArea(env_area));
+				if(child) {
+					pid = child.value()->pid();
+				}else if(child.error() == Error::noSuchFile) {
+					errorCode = ENOENT;
+				}else{
+					assert(child.error() == Error::badExecutable);
+					errorCode = ENOEXEC;
+				}
+			}
+
+			gprs[kHelRegError] = kHelErrNone;
+			gprs[kHelRegOut0] = errorCode;
+			gprs[kHelRegOut1] = pid;
+			HEL_CHECK(helStoreRegisters(thread.getHandle(), kHelRegsGeneral, &gprs));
+			HEL_CHECK(helResume(thread.getHandle()));
 		}else if(observe.observation() == kHelObserveSuperCall + 3) {
 			if(logRequests)
 				std::cout << "posix: execve supercall" << std::endl;
@@ -302,27 +567,8 @@ async::result<void> observeThread(std::shared_ptr<Process> self,
 				std::cout << "posix: execve path: " << path << std::endl;
 
 			// Parse both the arguments and the environment areas.
-			size_t k;
-
-			std::vector<std::string> args;
-			k = 0;
-			while(k < args_area.size()) {
-				auto d = args_area.find(char(0), k);
-				assert(d != std::string::npos);
-				args.push_back(args_area.substr(k, d - k));
-//				std::cout << "arg: " << args.back() << std::endl;
-				k = d + 1;
-			}
-
-			std::vector<std::string> env;
-			k = 0;
-			while(k < env_area.size()) {
-				auto d = env_area.find(char(0), k);
-				assert(d != std::string::npos);
-				env.push_back(env_area.substr(k, d - k));
-//				std::cout << "env: " << env.back() << std::endl;
-				k = d + 1;
-			}
+			auto args = splitStringArea(args_area);
+			auto env = splitStringArea(env_area);
 
 			auto error = co_await Process::exec(self,
 					path, std::move(args), std::move(env));
@@ -1915,71 +2161,19 @@ async::result<void> serveRequests(std::shared_ptr<Process> self,
 				relative_to = {file->associatedMount(), file->associatedLink()};
 			}
 
-			PathResolver resolver;
-			resolver.setup(self->fsContext()->getRoot(),
-					relative_to, req->path());
-			if(req->flags() & managarm::posix::OpenFlags::OF_CREATE) {
-				co_await resolver.resolve(resolvePrefix);
-				if(!resolver.currentLink()) {
-					co_await sendErrorResponse(managarm::posix::Errors::FILE_NOT_FOUND);
-					continue;
-				}
-
-				if(logRequests)
-					std::cout << "posix: Creating file " << req->path() << std::endl;
-
-				auto directory = resolver.currentLink()->getTarget();
-				auto tailResult = co_await directory->getLink(resolver.nextComponent());
-				assert(tailResult);
-				auto tail = tailResult.value();
-				if(tail) {
-					if(req->flags() & managarm::posix::OpenFlags::OF_EXCLUSIVE) {
-						co_await sendErrorResponse(managarm::posix::Errors::ALREADY_EXISTS);
-						continue;
-					}else{
-						auto fileResult = co_await tail->getTarget()->open(
-											resolver.currentView(), std::move(tail),
-											semantic_flags);
-						assert(fileResult);
-						file = fileResult.value();
-						assert(file);
-					}
-				}else{
-					assert(directory->superblock());
-					auto node = co_await directory->superblock()->createRegular();
-					// Due to races, link() can fail here.
-					// TODO: Implement a version of link() that eithers links the new node
-					// or returns the current node without failing.
-					auto linkResult = co_await directory->link(resolver.nextComponent(), node);
-					assert(linkResult);
-					auto link = linkResult.value();
-					auto fileResult = co_await node->open(resolver.currentView(), std::move(link),
-										semantic_flags);
-					assert(fileResult);
-					file = fileResult.value();
-					assert(file);
-				}
-			}else{
-				co_await resolver.resolve();
-
-				if(resolver.currentLink()) {
-					auto target = resolver.currentLink()->getTarget();
-					auto fileResult = co_await target->open(resolver.currentView(), resolver.currentLink(),
-										semantic_flags);
-					assert(fileResult);
-					file = fileResult.value();
-				}
-			}
-
-			if(!file) {
+			auto fileResult = co_await openFileAt(self, std::move(relative_to), req->path(),
+					semantic_flags,
+					req->flags() & managarm::posix::OpenFlags::OF_CREATE,
+					req->flags() & managarm::posix::OpenFlags::OF_EXCLUSIVE,
+					req->flags() & managarm::posix::OpenFlags::OF_TRUNC);
+			if(!fileResult) {
 				if(logRequests)
-					std::cout << "posix:     OPEN failed: file not found" << std::endl;
-				co_await sendErrorResponse(managarm::posix::Errors::FILE_NOT_FOUND);
+					std::cout << "posix:     OPEN failed" << std::endl;
+				co_await sendErrorResponse(openErrorToPosix(fileResult.error()));
 				continue;
 			}
+			file = fileResult.value();
 
-			if(req->flags() & managarm::posix::OpenFlags::OF_TRUNC)
-				co_await file->truncate(0);
 			int fd = self->fileContext()->attachFile(file,
 					req->flags() & managarm::posix::OpenFlags::OF_CLOEXEC);
 
@@ -30,36 +30,19 @@ std::shared_ptr<VmContext> VmContext::create() {
 std::shared_ptr<VmContext> VmContext::clone(std::shared_ptr<VmContext> original) {
 	auto context = std::make_shared<VmContext>();
 
+	// The kernel forks all copy-on-write areas and shares all other areas.
 	HelHandle space;
-	HEL_CHECK(helCreateSpace(&space));
+	HEL_CHECK(helForkSpace(original->_space.getHandle(), &space));
 	context->_space = helix::UniqueDescriptor(space);
 
 	for(const auto &entry : original->_areaTree) {
 		const auto &[address, area] = entry;
 
-		helix::UniqueDescriptor copyView;
-		if(area.copyOnWrite) {
-			HelHandle copyHandle;
-			HEL_CHECK(helForkMemory(area.copyView.getHandle(), &copyHandle));
-			copyView = helix::UniqueDescriptor{copyHandle};
-
-			void *pointer;
-			HEL_CHECK(helMapMemory(copyView.getHandle(), context->_space.getHandle(),
-					reinterpret_cast<void *>(address),
-					0, area.areaSize, area.nativeFlags, &pointer));
-		}else{
-			void *pointer;
-			HEL_CHECK(helMapMemory(area.fileView.getHandle(), context->_space.getHandle(),
-					reinterpret_cast<void *>(address),
-					area.offset, area.areaSize, area.nativeFlags, &pointer));
-		}
-
 		Area copy;
 		copy.copyOnWrite = area.copyOnWrite;
 		copy.areaSize = area.areaSize;
 		copy.nativeFlags = area.nativeFlags;
 		copy.fileView = area.fileView.dup();
-		copy.copyView = std::move(copyView);
 		copy.file = area.file;
 		copy.offset = area.offset;
 		context->_areaTree.emplace(address, std::move(copy));
@@ -114,7 +97,6 @@ VmContext::mapFile(uintptr_t hint, helix::UniqueDescriptor memory,
 	area.areaSize = alignedSize;
 	area.nativeFlags = nativeFlags;
 	area.fileView = std::move(memory);
-	area.copyView = std::move(copyView);
 	area.file = std::move(file);
 	area.offset = offset;
 	_areaTree.emplace(address, std::move(area));
@@ -153,7 +135,6 @@ async::result<void *> VmContext::remapFile(void *oldPointer,
 	area.areaSize = alignedNewSize;
 	area.nativeFlags = it->second.nativeFlags;
 	area.fileView = std::move(it->second.fileView);
-	area.copyView = std::move(it->second.copyView);
 	area.file = std::move(it->second.file);
 	area.offset = it->second.offset;
 	_areaTree.erase(it);
@@ -742,6 +723,11 @@ async::result<std::shared_ptr<Process>> Process::init(std::string path) {
 	process->_threadPageMemory = helix::UniqueDescriptor{thread_memory};
 	process->_threadPageMapping = helix::Mapping{process->_threadPageMemory, 0, 0x1000};
 
+	HelHandle identity_memory;
+	HEL_CHECK(helAllocateMemory(0x1000, 0, nullptr, &identity_memory));
+	process->_identityPageMemory = helix::UniqueDescriptor{identity_memory};
+	process->_identityPageMapping = helix::Mapping{process->_identityPageMemory, 0, 0x1000};
+
 	// The initial signal mask allows all signals.
 	process->_signalMask = 0;
 
@@ -752,15 +738,19 @@ async::result<std::shared_ptr<Process>> Process::init(std::string path) {
 
 	HEL_CHECK(helMapMemory(process->_threadPageMemory.getHandle(),
 			process->_vmContext->getSpace().getHandle(),
-			nullptr, 0, 0x1000, kHelMapProtRead | kHelMapProtWrite,
+			nullptr, 0, 0x1000, kHelMapProtRead | kHelMapProtWrite | kHelMapDontFork,
 			&process->_clientThreadPage));
+	HEL_CHECK(helMapMemory(process->_identityPageMemory.getHandle(),
+			process->_vmContext->getSpace().getHandle(),
+			nullptr, 0, 0x1000, kHelMapProtRead | kHelMapDontFork,
+			&process->_clientIdentityPage));
 	HEL_CHECK(helMapMemory(process->_fileContext->fileTableMemory().getHandle(),
 			process->_vmContext->getSpace().getHandle(),
-			nullptr, 0, 0x1000, kHelMapProtRead,
+			nullptr, 0, 0x1000, kHelMapProtRead | kHelMapDontFork,
 			&process->_clientFileTable));
 	HEL_CHECK(helMapMemory(clk::trackerPageMemory().getHandle(),
 			process->_vmContext->getSpace().getHandle(),
-			nullptr, 0, 0x1000, kHelMapProtRead,
+			nullptr, 0, 0x1000, kHelMapProtRead | kHelMapDontFork,
 			&process->_clientClkTrackerPage));
 
 	process->_uid = 0;
@@ -768,6 +758,7 @@ async::result<std::shared_ptr<Process>> Process::init(std::string path) {
 	process->_gid = 0;
 	process->_egid = 0;
 	process->_hull->initializeProcess(process.get());
+	process->_updateIdentityPage();
 
 	// TODO: Do not pass an empty argument vector?
 	auto threadResult = co_await execute(process->_fsContext->getRoot(),
@@ -806,6 +797,11 @@ std::shared_ptr<Process> Process::fork(std::shared_ptr<Process> original) {
 	process->_threadPageMemory = helix::UniqueDescriptor{thread_memory};
 	process->_threadPageMapping = helix::Mapping{process->_threadPageMemory, 0, 0x1000};
 
+	HelHandle identity_memory;
+	HEL_CHECK(helAllocateMemory(0x1000, 0, nullptr, &identity_memory));
+	process->_identityPageMemory = helix::UniqueDescriptor{identity_memory};
+	process->_identityPageMapping = helix::Mapping{process->_identityPageMemory, 0, 0x1000};
+
 	// Signal masks are copied on fork().
 	process->_signalMask = original->_signalMask;
 
@@ -816,15 +812,22 @@ std::shared_ptr<Process> Process::fork(std::shared_ptr<Process> original) {
 
 	HEL_CHECK(helMapMemory(process->_threadPageMemory.getHandle(),
 			process->_vmContext->getSpace().getHandle(),
-			nullptr, 0, 0x1000, kHelMapProtRead | kHelMapProtWrite,
+			nullptr, 0, 0x1000, kHelMapProtRead | kHelMapProtWrite | kHelMapDontFork,
 			&process->_clientThreadPage));
+	// Keep the identity page at the same address such that the client
+	// does not need to query it again after fork().
+	HEL_CHECK(helMapMemory(process->_identityPageMemory.getHandle(),
+			process->_vmContext->getSpace().getHandle(),
+			original->_clientIdentityPage, 0, 0x1000,
+			kHelMapProtRead | kHelMapFixed | kHelMapDontFork,
+			&process->_clientIdentityPage));
 	HEL_CHECK(helMapMemory(process->_fileContext->fileTableMemory().getHandle(),
 			process->_vmContext->getSpace().getHandle(),
-			nullptr, 0, 0x1000, kHelMapProtRead,
+			nullptr, 0, 0x1000, kHelMapProtRead | kHelMapDontFork,
 			&process->_clientFileTable));
 	HEL_CHECK(helMapMemory(clk::trackerPageMemory().getHandle(),
 			process->_vmContext->getSpace().getHandle(),
-			nullptr, 0, 0x1000, kHelMapProtRead,
+			nullptr, 0, 0x1000, kHelMapProtRead | kHelMapDontFork,
 			&process->_clientClkTrackerPage));
 
 	process->_uid = original->_uid;
@@ -833,6 +836,7 @@ std::shared_ptr<Process> Process::fork(std::shared_ptr<Process> original) {
 	process->_egid = original->_egid;
 	original->_children.push_back(process);
 	process->_hull->initializeProcess(process.get());
+	process->_updateIdentityPage();
 
 	HelHandle new_thread;
 	HEL_CHECK(helCreateThread(process->fileContext()->getUniverse().getHandle(),
@@ -848,6 +852,95 @@ std::shared_ptr<Process> Process::fork(std::shared_ptr<Process> original) {
 	return process;
 }
 
+async::result<frg::expected<Error, std::shared_ptr<Process>>>
+Process::spawn(std::shared_ptr<Process> original, std::shared_ptr<FileContext> fileContext,
+		std::string path, std::vector<std::string> args, std::vector<std::string> env) {
+	auto vmContext = VmContext::create();
+	auto fsContext = FsContext::clone(original->_fsContext);
+	fileContext->closeOnExec();
+
+	// Load the executable before the child becomes visible,
+	// such that errors can be reported to the parent.
+	auto threadResult = co_await execute(fsContext->getRoot(),
+			fsContext->getWorkingDirectory(),
+			path, std::move(args), std::move(env), vmContext,
+			fileContext->getUniverse(),
+			fileContext->clientMbusLane());
+	if(!threadResult) {
+		switch(threadResult.error()) {
+		case Error::noSuchFile:
+		case Error::badExecutable:
+			co_return threadResult.error();
+		default:
+			throw std::logic_error("Unexpected error from execute()");
+		}
+	}
+
+	auto hull = std::make_shared<PidHull>(nextPid++);
+	auto process = std::make_shared<Process>(std::move(hull), original.get());
+	process->_path = std::move(path);
+	process->_vmContext = std::move(vmContext);
+	process->_fsContext = std::move(fsContext);
+	process->_fileContext = std::move(fileContext);
+	process->_signalContext = SignalContext::clone(original->_signalContext);
+	process->_signalContext->resetHandlers();
+
+	original->_pgPointer->reassociateProcess(process.get());
+
+	HelHandle thread_memory;
+	HEL_CHECK(helAllocateMemory(0x1000, 0, nullptr, &thread_memory));
+	process->_threadPageMemory = helix::UniqueDescriptor{thread_memory};
+	process->_threadPageMapping = helix::Mapping{process->_threadPageMemory, 0, 0x1000};
+
+	HelHandle identity_memory;
+	HEL_CHECK(helAllocateMemory(0x1000, 0, nullptr, &identity_memory));
+	process->_identityPageMemory = helix::UniqueDescriptor{identity_memory};
+	process->_identityPageMapping = helix::Mapping{process->_identityPageMemory, 0, 0x1000};
+
+	// Signal masks are inherited across fork() and exec().
+	process->_signalMask = original->_signalMask;
+
+	auto [server_lane, client_lane] = helix::createStream();
+	HEL_CHECK(helTransferDescriptor(client_lane.getHandle(),
+			process->_fileContext->getUniverse().getHandle(), &process->_clientPosixLane));
+	client_lane.release();
+
+	HEL_CHECK(helMapMemory(process->_threadPageMemory.getHandle(),
+			process->_vmContext->getSpace().getHandle(),
+			nullptr, 0, 0x1000, kHelMapProtRead | kHelMapProtWrite | kHelMapDontFork,
+			&process->_clientThreadPage));
+	HEL_CHECK(helMapMemory(process->_identityPageMemory.getHandle(),
+			process->_vmContext->getSpace().getHandle(),
+			nullptr, 0, 0x1000, kHelMapProtRead | kHelMapDontFork,
+			&process->_clientIdentityPage));
+	HEL_CHECK(helMapMemory(process->_fileContext->fileTableMemory().getHandle(),
+			process->_vmContext->getSpace().getHandle(),
+			nullptr, 0, 0x1000, kHelMapProtRead | kHelMapDontFork,
+			&process->_clientFileTable));
+	HEL_CHECK(helMapMemory(clk::trackerPageMemory().getHandle(),
+			process->_vmContext->getSpace().getHandle(),
+			nullptr, 0, 0x1000, kHelMapProtRead | kHelMapDontFork,
+			&process->_clientClkTrackerPage));
+
+	process->_uid = original->_uid;
+	process->_euid = original->_euid;
+	process->_gid = original->_gid;
+	process->_egid = original->_egid;
+	original->_children.push_back(process);
+	process->_hull->initializeProcess(process.get());
+	process->_updateIdentityPage();
+
+	process->_threadDescriptor = std::move(threadResult.value());
+	process->_posixLane = std::move(server_lane);
+
+	auto generation = std::make_shared<Generation>();
+	process->_currentGeneration = generation;
+	helResume(process->_threadDescriptor.getHandle());
+	async::detach(serve(process, std::move(generation)));
+
+	co_return process;
+}
+
 std::shared_ptr<Process> Process::clone(std::shared_ptr<Process> original, void *ip, void *sp) {
 	auto hull = std::make_shared<PidHull>(nextPid++);
 	auto process = std::make_shared<Process>(std::move(hull), original.get());
@@ -865,6 +958,11 @@ std::shared_ptr<Process> Process::clone(std::shared_ptr<Process> original, void
 	process->_threadPageMemory = helix::UniqueDescriptor{thread_memory};
 	process->_threadPageMapping = helix::Mapping{process->_threadPageMemory, 0, 0x1000};
 
+	HelHandle identity_memory;
+	HEL_CHECK(helAllocateMemory(0x1000, 0, nullptr, &identity_memory));
+	process->_identityPageMemory = helix::UniqueDescriptor{identity_memory};
+	process->_identityPageMapping = helix::Mapping{process->_identityPageMemory, 0, 0x1000};
+
 	// Signal masks are copied on clone().
 	process->_signalMask = original->_signalMask;
 
@@ -875,8 +973,12 @@ std::shared_ptr<Process> Process::clone(std::shared_ptr<Process> original, void
 
 	HEL_CHECK(helMapMemory(process->_threadPageMemory.getHandle(),
 			process->_vmContext->getSpace().getHandle(),
-			nullptr, 0, 0x1000, kHelMapProtRead | kHelMapProtWrite,
+			nullptr, 0, 0x1000, kHelMapProtRead | kHelMapProtWrite | kHelMapDontFork,
 			&process->_clientThreadPage));
+	HEL_CHECK(helMapMemory(process->_identityPageMemory.getHandle(),
+			process->_vmContext->getSpace().getHandle(),
+			nullptr, 0, 0x1000, kHelMapProtRead | kHelMapDontFork,
+			&process->_clientIdentityPage));
 
 	process->_clientFileTable = original->_clientFileTable;
 	process->_clientClkTrackerPage = original->_clientClkTrackerPage;
@@ -887,6 +989,7 @@ std::shared_ptr<Process> Process::clone(std::shared_ptr<Process> original, void
 	process->_egid = original->_egid;
 	original->_children.push_back(process);
 	process->_hull->initializeProcess(process.get());
+	process->_updateIdentityPage();
 
 	HelHandle new_thread;
 	HEL_CHECK(helCreateThread(process->fileContext()->getUniverse().getHandle(),
@@ -933,17 +1036,22 @@ async::result<Error> Process::exec(std::shared_ptr<Process> process,
 	void *exec_thread_page;
 	void *exec_clk_tracker_page;
 	void *exec_client_table;
+	void *exec_identity_page;
 	HEL_CHECK(helMapMemory(process->_threadPageMemory.getHandle(),
 			exec_vm_context->getSpace().getHandle(),
-			nullptr, 0, 0x1000, kHelMapProtRead | kHelMapProtWrite,
+			nullptr, 0, 0x1000, kHelMapProtRead | kHelMapProtWrite | kHelMapDontFork,
 			&exec_thread_page));
+	HEL_CHECK(helMapMemory(process->_identityPageMemory.getHandle(),
+			exec_vm_context->getSpace().getHandle(),
+			nullptr, 0, 0x1000, kHelMapProtRead | kHelMapDontFork,
+			&exec_identity_page));
 	HEL_CHECK(helMapMemory(clk::trackerPageMemory().getHandle(),
 			exec_vm_context->getSpace().getHandle(),
-			nullptr, 0, 0x1000, kHelMapProtRead,
+			nullptr, 0, 0x1000, kHelMapProtRead | kHelMapDontFork,
 			&exec_clk_tracker_page));
 	HEL_CHECK(helMapMemory(process->_fileContext->fileTableMemory().getHandle(),
 			exec_vm_context->getSpace().getHandle(),
-			nullptr, 0, 0x1000, kHelMapProtRead,
+			nullptr, 0, 0x1000, kHelMapProtRead | kHelMapDontFork,
 			&exec_client_table));
 
 	// Kill the old thread.
@@ -969,6 +1077,7 @@ async::result<Error> Process::exec(std::shared_ptr<Process> process,
 	process->_clientPosixLane = exec_posix_lane;
 	process->_clientFileTable = exec_client_table;
 	process->_clientClkTrackerPage = exec_clk_tracker_page;
+	process->_clientIdentityPage = exec_identity_page;
 
 	auto generation = std::make_shared<Generation>();
 	process->_currentGeneration = generation;
@@ -978,6 +1087,38 @@ async::result<Error> Process::exec(std::shared_ptr<Process> process,
 	co_return Error::success;
 }
 
+void Process::_updateIdentityPage() {
+	if(!_identityPageMapping)
+		return;
+	auto page = reinterpret_cast<IdentityPage *>(_identityPageMapping.get());
+
+	int32_t pgid = 0;
+	int32_t sid = 0;
+	if(_pgPointer) {
+		pgid = _pgPointer->getProcessGroupId();
+		if(auto session = _pgPointer->getSession(); session)
+			sid = session->getSessionId();
+	}
+
+	// Start the seqlock write.
+	auto seqlock = __atomic_load_n(&page->seqlock, __ATOMIC_RELAXED);
+	__atomic_store_n(&page->seqlock, seqlock + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	__atomic_store_n(&page->pid, pid(), __ATOMIC_RELAXED);
+	__atomic_store_n(&page->tid, tid(), __ATOMIC_RELAXED);
+	__atomic_store_n(&page->ppid, _parent ? _parent->pid() : 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&page->pgid, pgid, __ATOMIC_RELAXED);
+	__atomic_store_n(&page->sid, sid, __ATOMIC_RELAXED);
+	__atomic_store_n(&page->uid, _uid, __ATOMIC_RELAXED);
+	__atomic_store_n(&page->euid, _euid, __ATOMIC_RELAXED);
+	__atomic_store_n(&page->gid, _gid, __ATOMIC_RELAXED);
+	__atomic_store_n(&page->egid, _egid, __ATOMIC_RELAXED);
+
+	// Finish the seqlock write.
+	__atomic_store_n(&page->seqlock, seqlock + 2, __ATOMIC_RELEASE);
+}
+
 void Process::retire(Process *process) {
 	assert(process->_parent);
 	process->_parent->_childrenUsage.userTime += process->_generationUsage.userTime;
@@ -1063,6 +1204,7 @@ void ProcessGroup::reassociateProcess(Process *process) {
 	}
 	process->_pgPointer = shared_from_this();
 	members_.push_back(*process);
+	process->_updateIdentityPage();
 }
 
 void ProcessGroup::dropProcess(Process *process) {
@@ -1099,8 +1241,8 @@ std::shared_ptr<TerminalSession> TerminalSession::initializeNewSession(Process *
 
 std::shared_ptr<ProcessGroup> TerminalSession::spawnProcessGroup(Process *groupLeader) {
 	auto group = std::make_shared<ProcessGroup>(groupLeader->getHull()->shared_from_this());
-	group->reassociateProcess(groupLeader);
 	group->sessionPointer_ = shared_from_this();
+	group->reassociateProcess(groupLeader);
 	groups_.push_back(*group);
 	group->hull_->initializeProcessGroup(group.get());
 	return group;
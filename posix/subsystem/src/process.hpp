@@ -48,7 +48,6 @@ private:
 		size_t areaSize;
 		uint32_t nativeFlags;
 		helix::UniqueDescriptor fileView;
-		helix::UniqueDescriptor copyView;
 		smarter::shared_ptr<File, FileHandle> file;
 		intptr_t offset;
 	};
@@ -149,6 +148,9 @@ struct FileDescriptor {
 
 struct FileContext {
 public:
+	// The file table window is a single page of handles.
+	static constexpr int maxFds = 0x1000 / sizeof(HelHandle);
+
 	static std::shared_ptr<FileContext> create();
 	static std::shared_ptr<FileContext> clone(std::shared_ptr<FileContext> original);
 
@@ -321,6 +323,22 @@ struct ThreadPage {
 	int globalSignalFlag;
 };
 
+// This page is mapped read-only into each process. It allows the client
+// to answer identity queries (getpid() etc.) without IPC to posix.
+// Readers must follow the seqlock protocol (the seqlock is odd during updates).
+struct IdentityPage {
+	uint64_t seqlock;
+	int32_t pid;
+	int32_t tid;
+	int32_t ppid;
+	int32_t pgid;
+	int32_t sid;
+	int32_t uid;
+	int32_t euid;
+	int32_t gid;
+	int32_t egid;
+};
+
 // --------------------------------------------------------------------------------------
 // The 'Process' class.
 // --------------------------------------------------------------------------------------
@@ -367,6 +385,12 @@ struct Process : std::enable_shared_from_this<Process> {
 	static std::shared_ptr<Process> fork(std::shared_ptr<Process> parent);
 	static std::shared_ptr<Process> clone(std::shared_ptr<Process> parent, void *ip, void *sp);
 
+	// Creates a new process that directly executes path (i.e., fork() + exec() without
+	// copying the parent's address space). fileContext becomes the child's file table.
+	static async::result<frg::expected<Error, std::shared_ptr<Process>>>
+	spawn(std::shared_ptr<Process> parent, std::shared_ptr<FileContext> fileContext,
+			std::string path, std::vector<std::string> args, std::vector<std::string> env);
+
 	static async::result<Error> exec(std::shared_ptr<Process> process,
 			std::string path, std::vector<std::string> args, std::vector<std::string> env);
 
@@ -403,9 +427,11 @@ public:
 		if(_uid == 0 || _euid == 0) {
 			_uid = uid;
 			_euid = uid;
+			_updateIdentityPage();
 			return Error::success;
 		} else if(uid == _uid) {
 			_uid = uid;
+			_updateIdentityPage();
 			return Error::success;
 		}
 		return Error::accessDenied;
@@ -421,6 +447,7 @@ public:
 		}
 		if(_uid == 0 || _euid == 0 || euid == _uid) {
 			_euid = euid;
+			_updateIdentityPage();
 			return Error::success;
 		}
 		return Error::accessDenied;
@@ -437,9 +464,11 @@ public:
 		if(_gid == 0 || _egid == 0) {
 			_gid = gid;
 			_egid = gid;
+			_updateIdentityPage();
 			return Error::success;
 		} else if(gid == _gid) {
 			_egid = gid;
+			_updateIdentityPage();
 			return Error::success;
 		}
 		return Error::accessDenied;
@@ -455,6 +484,7 @@ public:
 		}
 		if(_gid == 0 || _egid == 0 || _gid == egid || _egid == egid) {
 			_egid = egid;
+			_updateIdentityPage();
 			return Error::success;
 		}
 		return Error::accessDenied;
@@ -495,6 +525,7 @@ public:
 	void *clientThreadPage() { return _clientThreadPage; }
 	void *clientFileTable() { return _clientFileTable; }
 	void *clientClkTrackerPage() { return _clientClkTrackerPage; }
+	void *clientIdentityPage() { return _clientIdentityPage; }
 
 	ThreadPage *accessThreadPage() {
 		return reinterpret_cast<ThreadPage *>(_threadPageMapping.get());
@@ -517,6 +548,9 @@ public:
 	}
 
 private:
+	// Re-publishes the process' credentials etc. to the IdentityPage.
+	void _updateIdentityPage();
+
 	Process *_parent;
 
 	std::shared_ptr<PidHull> _hull;
@@ -538,11 +572,14 @@ private:
 
 	helix::UniqueDescriptor _threadPageMemory;
 	helix::Mapping _threadPageMapping;
+	helix::UniqueDescriptor _identityPageMemory;
+	helix::Mapping _identityPageMapping;
 
 	HelHandle _clientPosixLane;
 	void *_clientThreadPage;
 	void *_clientFileTable;
 	void *_clientClkTrackerPage;
+	void *_clientIdentityPage;
 
 	uint64_t _signalMask;
 	std::vector<std::shared_ptr<Process>> _children;
@@ -590,6 +627,14 @@ struct ProcessGroup : std::enable_shared_from_this<ProcessGroup> {
 
 	void issueSignalToGroup(int sn, SignalInfo info);
 
+	pid_t getProcessGroupId() {
+		return hull_->getPid();
+	}
+
+	TerminalSession *getSession() {
+		return sessionPointer_.get();
+	}
+
 private:
 	std::shared_ptr<PidHull> hull_;
 
@@ -1,6 +1,7 @@
 
 #include <string.h>
 #include <iostream>
+#include <unordered_map>
 
 #include <protocols/mbus/client.hpp>
 
@@ -15,6 +16,10 @@ namespace {
 
 id_allocator<uint32_t> minorAllocator;
 
+// Maps the mbus ID of each disk to the letter of its sdX name.
+// Disks are named in the order in which their first partition appears.
+std::unordered_map<std::string, char> diskLetters;
+
 struct Subsystem {
 	Subsystem() {
 		minorAllocator.use_range(0);
@@ -56,13 +61,30 @@ async::detached run() {
 	
 	auto handler = mbus::ObserverHandler{}
 	.withAttach([] (mbus::Entity entity, mbus::Properties properties) -> async::detached {
-		std::cout << "POSIX: Installing block device "
-				<< std::get<mbus::StringItem>(properties.at("unix.devname")).value << std::endl;
+		std::string name;
+		if(properties.find("unix.devname") != properties.end()) {
+			name = std::get<mbus::StringItem>(properties.at("unix.devname")).value;
+		}else{
+			// Partitions exported by libblockfs are named after their disk.
+			auto disk = std::get<mbus::StringItem>(properties.at("drvcore.mbus-parent")).value;
+			auto partition = std::get<mbus::StringItem>(properties.at("block.partition")).value;
+			auto it = diskLetters.find(disk);
+			if(it == diskLetters.end()) {
+				if(diskLetters.size() >= 26) {
+					std::cout << "\e[31m" "POSIX: Too many disks; ignoring disk "
+							<< disk << "\e[39m" << std::endl;
+					co_return;
+				}
+				it = diskLetters.insert({disk, static_cast<char>('a' + diskLetters.size())}).first;
+			}
+			name = std::string{"sd"} + it->second + partition;
+		}
+
+		std::cout << "POSIX: Installing block device " << name << std::endl;
 
 		auto lane = helix::UniqueLane(co_await entity.bind());
 		auto device = std::make_shared<Device>(VfsType::blockDevice,
-				std::get<mbus::StringItem>(properties.at("unix.devname")).value,
-				std::move(lane));
+				std::move(name), std::move(lane));
 		// We use 8 here, the major for SCSI devices and allocate minors sequentially.
 		// Note that this is not really correct as the minor of a partition
 		// depends on the minor of the whole device (see Linux devices.txt documentation).
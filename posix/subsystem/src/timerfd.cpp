@@ -5,6 +5,7 @@
 
 #include <async/result.hpp>
 #include <async/doorbell.hpp>
+#include <helix/clock.hpp>
 #include <helix/ipc.hpp>
 #include "timerfd.hpp"
 
@@ -24,8 +25,7 @@ private:
 		assert(timer->initial || timer->interval);
 //		std::cout << "posix: Timer armed" << std::endl;
 
-		uint64_t tick;
-		HEL_CHECK(helGetClock(&tick));
+		auto tick = helix::currentClock();
 
 		if(timer->initial) {
 			helix::AwaitClock await_initial;
@@ -38,12 +38,14 @@ struct InterruptTransfer {
 struct BulkTransfer {
 	BulkTransfer(XferFlags flags, arch::dma_buffer_view buffer)
 	: flags{flags}, buffer{buffer},
-			allowShortPackets{false}, lazyNotification{false} { }
+			allowShortPackets{false}, lazyNotification{false}, streamId{0} { }
 
 	XferFlags flags;
 	arch::dma_buffer_view buffer;
 	bool allowShortPackets;
 	bool lazyNotification;
+	// Must be zero unless the endpoint has streams (see Endpoint::numStreams()).
+	uint32_t streamId;
 };
 
 enum class PipeType {
@@ -62,12 +64,16 @@ public:
 	virtual async::result<void> transfer(ControlTransfer info) = 0;
 	virtual async::result<size_t> transfer(InterruptTransfer info) = 0;
 	virtual async::result<size_t> transfer(BulkTransfer info) = 0;
+
+	// Number of usable streams. Valid stream IDs are 1 to numStreams().
+	virtual size_t numStreams() { return 0; }
 };
 
 
 struct Endpoint {
 	Endpoint(std::shared_ptr<EndpointData> state);
 	
+	size_t numStreams() const;
 	async::result<void> transfer(ControlTransfer info) const;
 	async::result<size_t> transfer(InterruptTransfer info) const;
 	async::result<size_t> transfer(BulkTransfer info) const;
@@ -62,10 +62,12 @@ namespace descriptor_type {
 		string = 0x03,
 		interface = 0x04,
 		endpoint = 0x05,
+		endpointCompanion = 0x30,
 
 		// TODO: Put non-standard descriptors somewhere else.
 		hid = 0x21,
-		report = 0x22
+		report = 0x22,
+		uasPipeUsage = 0x24
 	};
 }
 
@@ -117,6 +119,14 @@ struct [[ gnu::packed ]] EndpointDescriptor : public DescriptorBase {
 	uint8_t interval;
 };
 
+// Follows the endpoint descriptor of SuperSpeed endpoints.
+struct [[ gnu::packed ]] EndpointCompanionDescriptor : public DescriptorBase {
+	uint8_t maxBurst;
+	// For bulk endpoints, bits 0-4 contain log2 of the number of streams.
+	uint8_t attributes;
+	uint16_t bytesPerInterval;
+};
+
 enum class EndpointType {
 	control = 0,
 	isochronous,
@@ -58,6 +58,10 @@ async::result<Endpoint> Interface::getEndpoint(PipeType type, int number) const
 Endpoint::Endpoint(std::shared_ptr<EndpointData> state)
 : _state(std::move(state)) { }
 
+size_t Endpoint::numStreams() const {
+	return _state->numStreams();
+}
+
 async::result<size_t> Endpoint::transfer(InterruptTransfer info) const {
 	return _state->transfer(info);
 }
@@ -52,15 +52,17 @@ private:
 
 
 struct EndpointState final : EndpointData {
-	EndpointState(helix::UniqueLane lane)
-	:_lane(std::move(lane)) { }
+	EndpointState(helix::UniqueLane lane, size_t num_streams)
+	:_lane(std::move(lane)), _numStreams{num_streams} { }
 	
 	async::result<void> transfer(ControlTransfer info) override;
 	async::result<size_t> transfer(InterruptTransfer info) override;
 	async::result<size_t> transfer(BulkTransfer info) override;
+	size_t numStreams() override;
 
 private:
 	helix::UniqueLane _lane;
+	size_t _numStreams;
 };
 
 arch::dma_pool *DeviceState::setupPool() {
@@ -225,10 +227,15 @@ async::result<Endpoint> InterfaceState::getEndpoint(PipeType type, int number) {
 	resp.ParseFromArray(recv_resp.data(), recv_resp.length());
 	assert(resp.error() == managarm::usb::Errors::SUCCESS);
 
-	auto state = std::make_shared<EndpointState>(pull_lane.descriptor());
+	auto state = std::make_shared<EndpointState>(pull_lane.descriptor(),
+			resp.num_streams());
 	co_return Endpoint(std::move(state));
 }
 
+size_t EndpointState::numStreams() {
+	return _numStreams;
+}
+
 async::result<void> EndpointState::transfer(ControlTransfer info) {
 	throw std::runtime_error("endpoint control transfer not implemented");
 }
@@ -283,6 +290,7 @@ async::result<size_t> EndpointState::transfer(BulkTransfer info) {
 		req.set_req_type(managarm::usb::CntReqType::BULK_TRANSFER_TO_DEVICE);
 		req.set_length(info.buffer.size());
 		req.set_lazy_notification(info.lazyNotification);
+		req.set_stream(info.streamId);
 		
 		auto ser = req.SerializeAsString();
 		auto &&transmit = helix::submitAsync(_lane, helix::Dispatcher::global(),
@@ -313,6 +321,7 @@ async::result<size_t> EndpointState::transfer(BulkTransfer info) {
 		req.set_length(info.buffer.size());
 		req.set_allow_short(info.allowShortPackets);
 		req.set_lazy_notification(info.lazyNotification);
+		req.set_stream(info.streamId);
 		
 		auto ser = req.SerializeAsString();
 		auto &&transmit = helix::submitAsync(_lane, helix::Dispatcher::global(),
@@ -8,6 +8,54 @@
 namespace protocols {
 namespace usb {
 
+// Bulk transfers are completed asynchronously such that clients can queue multiple
+// transfers on the same endpoint. As the transfer is started before the coroutine
+// suspends for the first time, transfers still reach the HCD in the order of the requests.
+async::detached serveBulkToDevice(Endpoint endpoint, helix::UniqueDescriptor conversation,
+		arch::dma_buffer buffer, managarm::usb::CntRequest req) {
+	helix::SendBuffer send_resp;
+
+	BulkTransfer transfer{XferFlags::kXferToDevice, buffer};
+	transfer.lazyNotification = req.lazy_notification();
+	transfer.streamId = req.stream();
+	auto length = co_await endpoint.transfer(transfer);
+
+	managarm::usb::SvrResponse resp;
+	resp.set_error(managarm::usb::Errors::SUCCESS);
+	resp.set_size(length);
+	
+	auto ser = resp.SerializeAsString();
+	auto &&transmit = helix::submitAsync(conversation, helix::Dispatcher::global(),
+			helix::action(&send_resp, ser.data(), ser.size()));
+	co_await transmit.async_wait();
+	HEL_CHECK(send_resp.error());
+}
+
+async::detached serveBulkToHost(Endpoint endpoint, helix::UniqueDescriptor conversation,
+		managarm::usb::CntRequest req) {
+	helix::SendBuffer send_resp;
+	helix::SendBuffer send_data;
+
+	// FIXME: Fill in the correct DMA pool.
+	arch::dma_buffer buffer{nullptr, static_cast<size_t>(req.length())};
+	BulkTransfer transfer{XferFlags::kXferToHost, buffer};
+	transfer.allowShortPackets = req.allow_short();
+	transfer.lazyNotification = req.lazy_notification();
+	transfer.streamId = req.stream();
+	auto length = co_await endpoint.transfer(transfer);
+
+	managarm::usb::SvrResponse resp;
+	resp.set_error(managarm::usb::Errors::SUCCESS);
+
+	auto ser = resp.SerializeAsString();
+	auto &&transmit = helix::submitAsync(conversation, helix::Dispatcher::global(),
+			helix::action(&send_resp, ser.data(), ser.size(), kHelItemChain),
+			helix::action(&send_data, buffer.data(), length));
+	co_await transmit.async_wait();
+	HEL_CHECK(send_resp.error());
+	HEL_CHECK(send_data.error());
+}
+
 async::detached serveEndpoint(Endpoint endpoint, helix::UniqueLane lane) {
 	while(true) {
 		helix::Accept accept;
@@ -51,7 +99,6 @@ async::detached serveEndpoint(Endpoint endpoint, helix::UniqueLane lane) {
 			HEL_CHECK(send_data.error());
 		}else if(req.req_type() == managarm::usb::CntReqType::BULK_TRANSFER_TO_DEVICE) {
 			helix::RecvBuffer recv_buffer;
-			helix::SendBuffer send_resp;
 		
 			// FIXME: Fill in the correct DMA pool.
 			arch::dma_buffer buffer{nullptr, static_cast<size_t>(req.length())};
@@ -59,41 +106,10 @@ async::detached serveEndpoint(Endpoint endpoint, helix::UniqueLane lane) {
 					helix::action(&recv_buffer, buffer.data(), buffer.size()));
 			co_await payload.async_wait();
 			HEL_CHECK(recv_buffer.error());
-		
-			BulkTransfer transfer{XferFlags::kXferToDevice, buffer};
-			transfer.lazyNotification = req.lazy_notification();
-			auto length = co_await endpoint.transfer(transfer);
 
-			managarm::usb::SvrResponse resp;
-			resp.set_error(managarm::usb::Errors::SUCCESS);
-			resp.set_size(length);
-			
-			auto ser = resp.SerializeAsString();
-			auto &&transmit = helix::submitAsync(conversation, helix::Dispatcher::global(),
-					helix::action(&send_resp, ser.data(), ser.size()));
-			co_await transmit.async_wait();
-			HEL_CHECK(send_resp.error());
+			serveBulkToDevice(endpoint, std::move(conversation), std::move(buffer), req);
 		}else if(req.req_type() == managarm::usb::CntReqType::BULK_TRANSFER_TO_HOST) {
-			helix::SendBuffer send_resp;
-			helix::SendBuffer send_data;
-
-			// FIXME: Fill in the correct DMA pool.
-			arch::dma_buffer buffer{nullptr, static_cast<size_t>(req.length())};
-			BulkTransfer transfer{XferFlags::kXferToHost, buffer};
-			transfer.allowShortPackets = req.allow_short();
-			transfer.lazyNotification = req.lazy_notification();
-			auto length = co_await endpoint.transfer(transfer);
-
-			managarm::usb::SvrResponse resp;
-			resp.set_error(managarm::usb::Errors::SUCCESS);
-
-			auto ser = resp.SerializeAsString();
-			auto &&transmit = helix::submitAsync(conversation, helix::Dispatcher::global(),
-					helix::action(&send_resp, ser.data(), ser.size(), kHelItemChain),
-					helix::action(&send_data, buffer.data(), length));
-			co_await transmit.async_wait();
-			HEL_CHECK(send_resp.error());
-			HEL_CHECK(send_data.error());
+			serveBulkToHost(endpoint, std::move(conversation), req);
 		}else{
 			helix::SendBuffer send_resp;
 
@@ -134,6 +150,7 @@ async::detached serveInterface(Interface interface, helix::UniqueLane lane) {
 			helix::PushDescriptor send_lane;
 
 			auto endpoint = co_await interface.getEndpoint(static_cast<PipeType>(req.pipetype()), req.number());
+			auto num_streams = endpoint.numStreams();
 			
 			helix::UniqueLane local_lane, remote_lane;
 			std::tie(local_lane, remote_lane) = helix::createStream();
@@ -142,6 +159,7 @@ async::detached serveInterface(Interface interface, helix::UniqueLane lane) {
 
 			managarm::usb::SvrResponse resp;
 			resp.set_error(managarm::usb::Errors::SUCCESS);
+			resp.set_num_streams(num_streams);
 
 			auto ser = resp.SerializeAsString();
 			auto &&transmit = helix::submitAsync(conversation, helix::Dispatcher::global(),
@@ -1,5 +1,6 @@
 #include "arp.hpp"
 
+#include <helix/clock.hpp>
 #include <helix/ipc.hpp>
 #include <helix/timer.hpp>
 #include <arch/bit.hpp>
@@ -132,8 +133,7 @@ void Neighbours::feedArp(nic::MacAddress dst, arch::dma_buffer_view view) {
 }
 
 Neighbours::Entry &Neighbours::getEntry(uint32_t ip) {
-	uint64_t time;
-	HEL_CHECK(helGetClock(&time));
+	auto time = helix::currentClock();
 	if (auto f = table_.find(ip); f != table_.end()) {
 		if (time + staleTimeMs * 1'000'000 <= f->second.mtime_ns) {
 			f->second.state = State::stale;
@@ -0,0 +1,82 @@
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+
+#include <hel.h>
+#include <hel-syscalls.h>
+
+#include "testsuite.hpp"
+
+namespace {
+	constexpr size_t pageSize = 0x1000;
+	constexpr size_t numPages = 64;
+	constexpr int numGenerations = 1000;
+
+	uint64_t *mapCow(HelHandle memory) {
+		void *window;
+		HelError ret = helMapMemory(memory, kHelNullHandle, nullptr,
+				0, numPages * pageSize, kHelMapProtRead | kHelMapProtWrite, &window);
+		assert(ret == kHelErrNone);
+		return static_cast<uint64_t *>(window);
+	}
+
+	void unmapCow(uint64_t *window) {
+		HelError ret = helUnmapMemory(kHelNullHandle, window, numPages * pageSize);
+		assert(ret == kHelErrNone);
+	}
+}
+
+// Forks a CoW memory object repeatedly (dropping the parent each time, like a chain of
+// processes that fork and exit) and measures the latency of the resulting CoW faults.
+DEFINE_TEST(cowForkGenerations, ([] {
+	HelHandle memory;
+	HelHandle cow;
+	HelError ret = helAllocateMemory(numPages * pageSize, 0, nullptr, &memory);
+	assert(ret == kHelErrNone);
+	ret = helCopyOnWrite(memory, 0, numPages * pageSize, &cow);
+	assert(ret == kHelErrNone);
+	ret = helCloseDescriptor(kHelThisUniverse, memory);
+	assert(ret == kHelErrNone);
+
+	uint64_t expected[numPages];
+	auto window = mapCow(cow);
+	for(size_t i = 0; i < numPages; i++) {
+		window[i * pageSize / sizeof(uint64_t)] = i;
+		expected[i] = i;
+	}
+	unmapCow(window);
+
+	for(int g = 0; g < numGenerations; g++) {
+		HelHandle forked;
+		ret = helForkMemory(cow, &forked);
+		assert(ret == kHelErrNone);
+		ret = helCloseDescriptor(kHelThisUniverse, cow);
+		assert(ret == kHelErrNone);
+		cow = forked;
+
+		// Dirty one page per generation such that the chain contains shadowed pages.
+		auto page = g % numPages;
+		window = mapCow(cow);
+		window[page * pageSize / sizeof(uint64_t)] = numPages + g;
+		expected[page] = numPages + g;
+		unmapCow(window);
+	}
+
+	uint64_t start;
+	uint64_t end;
+	window = mapCow(cow);
+	helGetClock(&start);
+	for(size_t i = 0; i < numPages; i++)
+		window[i * pageSize / sizeof(uint64_t)] += 1;
+	helGetClock(&end);
+
+	for(size_t i = 0; i < numPages; i++)
+		assert(window[i * pageSize / sizeof(uint64_t)] == expected[i] + 1);
+	unmapCow(window);
+
+	ret = helCloseDescriptor(kHelThisUniverse, cow);
+	assert(ret == kHelErrNone);
+
+	std::cout << "kernel-tests: CoW fault latency after " << numGenerations
+			<< " generations: " << (end - start) / numPages << " ns" << std::endl;
+}))
@@ -1,6 +1,7 @@
 #!/usr/bin/env python3
 
 import argparse
+import collections
 import struct
 import subprocess
 
@@ -8,47 +9,70 @@ parser = argparse.ArgumentParser()
 parser.add_argument('profile_path', type=str)
 parser.add_argument('--line', action='store_true')
 parser.add_argument('--isn', action='store_true')
+parser.add_argument('--folded', action='store_true',
+		help='emit folded stacks (for flamegraph.pl) instead of a flat profile')
+parser.add_argument('--thor', type=str,
+		default='pkg-builds/managarm-kernel/kernel/thor/thor')
 
 args = parser.parse_args()
 
-profile = dict()
-
-addr2line = subprocess.Popen(
-	[
-		'addr2line', '-sfC',
-		'-e', 'pkg-builds/managarm-kernel/kernel/thor/thor'
-	],
-	encoding='ascii',
-	stdin=subprocess.PIPE, stdout=subprocess.PIPE)
-
-n_user = 0
-n_kernel = 0
+# Keep this in sync with struct ProfileRecord in thor-internal/profile.hpp.
+record_format = struct.Struct('QQQII')
+flag_kernel = 1
 
+records = []
 with open(args.profile_path, 'rb') as f:
 	while True:
-		rec = f.read(8)
-		if not rec:
+		rec = f.read(record_format.size)
+		if len(rec) < record_format.size:
 			break
-		ip = struct.unpack('Q', rec)[0]
-		if ip < (1 << 63):
-			n_user += 1
-			continue
-		else:
-			n_kernel += 1
-		addr2line.stdin.write(hex(ip) + '\n')
-		addr2line.stdin.flush()
-		func = addr2line.stdout.readline().rstrip()
-		line = addr2line.stdout.readline().rstrip()
-		if args.line:
-			loc = (func, line)
-		elif args.isn:
-			loc = (func, line.split(':')[0] + ':' + hex(ip))
-		else:
-			loc = (func, line.split(':')[0])
-		if loc in profile:
-			profile[loc] += 1
+		records.append(record_format.unpack(rec))
+
+# Resolve all kernel IPs with a single addr2line invocation.
+kernel_ips = sorted({rec[0] for rec in records if rec[4] & flag_kernel})
+symbols = dict()
+if kernel_ips:
+	out = subprocess.run(['addr2line', '-sfC', '-e', args.thor],
+			input=''.join(hex(ip) + '\n' for ip in kernel_ips),
+			encoding='ascii', stdout=subprocess.PIPE, check=True).stdout.splitlines()
+	for i, ip in enumerate(kernel_ips):
+		symbols[ip] = (out[2 * i], out[2 * i + 1])
+
+def location(ip):
+	func, line = symbols[ip]
+	if args.line:
+		return (func, line)
+	elif args.isn:
+		return (func, line.split(':')[0] + ':' + hex(ip))
+	else:
+		return (func, line.split(':')[0])
+
+if args.folded:
+	stacks = collections.Counter()
+	for (ip, thread, universe, cpu, flags) in records:
+		frames = ['cpu{}'.format(cpu), 'universe-{:x}'.format(universe),
+				'thread-{:x}'.format(thread)]
+		if flags & flag_kernel:
+			frames.append(location(ip)[0].replace(';', ':'))
 		else:
-			profile[loc] = 1
+			frames.append('[user]')
+		stacks[';'.join(frames)] += 1
+	for stack, count in sorted(stacks.items()):
+		print('{} {}'.format(stack, count))
+	exit(0)
+
+profile = collections.Counter()
+per_cpu = collections.Counter()
+n_user = 0
+n_kernel = 0
+
+for (ip, thread, universe, cpu, flags) in records:
+	per_cpu[cpu] += 1
+	if not (flags & flag_kernel):
+		n_user += 1
+		continue
+	n_kernel += 1
+	profile[location(ip)] += 1
 
 n_all = n_user + n_kernel
 
@@ -56,4 +80,6 @@ out = sorted(profile.keys(), key=lambda loc: profile[loc])
 for loc in out:
 	print("{:.2f}% ({} samples) in:".format(profile[loc]/n_all*100, profile[loc]))
 	print("    {} in {}".format(loc[0], loc[1]))
+for cpu in sorted(per_cpu.keys()):
+	print("{} samples on CPU {}".format(per_cpu[cpu], cpu))
 print("{:.2f}% of all samples in the kernel".format(n_kernel/(n_user + n_kernel)*100))